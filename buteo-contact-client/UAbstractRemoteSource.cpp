@@ -79,6 +79,7 @@ public:
 
     bool m_batchMode;
     QList<UContactsBackendBatchOperation> m_operations;
+    QHash<QString, QString> m_knownETags;
 };
 
 UAbstractRemoteSource::UAbstractRemoteSource(QObject *parent)
@@ -91,6 +92,48 @@ UAbstractRemoteSource::~UAbstractRemoteSource()
 {
 }
 
+bool UAbstractRemoteSource::fetchManifest()
+{
+    return false;
+}
+
+void UAbstractRemoteSource::fetchContactsById(const QStringList &remoteIds)
+{
+    Q_UNUSED(remoteIds);
+    qWarning() << "Fetch contacts by id not supported";
+    emit contactsFetched(QList<QContact>(), Sync::SYNC_ERROR, -1.0);
+}
+
+bool UAbstractRemoteSource::probeChanges(const QDateTime &since)
+{
+    Q_UNUSED(since);
+    return false;
+}
+
+QContactFetchHint UAbstractRemoteSource::uploadFetchHint() const
+{
+    return QContactFetchHint();
+}
+
+UContactsConflictResolver::DetailEncoder UAbstractRemoteSource::uploadDetailEncoder() const
+{
+    return 0;
+}
+
+void UAbstractRemoteSource::setKnownETags(const QHash<QString, QString> &etags)
+{
+    Q_D(UAbstractRemoteSource);
+
+    d->m_knownETags = etags;
+}
+
+QHash<QString, QString> UAbstractRemoteSource::knownETags() const
+{
+    const Q_D(UAbstractRemoteSource);
+
+    return d->m_knownETags;
+}
+
 void UAbstractRemoteSource::transaction()
 {
     Q_D(UAbstractRemoteSource);
@@ -27,11 +27,15 @@
 #include <QObject>
 #include <QDateTime>
 #include <QVariantMap>
+#include <QHash>
 
 #include <QtContacts/QContact>
+#include <QtContacts/QContactFetchHint>
 
 #include <SyncCommonDefs.h>
 
+#include "UContactsConflictResolver.h"
+
 class UAbstractRemoteSourcePrivate;
 
 class UAbstractRemoteSource : public QObject
@@ -48,6 +52,28 @@ public:
     virtual bool init(const QVariantMap &properties) = 0;
     virtual void fetchContacts(const QDateTime &since, bool includeDeleted, bool fetchAvatar = true) = 0;
 
+    /*!
+     * \brief Fetch the remoteId and the etag of every remote contact
+     * The manifest is delivered by contactsFetched, the contacts only contain
+     * the remote id and the etag fields.
+     * \return Returns false if the remote source does not support manifests
+     */
+    virtual bool fetchManifest();
+
+    /*!
+     * \brief Fetch all data of the given remote contacts
+     * The contacts are delivered by contactsFetched.
+     * \param remoteIds A list with remoteId of the contacts
+     */
+    virtual void fetchContactsById(const QStringList &remoteIds);
+
+    /*!
+     * \brief Count the remote contacts changed or removed since the given date
+     * The result is delivered by changesProbed, no contact is downloaded.
+     * \return Returns false if the remote source does not support probes
+     */
+    virtual bool probeChanges(const QDateTime &since);
+
     /*!
      * \brief Begins a transaction on the remote database.
      */
@@ -66,11 +92,46 @@ public:
     virtual void saveContacts(const QList<QtContacts::QContact> &contacts);
     virtual void removeContacts(const QList<QtContacts::QContact> &contacts);
 
+    /*!
+     * \brief Return the details needed to upload a local contact
+     * Local contacts are fetched with this hint before they are saved or removed.
+     */
+    virtual QtContacts::QContactFetchHint uploadFetchHint() const;
+
+    /*!
+     * \brief Return the encoder of the detail values stored on the remote side
+     * Only these values are compared to find local changes, a null encoder
+     * compares every detail value.
+     */
+    virtual UContactsConflictResolver::DetailEncoder uploadDetailEncoder() const;
+
+    /*!
+     * \brief Set the etags of the contacts already stored locally
+     * Fetched contacts with a known etag are reported by contactsUnchanged
+     * instead of contactsFetched.
+     * \param etags A map from remoteId to etag
+     */
+    void setKnownETags(const QHash<QString, QString> &etags);
+    QHash<QString, QString> knownETags() const;
+
 signals:
     void contactsFetched(const QList<QtContacts::QContact> &contacts,
                          Sync::SyncStatus status,
                          qreal progress);
 
+    /*!
+     * \brief This signal is emitted, when fetched contacts did not change
+     * \param ids A list with remoteId of the unchanged contacts
+     */
+    void contactsUnchanged(const QStringList &ids);
+
+    /*!
+     * \brief This signal is emitted, when a probe started by probeChanges finishes
+     * \param count The number of remote changes, -1 if unknown
+     * \param status The operation status
+     */
+    void changesProbed(int count, Sync::SyncStatus status);
+
     /*!
      * \brief This signal is emitted, when a remote contact is created
      * \param contacts A list of created contacts
@@ -28,6 +28,8 @@
 #include "UAuth.h"
 
 #include <QVariantMap>
+#include <QDateTime>
+#include <QHash>
 #include <QTextStream>
 #include <QFile>
 #include <QStringList>
@@ -41,17 +43,39 @@
 using namespace Accounts;
 using namespace SignOn;
 
+// tokens are not reused when they expire in less than this
+static const int TOKEN_EXPIRY_MARGIN_SECS   (60);
+
+struct UAuthToken
+{
+    QString token;
+    QDateTime expires;
+};
+typedef QHash<QString, UAuthToken> UAuthTokenCache;
+// tokens of the accounts authenticated by this process, by account and service
+Q_GLOBAL_STATIC(UAuthTokenCache, tokenCache)
+
 class UAuthPrivate
 {
 public:
-    UAuthPrivate() {}
+    UAuthPrivate()
+        : mAccountId(0),
+          mForceRefresh(false)
+    {}
     ~UAuthPrivate() {}
 
+    QString cacheKey() const
+    {
+        return QString("%1/%2").arg(mAccountId).arg(mServiceName);
+    }
+
     QPointer<Accounts::Manager> mAccountManager;
     QPointer<SignOn::Identity> mIdentity;
     QPointer<SignOn::AuthSession> mSession;
     QPointer<Accounts::Account> mAccount;
     QString mServiceName;
+    quint32 mAccountId;
+    bool mForceRefresh;
 };
 
 UAuth::UAuth(QObject *parent)
@@ -75,6 +99,7 @@ UAuth::init(const quint32 accountId, const QString serviceName)
     }
 
     d->mServiceName = serviceName;
+    d->mAccountId = accountId;
     if (d->mAccountManager && d_ptr->mAccount) {
         LOG_DEBUG("GAuth already initialized");
         return false;
@@ -104,13 +129,29 @@ UAuth::init(const quint32 accountId, const QString serviceName)
 void
 UAuth::sessionResponse(const SessionData &sessionData)
 {
+    Q_D(UAuth);
     SignOn::AuthSession *session = qobject_cast<SignOn::AuthSession*>(sender());
     Q_ASSERT(session);
     session->disconnect(this);
+    // allow a new authentication if the token gets rejected
+    if (d->mIdentity) {
+        d->mIdentity->destroySession(session);
+    }
+    d->mSession = 0;
+    d->mForceRefresh = false;
 
     mToken = sessionData.getProperty(QStringLiteral("AccessToken")).toString();
     LOG_DEBUG("Authenticated !!!");
 
+    bool ok = false;
+    int expiresIn = sessionData.getProperty(QStringLiteral("ExpiresIn")).toInt(&ok);
+    if (ok && (expiresIn > TOKEN_EXPIRY_MARGIN_SECS) && !mToken.isEmpty()) {
+        UAuthToken cached;
+        cached.token = mToken;
+        cached.expires = QDateTime::currentDateTimeUtc().addSecs(expiresIn);
+        tokenCache()->insert(d->cacheKey(), cached);
+    }
+
     emit success();
 }
 
@@ -124,6 +165,18 @@ UAuth::authenticate()
         return true;
     }
 
+    if (!d->mForceRefresh) {
+        UAuthTokenCache::const_iterator cached = tokenCache()->constFind(d->cacheKey());
+        if ((cached != tokenCache()->constEnd()) &&
+            (QDateTime::currentDateTimeUtc().secsTo(cached.value().expires) > TOKEN_EXPIRY_MARGIN_SECS)) {
+            LOG_DEBUG("Using cached token, valid until" << cached.value().expires);
+            mToken = cached.value().token;
+            // keep the result asynchronous as with signon
+            QMetaObject::invokeMethod(this, "success", Qt::QueuedConnection);
+            return true;
+        }
+    }
+
     Accounts::Service srv(d->mAccountManager->service(d->mServiceName));
     if (!srv.isValid()) {
         LOG_WARNING(QString("error: Service [%1] not found for account [%2].")
@@ -168,6 +221,10 @@ UAuth::authenticate()
 
     QVariantMap signonSessionData = authData.parameters();
     signonSessionData.insert("UiPolicy", SignOn::NoUserInteractionPolicy);
+    if (d->mForceRefresh) {
+        // signon also caches the token, make it ask the server for a new one
+        signonSessionData.insert("ForceTokenRefresh", true);
+    }
     d->mSession->process(signonSessionData, authData.mechanism());
     accSrv->deleteLater();
     return true;
@@ -182,6 +239,23 @@ void UAuth::credentialsStored(const quint32 id)
 
 void UAuth::error(const SignOn::Error & error)
 {
+    Q_D(UAuth);
     LOG_WARNING("LOGIN ERROR:" << error.message());
+    SignOn::AuthSession *session = qobject_cast<SignOn::AuthSession*>(sender());
+    if (session) {
+        session->disconnect(this);
+        if (d->mIdentity) {
+            d->mIdentity->destroySession(session);
+        }
+    }
+    d->mSession = 0;
     emit failed();
 }
+
+void UAuth::invalidateToken()
+{
+    Q_D(UAuth);
+    tokenCache()->remove(d->cacheKey());
+    mToken.clear();
+    d->mForceRefresh = true;
+}
@@ -49,6 +49,11 @@ public:
     virtual bool authenticate();
     virtual bool init(const quint32 accountId, const QString serviceName);
 
+    /*!
+     * \brief Drop the cached token, the next authenticate() call asks signon for a new one
+     */
+    virtual void invalidateToken();
+
     inline QString accountDisplayName() const { return mDisplayName; }
     inline QString token() const { return mToken; }
 
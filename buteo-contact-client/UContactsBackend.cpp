@@ -27,6 +27,7 @@
 #include "config.h"
 #include "UContactsBackend.h"
 #include "UContactsCustomDetail.h"
+#include "UContactsConflictResolver.h"
 
 #include <LogMacros.h>
 
@@ -43,6 +44,11 @@
 #include <QBuffer>
 #include <QSet>
 #include <QHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QStandardPaths>
 
 #include <QDBusInterface>
 #include <QDBusReply>
@@ -50,6 +56,8 @@
 static const QString CPIM_SERVICE_NAME             ("com.canonical.pim");
 static const QString CPIM_ADDRESSBOOK_OBJECT_PATH  ("/com/canonical/pim/AddressBook");
 static const QString CPIM_ADDRESSBOOK_IFACE_NAME   ("com.canonical.pim.AddressBook");
+// number of contacts requested from the contacts service on each call
+static const int     CONTACTS_FETCH_CHUNK_SIZE     (200);
 
 UContactsBackend::UContactsBackend(const QString &managerName, QObject* parent)
     : QObject (parent)
@@ -73,6 +81,22 @@ UContactsBackend::init(uint syncAccount, const QString &syncTarget)
 {
     FUNCTION_CALL_TRACE;
 
+    if (!initSyncTarget(syncAccount, syncTarget)) {
+        return false;
+    }
+
+    // a new source has an empty cache
+    if (!mSyncTargetId.isEmpty() && !mIndexTimestamp.isValid()) {
+        loadCache();
+    }
+    return true;
+}
+
+bool
+UContactsBackend::initSyncTarget(uint syncAccount, const QString &syncTarget)
+{
+    FUNCTION_CALL_TRACE;
+
     // create address book it it does not exists
     // check if the source already exists
     QContactDetailFilter filter;
@@ -94,13 +118,16 @@ UContactsBackend::init(uint syncAccount, const QString &syncTarget)
                                                                            "ACCOUNT-ID");
         if (!exd.isEmpty() && (exd.data().toUInt() == syncAccount)) {
             mSyncTargetId = contact.detail<QContactGuid>().guid();
-            reloadCache();
+            mIndexFileName = indexFileName(syncAccount);
+            mSyncWrites.open(syncWritesFileName());
             return true;
         }
     }
 
     // memory/mock manager does not support syncTarget
-    if (iMgr->managerName() != "mock") {
+    if (iMgr->managerName() == "mock") {
+        mIndexFileName = indexFileName(syncAccount);
+    } else {
         // create a new source if necessary
         QContact contact;
         contact.setType(QContactType::TypeGroup);
@@ -127,6 +154,11 @@ UContactsBackend::init(uint syncAccount, const QString &syncTarget)
         }
 
         mSyncTargetId = contact.detail<QContactGuid>().guid();
+        mIndexFileName = indexFileName(syncAccount);
+        mIndexTimestamp = QDateTime::currentDateTimeUtc();
+        mSyncWrites.open(syncWritesFileName());
+        // the journal of an interrupted first sync needs an index to apply to
+        saveCache();
     }
 
     return true;
@@ -136,7 +168,10 @@ bool
 UContactsBackend::uninit()
 {
     FUNCTION_CALL_TRACE;
-    mRemoteIdToLocalId.clear();
+    mSyncWrites.close();
+    mRemoteIdIndex.clear();
+    mIndexFileName.clear();
+    mIndexTimestamp = QDateTime();
 
     return true;
 }
@@ -196,6 +231,16 @@ UContactsBackend::getAllDeletedContactIds(const QDateTime &aTimeStamp)
     return idList;
 }
 
+RemoteToLocalIdMap
+UContactsBackend::getAllUnpurgedDeletedContactIds()
+{
+    FUNCTION_CALL_TRACE;
+
+    // deleted contacts are kept with the deletion time until purged
+    return remoteIdsOf(changeLogContactIds(QContactChangeLogFilter::EventRemoved,
+                                           QDateTime::fromMSecsSinceEpoch(0)));
+}
+
 bool
 UContactsBackend::addContacts(QList<QContact>& aContactList,
                               QMap<int, UContactsStatus> *aStatusMap)
@@ -205,6 +250,7 @@ UContactsBackend::addContacts(QList<QContact>& aContactList,
     Q_ASSERT(aStatusMap);
 
     QMap<int, QContactManager::Error> errorMap;
+    QList<QContactId> writtenIds;
 
     // Check if contact already exists if it exists set the contact id
     // to cause an update instead of create a new one
@@ -214,6 +260,7 @@ UContactsBackend::addContacts(QList<QContact>& aContactList,
         QContactId id = entryExists(remoteId);
         if (!id.isNull()) {
             c.setId(id);
+            writtenIds << id;
         } else {
             // make sure that all contacts retrieved are saved on the correct sync target
             QContactSyncTarget syncTarget = c.detail<QContactSyncTarget>();
@@ -228,11 +275,19 @@ UContactsBackend::addContacts(QList<QContact>& aContactList,
         }
     }
 
+    mSyncWrites.registerIds(writtenIds);
     bool retVal = iMgr->saveContacts(&aContactList, &errorMap);
     if (!retVal) {
         LOG_WARNING( "Errors reported while saving contacts:" << iMgr->error() );
     }
 
+    // ids of new contacts are only known after the save
+    writtenIds.clear();
+    for (int i = 0; i < aContactList.size(); i++) {
+        writtenIds << aContactList.at(i).id();
+    }
+    mSyncWrites.storedIds(writtenIds);
+
     // QContactManager will populate errorMap only for errors, but we use this as a status map,
     // so populate NoError if there's no error.
     for (int i = 0; i < aContactList.size(); i++)
@@ -243,9 +298,7 @@ UContactsBackend::addContacts(QList<QContact>& aContactList,
             status.errorCode = QContactManager::NoError;
 
             // update remote id map
-            const QContact &c = aContactList.at(i);
-            QString remoteId = getRemoteId(c);
-            mRemoteIdToLocalId.insert(remoteId, c.id());
+            updateCache(aContactList.at(i));
         } else {
             LOG_WARNING("Contact with id " <<  aContactList.at(i).id() << " and index " << i <<" is in error");
             status.errorCode = errorMap.value(i);
@@ -266,6 +319,7 @@ UContactsBackend::modifyContacts(QList<QContact> *aContactList)
 
     QMap<int,QContactManager::Error> errors;
     QMap<int,UContactsStatus> statusMap;
+    QList<QContactId> writtenIds;
 
     // WORKAROUND: Our backend uses GUid as contact id due problems with contact id serialization
     // we can not use this field
@@ -285,13 +339,16 @@ UContactsBackend::modifyContacts(QList<QContact> *aContactList)
         }
         newContact.setId(localId);
         newContact.removeDetail(&guid);
+        writtenIds << localId;
     }
 
+    mSyncWrites.registerIds(writtenIds);
     if(iMgr->saveContacts(aContactList , &errors)) {
         LOG_DEBUG("Batch Modification of Contacts Succeeded");
     } else {
         LOG_DEBUG("Batch Modification of Contacts Failed");
     }
+    mSyncWrites.storedIds(writtenIds);
 
     // QContactManager will populate errorMap only for errors, but we use this as a status map,
     // so populate NoError if there's no error.
@@ -304,12 +361,8 @@ UContactsBackend::modifyContacts(QList<QContact> *aContactList)
             status.errorCode = QContactManager::NoError;
             statusMap.insert(i, status);
 
-            // update remote it map
-            QString oldRemoteId = mRemoteIdToLocalId.key(c.id());
-            mRemoteIdToLocalId.remove(oldRemoteId);
-
-            QString remoteId = getRemoteId(c);
-            mRemoteIdToLocalId.insert(remoteId, c.id());
+            // update remote id map, this also drops the old remote id of the contact
+            updateCache(c);
         } else {
             LOG_DEBUG("contact with id " << contactId << " and index " << i <<" is in error");
             QContactManager::Error errorCode = errors.value(i);
@@ -320,6 +373,115 @@ UContactsBackend::modifyContacts(QList<QContact> *aContactList)
     return statusMap;
 }
 
+QMap<int, UContactsStatus>
+UContactsBackend::updateSyncFields(const QList<QContact> &aContactList)
+{
+    FUNCTION_CALL_TRACE;
+
+    Q_ASSERT (iMgr);
+    UContactsStatus status;
+    QMap<int,UContactsStatus> statusMap;
+
+    // fields owned by the sync, they are the only ones written
+    static const QStringList syncFields(QStringList() << UContactsCustomDetail::FieldRemoteId
+                                                      << UContactsCustomDetail::FieldContactETag
+                                                      << UContactsCustomDetail::FieldContactAvatarETag);
+
+    QList<QContactId> localIds;
+    QList<int> indexes;
+    for (int i = 0; i < aContactList.size(); i++) {
+        const QContact &newContact = aContactList.at(i);
+        QContactId localId = entryExists(getRemoteId(newContact));
+        QContactGuid guid = newContact.detail<QContactGuid>();
+        if (localId.isNull() && !guid.isEmpty()) {
+            localId = QContactId::fromString(guid.guid());
+        }
+
+        if (localId.isNull()) {
+            status.errorCode = QContactManager::DoesNotExistError;
+            statusMap.insert(i, status);
+        } else {
+            localIds << localId;
+            indexes << i;
+        }
+    }
+
+    // the current extended details are needed because the save replaces all of them
+    QContactFetchHint hint;
+    hint.setDetailTypesHint(QList<QContactDetail::DetailType>() << QContactDetail::TypeExtendedDetail);
+    hint.setOptimizationHints(QContactFetchHint::NoRelationships |
+                              QContactFetchHint::NoActionPreferences |
+                              QContactFetchHint::NoBinaryBlobs);
+    QList<QContact> localContacts = getContacts(localIds, hint);
+    QHash<QContactId, QContact> localContactById;
+    foreach (const QContact &contact, localContacts) {
+        localContactById.insert(contact.id(), contact);
+    }
+
+    QList<QContact> toSave;
+    QList<int> toSaveIndexes;
+    for (int i = 0; i < localIds.size(); i++) {
+        if (!localContactById.contains(localIds.at(i))) {
+            status.errorCode = QContactManager::DoesNotExistError;
+            statusMap.insert(indexes.at(i), status);
+            continue;
+        }
+
+        QContact localContact = localContactById.value(localIds.at(i));
+        const QContact &newContact = aContactList.at(indexes.at(i));
+        bool changed = false;
+        foreach (const QString &field, syncFields) {
+            QVariant value = UContactsCustomDetail::getCustomField(newContact, field).data();
+            if (value.isValid() &&
+                (UContactsCustomDetail::getCustomField(localContact, field).data() != value)) {
+                UContactsCustomDetail::setCustomField(localContact, field, value);
+                changed = true;
+            }
+        }
+
+        if (changed) {
+            toSave << localContact;
+            toSaveIndexes << indexes.at(i);
+        } else {
+            // nothing to write
+            status.errorCode = QContactManager::NoError;
+            statusMap.insert(indexes.at(i), status);
+            updateCache(localContact);
+        }
+    }
+
+    QMap<int,QContactManager::Error> errors;
+    if (!toSave.isEmpty()) {
+        QList<QContactId> writtenIds;
+        foreach (const QContact &c, toSave) {
+            writtenIds << c.id();
+        }
+        mSyncWrites.registerIds(writtenIds);
+        if (iMgr->saveContacts(&toSave,
+                               QList<QContactDetail::DetailType>() << QContactDetail::TypeExtendedDetail,
+                               &errors)) {
+            LOG_DEBUG("Batch update of sync fields succeeded" << toSave.size());
+        } else {
+            LOG_DEBUG("Batch update of sync fields failed");
+        }
+        mSyncWrites.storedIds(writtenIds);
+    }
+
+    for (int i = 0; i < toSave.size(); i++) {
+        const QContact &c = toSave.at(i);
+        if (!errors.contains(i)) {
+            status.errorCode = QContactManager::NoError;
+            // update remote id map, this also drops the old remote id of the contact
+            updateCache(c);
+        } else {
+            LOG_DEBUG("contact with id " << c.id() << " is in error");
+            status.errorCode = errors.value(i);
+        }
+        statusMap.insert(toSaveIndexes.at(i), status);
+    }
+    return statusMap;
+}
+
 QMap<int, UContactsStatus>
 UContactsBackend::deleteContacts(const QStringList &aContactIDList)
 {
@@ -342,12 +504,14 @@ UContactsBackend::deleteContacts(const QList<QContactId> &aContactIDList) {
     QMap<int, QContactManager::Error> errors;
     QMap<int, UContactsStatus> statusMap;
 
+    mSyncWrites.registerIds(aContactIDList);
     if(aContactIDList.isEmpty() || iMgr->removeContacts(aContactIDList , &errors)) {
         LOG_DEBUG("Successfully Removed all contacts ");
     }
     else {
         LOG_WARNING("Failed Removing Contacts" << errors);
     }
+    mSyncWrites.storedIds(aContactIDList);
 
     // QContactManager will populate errorMap only for errors, but we use this as a status map,
     // so populate NoError if there's no error.
@@ -360,8 +524,7 @@ UContactsBackend::deleteContacts(const QList<QContactId> &aContactIDList) {
             statusMap.insert(i, status);
 
             // remove from remote id map
-            QString remoteId = mRemoteIdToLocalId.key(contactId);
-            mRemoteIdToLocalId.remove(remoteId);
+            mRemoteIdIndex.removeLocalId(contactId);
         }
         else
         {
@@ -384,48 +547,106 @@ UContactsBackend::getSpecifiedContactIds(const QContactChangeLogFilter::EventTyp
     FUNCTION_CALL_TRACE;
     Q_ASSERT(aIdList);
 
-    QList<QContactId> localIdList;
-    QContactChangeLogFilter filter(aEventType);
-    filter.setSince(aTimeStamp);
+    QSet<QContactId> idSet = changeLogContactIds(aEventType, aTimeStamp);
+    // Filter out ids for items that were added after the specified time.
+    if (aEventType != QContactChangeLogFilter::EventAdded) {
+        idSet.subtract(changeLogContactIds(QContactChangeLogFilter::EventAdded, aTimeStamp));
+    }
+
+    *aIdList = remoteIdsOf(idSet);
+}
+
+void
+UContactsBackend::getAllChangedContactIds(const QDateTime &aTimeStamp,
+                                          RemoteToLocalIdMap *aAddedIds,
+                                          RemoteToLocalIdMap *aModifiedIds,
+                                          RemoteToLocalIdMap *aDeletedIds)
+{
+    FUNCTION_CALL_TRACE;
+    Q_ASSERT(aAddedIds && aModifiedIds && aDeletedIds);
+    LOG_DEBUG("Retrieve Changed Contacts Since " << aTimeStamp);
+
+    QSet<QContactId> addedIds = changeLogContactIds(QContactChangeLogFilter::EventAdded, aTimeStamp);
+    QSet<QContactId> modifiedIds = changeLogContactIds(QContactChangeLogFilter::EventChanged, aTimeStamp);
+    QSet<QContactId> deletedIds = changeLogContactIds(QContactChangeLogFilter::EventRemoved, aTimeStamp);
 
-    localIdList = iMgr->contactIds(filter  & getSyncTargetFilter());
-    LOG_DEBUG("Local ID added =  " << localIdList.size() << "    Datetime from when this " << aTimeStamp.toString());
     // Filter out ids for items that were added after the specified time.
-    if (aEventType != QContactChangeLogFilter::EventAdded)
-    {
-        filter.setEventType(QContactChangeLogFilter::EventAdded);
-        QList<QContactId> addedList = iMgr->contactIds(filter  & getSyncTargetFilter());
-        foreach (const QContactId &id, addedList)
-        {
-            localIdList.removeAll(id);
+    modifiedIds.subtract(addedIds);
+    deletedIds.subtract(addedIds);
+    // a contact changed and then removed is only reported as removed
+    modifiedIds.subtract(deletedIds);
+
+    // a single fetch for the remote ids of all changed contacts
+    RemoteToLocalIdMap remoteIds = remoteIdsOf(addedIds + modifiedIds + deletedIds);
+    aAddedIds->clear();
+    aModifiedIds->clear();
+    aDeletedIds->clear();
+    RemoteToLocalIdMap::const_iterator i = remoteIds.constBegin();
+    for (; i != remoteIds.constEnd(); ++i) {
+        if (addedIds.contains(i.value())) {
+            aAddedIds->insertMulti(i.key(), i.value());
+        } else if (modifiedIds.contains(i.value())) {
+            aModifiedIds->insertMulti(i.key(), i.value());
+        } else {
+            aDeletedIds->insertMulti(i.key(), i.value());
         }
     }
+}
+
+bool
+UContactsBackend::hasChanges(const QDateTime &aTimeStamp)
+{
+    FUNCTION_CALL_TRACE;
+
+    return !changeLogContactIds(QContactChangeLogFilter::EventAdded, aTimeStamp).isEmpty() ||
+           !changeLogContactIds(QContactChangeLogFilter::EventChanged, aTimeStamp).isEmpty() ||
+           !changeLogContactIds(QContactChangeLogFilter::EventRemoved, aTimeStamp).isEmpty();
+}
+
+QSet<QContactId>
+UContactsBackend::changeLogContactIds(const QContactChangeLogFilter::EventType aEventType,
+                                      const QDateTime &aTimeStamp)
+{
+    QContactChangeLogFilter filter(aEventType);
+    filter.setSince(aTimeStamp);
+
+    QList<QContactId> localIdList = iMgr->contactIds(filter  & getSyncTargetFilter());
 
     // This is a defensive procedure to prevent duplicate items being sent.
-    // QSet does not allow duplicates, thus transforming QList to QSet and back
-    // again will remove any duplicate items in the original QList.
-    int originalIdCount = localIdList.size();
+    // QSet does not allow duplicates, thus transforming QList to QSet
+    // will remove any duplicate items in the original QList.
     QSet<QContactId> idSet = localIdList.toSet();
-    int idCountAfterDupRemoval = idSet.size();
-
-    LOG_DEBUG("Item IDs found (returned / incl. duplicates): " << idCountAfterDupRemoval << "/" << originalIdCount);
-    if (originalIdCount != idCountAfterDupRemoval) {
+    LOG_DEBUG("Item IDs found for event" << aEventType << "(returned / incl. duplicates): "
+              << idSet.size() << "/" << localIdList.size() << "since" << aTimeStamp.toString());
+    if (localIdList.size() != idSet.size()) {
         LOG_WARNING("Contacts backend returned duplicate items for requested list");
         LOG_WARNING("Duplicate item IDs have been removed");
     } // no else
 
-    localIdList = idSet.toList();
+    return idSet;
+}
+
+RemoteToLocalIdMap
+UContactsBackend::remoteIdsOf(const QSet<QContactId> &aContactIds)
+{
+    RemoteToLocalIdMap idList;
+    if (aContactIds.isEmpty()) {
+        return idList;
+    }
 
     QContactFetchHint remoteIdHint;
     QList <QContactDetail::DetailType> detailTypes;
     detailTypes << QContactExtendedDetail::Type;
     remoteIdHint.setDetailTypesHint(detailTypes);
+    remoteIdHint.setOptimizationHints(QContactFetchHint::NoRelationships |
+                                      QContactFetchHint::NoActionPreferences |
+                                      QContactFetchHint::NoBinaryBlobs);
 
-    QList<QContact> contacts = iMgr->contacts(localIdList, remoteIdHint);
+    QList<QContact> contacts = getContacts(aContactIds.toList(), remoteIdHint);
     foreach (const QContact &contact, contacts) {
-        QString rid = getRemoteId(contact);
-        aIdList->insertMulti(rid, contact.id());
+        idList.insertMulti(getRemoteId(contact), contact.id());
     }
+    return idList;
 }
 
 /*!
@@ -460,6 +681,33 @@ UContactsBackend::getContact(const QString& remoteId)
     return QContact();
 }
 
+QList<QContact>
+UContactsBackend::getContacts(const QList<QContactId> &aContactIds,
+                              const QContactFetchHint &aHint)
+{
+    FUNCTION_CALL_TRACE;
+    Q_ASSERT (iMgr);
+    QList<QContact> returnedContacts;
+    returnedContacts.reserve(aContactIds.size());
+
+    for (int i = 0; i < aContactIds.size(); i += CONTACTS_FETCH_CHUNK_SIZE) {
+        QMap<int, QContactManager::Error> errors;
+        QList<QContact> chunk = iMgr->contacts(aContactIds.mid(i, CONTACTS_FETCH_CHUNK_SIZE),
+                                               aHint,
+                                               &errors);
+        // missing contacts are returned as empty contacts
+        foreach (const QContact &contact, chunk) {
+            if (!contact.isEmpty()) {
+                returnedContacts << contact;
+            }
+        }
+    }
+
+    LOG_DEBUG("Contacts retreived from Contact manager  = " << returnedContacts.count()
+              << "of" << aContactIds.size());
+    return returnedContacts;
+}
+
 QContactId
 UContactsBackend::entryExists(const QString remoteId)
 {
@@ -468,7 +716,7 @@ UContactsBackend::entryExists(const QString remoteId)
     }
 
     // check cache
-    return mRemoteIdToLocalId.value(remoteId);
+    return mRemoteIdIndex.localId(remoteId);
 }
 
 QString
@@ -481,6 +729,7 @@ const QStringList
 UContactsBackend::localIds(const QStringList remoteIds)
 {
     QStringList localIdList;
+    localIdList.reserve(remoteIds.size());
     foreach (QString guid , remoteIds) {
         QString localId = entryExists(guid).toString();
         if (!localId.isEmpty()) {
@@ -501,14 +750,161 @@ void UContactsBackend::reloadCache()
         sourceFilter = getSyncTargetFilter();
     }
 
-    mRemoteIdToLocalId.clear();
+    mRemoteIdIndex.clear();
+    mIndexTimestamp = QDateTime::currentDateTimeUtc();
     hint.setDetailTypesHint(QList<QContactDetail::DetailType>() << QContactExtendedDetail::Type);
-    Q_FOREACH(const QContact &c,  iMgr->contacts(sourceFilter, sortOrder, hint)) {
-        QString remoteId = getRemoteId(c);
-        if (!remoteId.isEmpty()) {
-            mRemoteIdToLocalId.insert(remoteId, c.id());
+    QList<QContact> contacts = iMgr->contacts(sourceFilter, sortOrder, hint);
+    mRemoteIdIndex.reserve(contacts.size());
+    Q_FOREACH(const QContact &c, contacts) {
+        updateCache(c);
+    }
+
+    // a journal left by an interrupted sync is part of the rebuilt index, it
+    // is removed and the next journal applies to a saved index
+    saveCache();
+}
+
+void UContactsBackend::loadCache()
+{
+    FUNCTION_CALL_TRACE;
+
+    if (mIndexFileName.isEmpty()) {
+        reloadCache();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QDateTime startTime = QDateTime::currentDateTimeUtc();
+    QDateTime since;
+    if (!mRemoteIdIndex.load(mIndexFileName, mSyncTargetId, &since) ||
+        !since.isValid() || (since > startTime)) {
+        LOG_INFO("Remote id index is not valid, rebuilding it from the address book");
+        reloadCache();
+        return;
+    }
+
+    // apply local changes done since the index was saved
+    RemoteToLocalIdMap changedIds;
+    getSpecifiedContactIds(QContactChangeLogFilter::EventAdded, since, &changedIds);
+    getSpecifiedContactIds(QContactChangeLogFilter::EventChanged, since, &changedIds);
+    RemoteToLocalIdMap::const_iterator i = changedIds.constBegin();
+    for (; i != changedIds.constEnd(); ++i) {
+        // etags only change during the sync, keep the one stored on the index
+        mRemoteIdIndex.insert(i.key(), i.value(), mRemoteIdIndex.etag(i.key()));
+    }
+
+    RemoteToLocalIdMap removedIds;
+    getSpecifiedContactIds(QContactChangeLogFilter::EventRemoved, since, &removedIds);
+    foreach (const QContactId &id, removedIds.values()) {
+        mRemoteIdIndex.removeLocalId(id);
+    }
+
+    mIndexTimestamp = startTime;
+    LOG_DEBUG("Remote id index loaded with" << mRemoteIdIndex.size() << "entries,"
+              << changedIds.size() << "changed and" << removedIds.size() << "removed since"
+              << since.toString(Qt::ISODate) << "in" << timer.elapsed() << "ms");
+}
+
+bool UContactsBackend::saveCache()
+{
+    FUNCTION_CALL_TRACE;
+
+    if (mIndexFileName.isEmpty() || !mIndexTimestamp.isValid()) {
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(mIndexFileName).absolutePath());
+    return mRemoteIdIndex.save(mIndexFileName, mSyncTargetId, mIndexTimestamp);
+}
+
+bool UContactsBackend::appendCacheJournal(const QStringList &remoteIds)
+{
+    if (mIndexFileName.isEmpty() || remoteIds.isEmpty()) {
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(mIndexFileName).absolutePath());
+    return mRemoteIdIndex.appendJournal(mIndexFileName, mSyncTargetId, remoteIds);
+}
+
+QString UContactsBackend::entryETag(const QString &remoteId) const
+{
+    return mRemoteIdIndex.etag(remoteId);
+}
+
+QHash<QString, QString> UContactsBackend::entryETags() const
+{
+    return mRemoteIdIndex.etags();
+}
+
+QString UContactsBackend::entryRemoteId(const QContactId &localId) const
+{
+    return mRemoteIdIndex.remoteId(localId);
+}
+
+QStringList UContactsBackend::entryRemoteIds() const
+{
+    return mRemoteIdIndex.remoteIds();
+}
+
+QString UContactsBackend::conflictBaseFileName() const
+{
+    if (mIndexFileName.isEmpty()) {
+        return QString();
+    }
+
+    QFileInfo index(mIndexFileName);
+    return QString("%1/%2.base").arg(index.absolutePath()).arg(index.completeBaseName());
+}
+
+void UContactsBackend::finishSyncWrites()
+{
+    mSyncWrites.close();
+}
+
+void UContactsBackend::updateCache(const QContact &contact)
+{
+    mRemoteIdIndex.insert(getRemoteId(contact),
+                          contact.id(),
+                          UContactsCustomDetail::getCustomField(contact,
+                                                                UContactsCustomDetail::FieldContactETag).data().toString());
+}
+
+void UContactsBackend::setCacheDirectory(const QString &directory)
+{
+    mCacheDirectory = directory;
+}
+
+QString UContactsBackend::indexFileName(uint syncAccount) const
+{
+    QString directory = mCacheDirectory;
+    if (directory.isEmpty()) {
+        // memory/mock manager does not persist contacts
+        if (iMgr->managerName() == "mock") {
+            return QString();
         }
+        directory = QString("%1/buteo-sync-plugins-contacts")
+                .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation));
+    }
+
+    return QString("%1/%2-%3.idx")
+            .arg(directory)
+            .arg(syncAccount)
+            .arg(mSyncTargetId);
+}
+
+QString UContactsBackend::syncWritesFileName() const
+{
+    if (mIndexFileName.isEmpty()) {
+        return QString();
     }
+
+    // the storage change notifier looks for these files on UContactsSyncWrites::directory()
+    return QString("%1/%2.writes")
+            .arg(UContactsSyncWrites::directory())
+            .arg(QFileInfo(mIndexFileName).completeBaseName());
 }
 
 void UContactsBackend::removeSyncTarget()
@@ -516,6 +912,15 @@ void UContactsBackend::removeSyncTarget()
     if (iMgr && !mSyncTargetId.isEmpty()) {
         iMgr->removeContact(QContactId::fromString(QString("qtcontacts:galera::source@%1").arg(mSyncTargetId)));
     }
+
+    if (!mIndexFileName.isEmpty()) {
+        QFile::remove(conflictBaseFileName());
+        QFile::remove(UContactsConflictResolver::journalFileName(conflictBaseFileName()));
+        mSyncWrites.close();
+        QFile::remove(syncWritesFileName());
+        QFile::remove(mIndexFileName);
+        QFile::remove(URemoteIdIndex::journalFileName(mIndexFileName));
+    }
 }
 
 QString
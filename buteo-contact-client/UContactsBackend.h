@@ -30,11 +30,17 @@
 #include <QContact>
 #include <QContactId>
 #include <QContactFetchRequest>
+#include <QContactFetchHint>
 #include <QContactExtendedDetail>
 #include <QContactChangeLogFilter>
 #include <QContactManager>
 
 #include <QStringList>
+#include <QSet>
+#include <QDateTime>
+
+#include "URemoteIdIndex.h"
+#include "UContactsSyncWrites.h"
 
 QTCONTACTS_USE_NAMESPACE
 
@@ -67,6 +73,14 @@ public:
      */
     bool init(uint syncAccount, const QString &syncTarget);
 
+    /*!
+     * \brief Initialize the backend without loading the contact id cache
+     * The cache must be loaded with loadCache() before contacts are synced.
+     * \param syncTarget The name of the collection used to store contacts
+     * \return Returns true if initialized with sucess false otherwise
+     */
+    bool initSyncTarget(uint syncAccount, const QString &syncTarget);
+
     /*!
      * \brief releases the resources held.
      * @returnReturns true if sucess false otherwise
@@ -102,6 +116,34 @@ public:
      */
     RemoteToLocalIdMap getAllDeletedContactIds(const QDateTime& aTimeStamp);
 
+    /*!
+     * \brief Return the ids of every deleted contact not purged yet
+     * Unlike getAllDeletedContactIds() contacts added after any date are included.
+     * @return List of contact IDs
+     */
+    RemoteToLocalIdMap getAllUnpurgedDeletedContactIds();
+
+    /*!
+     * \brief Return all new, modified and deleted contact ids in a single pass
+     * A contact added after the timestamp is only reported as new, a contact
+     * removed after the timestamp is only reported as deleted.
+     * @param aTimeStamp Timestamp of the oldest contact ID to be returned
+     * @param aAddedIds Returned new contact IDs
+     * @param aModifiedIds Returned modified contact IDs
+     * @param aDeletedIds Returned deleted contact IDs
+     */
+    void getAllChangedContactIds(const QDateTime& aTimeStamp,
+                                 RemoteToLocalIdMap *aAddedIds,
+                                 RemoteToLocalIdMap *aModifiedIds,
+                                 RemoteToLocalIdMap *aDeletedIds);
+
+    /*!
+     * \brief Check if any contact was added, modified or deleted since the timestamp
+     * Only the change log is queried, the contact id cache is not needed.
+     * @param aTimeStamp Timestamp of the oldest change
+     */
+    bool hasChanges(const QDateTime& aTimeStamp);
+
     /*!
      * \brief Get contact data for a given contact ID as a QContact object
      * @param aContactId The ID of the contact
@@ -116,6 +158,16 @@ public:
      */
     QContact getContact(const QString& remoteId);
 
+    /*!
+     * \brief Batch fetch of contacts
+     * The contacts are requested in chunks to reduce the number of calls to the contacts service
+     * @param aContactIds The ids of the contacts
+     * @param aHint Restricts the details fetched
+     * @return The contacts found, in the same order as the ids
+     */
+    QList<QContact> getContacts(const QList<QContactId> &aContactIds,
+                                const QContactFetchHint &aHint = QContactFetchHint());
+
     /*!
      * \brief Batch addition of contacts
      * @param aContactDataList Contact data
@@ -134,6 +186,16 @@ public:
      */
     QMap<int, UContactsStatus> modifyContacts(QList<QtContacts::QContact> *aContactList);
 
+    /*!
+     * \brief Batch update of the sync fields of contacts
+     * Only the remote id, etag and avatar etag fields are written, the other
+     * details of the local contacts are left untouched.
+     * @param aContactList Contacts returned by the remote side, the local id is read
+     * from the remote id or from the guid field
+     * @return Errors
+     */
+    QMap<int, UContactsStatus> updateSyncFields(const QList<QtContacts::QContact> &aContactList);
+
     /*!
      * \brief Batch deletion of contacts
      * @param aContactIDList Contact IDs
@@ -208,11 +270,78 @@ public:
      */
     void purgecontacts(const QDateTime &date);
 
+    /*!
+     * \brief Set the directory of the files kept between syncs
+     * Must be called before the sync target is initialized. The memory and
+     * mock managers only keep files when a directory is set.
+     */
+    void setCacheDirectory(const QString &directory);
+
     /*!
      * \brief Reload contact id cache
+     * The rebuilt cache replaces the index file and its journal.
      */
     void reloadCache();
 
+    /*!
+     * \brief Load contact id cache from the index file and apply the local changes done after it was saved
+     * Falls back to reloadCache() if the index file is missing or invalid
+     */
+    void loadCache();
+
+    /*!
+     * \brief Store the contact id cache on the index file
+     * \return Returns true if the index file was written
+     */
+    bool saveCache();
+
+    /*!
+     * \brief Append the cache entries of some contacts to the journal of the index file
+     * The journal keeps the contacts stored since the last saveCache() call if
+     * the sync is interrupted, it is loaded by loadCache().
+     * \param remoteIds The remoteId of the contacts stored
+     * \return Returns true if the entries were written
+     */
+    bool appendCacheJournal(const QStringList &remoteIds);
+
+    /*!
+     * \brief Return the etag known for a remote contact
+     * \param remoteId The remoteId of the contact
+     * \return The etag or an empty string if the contact is not known
+     */
+    QString entryETag(const QString &remoteId) const;
+
+    /*!
+     * \brief Return the etags known for all remote contacts
+     * \return A map from remoteId to etag
+     */
+    QHash<QString, QString> entryETags() const;
+
+    /*!
+     * \brief Return the remote id of a contact stored locally
+     * \param localId The localId of the contact
+     * \return The remoteId or an empty string if the contact was never synced
+     */
+    QString entryRemoteId(const QContactId &localId) const;
+
+    /*!
+     * \brief Return the remote ids of all contacts stored locally
+     * \return A list with remoteId of the contacts
+     */
+    QStringList entryRemoteIds() const;
+
+    /*!
+     * \brief Return the file used to store the conflict resolution base
+     * \return The file name or an empty string if the manager does not persist contacts
+     */
+    QString conflictBaseFileName() const;
+
+    /*!
+     * \brief Close the window of contacts written by this sync
+     * Changes of these contacts notified later are ignored by the storage change notifier.
+     */
+    void finishSyncWrites();
+
     /*!
      * \brief Remove backend source
      */
@@ -232,6 +361,17 @@ private: // functions
                                 const QDateTime &aTimeStamp,
                                 RemoteToLocalIdMap *aIdList);
 
+    /*!
+     * \brief Returns the ids of contacts with a change log event after a timestamp
+     */
+    QSet<QContactId> changeLogContactIds(const QContactChangeLogFilter::EventType aEventType,
+                                         const QDateTime &aTimeStamp);
+
+    /*!
+     * \brief Fetch the remote ids of a set of contacts with a single hinted fetch
+     */
+    RemoteToLocalIdMap remoteIdsOf(const QSet<QContactId> &aContactIds);
+
     /*!
      * \brief Constructs and returns the filter for accessing only contacts allowed to be synchronized
      * Contacts not allowed to be synchronized are Instant messaging contacts and contacts with origin from other sync backends;
@@ -241,12 +381,20 @@ private: // functions
      */
     QContactFilter getSyncTargetFilter() const;
 
+    void updateCache(const QContact &contact);
+    QString indexFileName(uint syncAccount) const;
+    QString syncWritesFileName() const;
+
 private: // data
 
     // if there is more than one Manager we need to have a list of Managers
     QContactManager     *iMgr;      ///< A pointer to contact manager
     QString             mSyncTargetId;
-    QMap<QString, QContactId> mRemoteIdToLocalId;
+    URemoteIdIndex      mRemoteIdIndex;
+    QString             mCacheDirectory;
+    QString             mIndexFileName;
+    QDateTime           mIndexTimestamp;   ///< Time when the cache was last in sync with the address book
+    UContactsSyncWrites mSyncWrites;
 
 
     void createSourceForAccount(uint accountId, const QString &label);
@@ -26,8 +26,10 @@
 
 #include "UContactsClient.h"
 #include "UContactsBackend.h"
+#include "UContactsConflictResolver.h"
 #include "UAbstractRemoteSource.h"
 #include "UAuth.h"
+#include "UContactsCustomDetail.h"
 #include "config.h"
 
 //Buteo
@@ -38,10 +40,17 @@
 #include <QLibrary>
 #include <QtNetwork>
 #include <QDateTime>
+#include <QQueue>
+#include <QElapsedTimer>
 #include <QContactGuid>
 #include <QContactDetailFilter>
 #include <QContactAvatar>
 
+// number of fetched pages that can wait to be stored locally during slow sync,
+// while they wait the next page is downloaded. 0 disables the pipeline
+static const QString SLOW_SYNC_PENDING_PAGES_KEY  ("slow-sync-pending-pages");
+static const int     SLOW_SYNC_PENDING_PAGES      (2);
+
 class UContactsClientPrivate
 {
 public:
@@ -51,6 +60,15 @@ public:
           mRemoteSource(0),
           mSlowSync(false),
           mAborted(false),
+          mSlowSyncFetchDone(false),
+          mMaxPendingPages(SLOW_SYNC_PENDING_PAGES),
+          mAuthenticated(false),
+          mLocalReady(false),
+          mFirstResponseLogged(false),
+          mRemoteContactsReceived(false),
+          mAuthRetried(false),
+          mProbingChanges(false),
+          mUnchangedRemoteContacts(0),
           mServiceName(serviceName),
           mProgress(0),
           mAccountId(0),
@@ -65,13 +83,31 @@ public:
     bool                        mSlowSync;
     bool                        mAborted;
     QString                     mServiceName;
+    // slow sync pipeline
+    QQueue<QList<QContact> >    mPendingSlowSyncPages;
+    bool                        mSlowSyncFetchDone;
+    int                         mMaxPendingPages;
     // local database information
     QSet<QContactId>            mAllLocalContactIds;
     RemoteToLocalIdMap  mAddedContactIds;
     RemoteToLocalIdMap  mModifiedContactIds;
     RemoteToLocalIdMap  mDeletedContactIds;
+    // start-up, local data is prepared while authenticating
+    QElapsedTimer               mStartupTimer;
+    bool                        mAuthenticated;
+    bool                        mLocalReady;
+    bool                        mFirstResponseLogged;
+    bool                        mRemoteContactsReceived;
+    bool                        mAuthRetried;
+    // fast sync waiting for the remote changes count, local caches not loaded
+    bool                        mProbingChanges;
+    // remote etags used to reconcile a slow sync with the contacts already stored
+    QHash<QString, QString>     mRemoteManifest;
+    // last synced version of each contact, used to merge conflicts
+    UContactsConflictResolver   mConflictResolver;
     // sync report
     QMap<QString, Buteo::DatabaseResults> mItemResults;
+    int                         mUnchangedRemoteContacts;
     Buteo::SyncResults          mResults;
     qreal                       mProgress;
     // sync profile
@@ -107,6 +143,10 @@ UContactsClient::init()
 
     d->mProgress = 0.0;
     d->mAborted = false;
+    d->mSlowSyncFetchDone = false;
+    d->mPendingSlowSyncPages.clear();
+    d->mUnchangedRemoteContacts = 0;
+    d->mRemoteManifest.clear();
 
     if (lastSyncTime().isNull()) {
         d->mSlowSync = true;
@@ -216,9 +256,34 @@ UContactsClient::startSync()
 
     Q_D(UContactsClient);
     LOG_DEBUG ("Init done. Continuing with sync");
+    LOG_INFO("Sync Started at:" << QDateTime::currentDateTime().toUTC().toString(Qt::ISODate));
 
     stateChanged(Sync::SYNC_PROGRESS_INITIALISING);
-    return d->mAuth->authenticate();
+    d->mStartupTimer.start();
+    d->mAuthenticated = false;
+    d->mLocalReady = false;
+    d->mFirstResponseLogged = false;
+    d->mRemoteContactsReceived = false;
+    d->mAuthRetried = false;
+    d->mProbingChanges = false;
+
+    // none of the local work depends on the token, do it while signon
+    // authenticates, authentication may also succeed right away
+    if (!d->mAuth->authenticate()) {
+        return false;
+    }
+
+    if (!prepareLocalSync()) {
+        d->mAborted = true;
+        return false;
+    }
+    d->mLocalReady = true;
+    LOG_INFO("Local sync data ready in" << d->mStartupTimer.elapsed() << "ms");
+
+    if (d->mAuthenticated) {
+        return startRemoteSync();
+    }
+    return true;
 }
 
 void
@@ -260,6 +325,10 @@ UContactsClient::initConfig()
     d->mSyncDirection = iProfile.syncDirection();
     d->mConflictResPolicy = iProfile.conflictResolutionPolicy();
 
+    bool ok = false;
+    int pendingPages = iProfile.key(SLOW_SYNC_PENDING_PAGES_KEY).toInt(&ok);
+    d->mMaxPendingPages = ok ? qMax(0, pendingPages) : SLOW_SYNC_PENDING_PAGES;
+
     return true;
 }
 
@@ -288,6 +357,91 @@ UContactsClient::start()
     FUNCTION_CALL_TRACE;
     Q_D(UContactsClient);
 
+    LOG_INFO("Authenticated in" << d->mStartupTimer.elapsed() << "ms");
+    if (d->mAborted) {
+        LOG_WARNING("Sync aborted");
+        return false;
+    }
+
+    d->mAuthenticated = true;
+    if (!d->mLocalReady) {
+        // local data is still being prepared, startSync will continue
+        return true;
+    }
+    return startRemoteSync();
+}
+
+bool
+UContactsClient::prepareLocalSync()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    switch (d->mSyncDirection)
+    {
+    case Buteo::SyncProfile::SYNC_DIRECTION_TWO_WAY:
+        break;
+    case Buteo::SyncProfile::SYNC_DIRECTION_FROM_REMOTE:
+        LOG_WARNING("SYNC_DIRECTION_FROM_REMOTE: not implemented");
+        return false;
+    case Buteo::SyncProfile::SYNC_DIRECTION_TO_REMOTE:
+        LOG_WARNING("SYNC_DIRECTION_TO_REMOTE: not implemented");
+        return false;
+    case Buteo::SyncProfile::SYNC_DIRECTION_UNDEFINED:
+        // Not required
+    default:
+        // throw configuration error
+        return false;
+    };
+
+    if (!d->mContactBackend->initSyncTarget(d->mAccountId,
+                                            d->mAuth->accountDisplayName())) {
+        LOG_WARNING("Fail to init contact backend");
+        return false;
+    }
+
+    d->mConflictResolver.setPreferLocalChanges(d->mConflictResPolicy == Buteo::SyncProfile::CR_POLICY_PREFER_LOCAL_CHANGES);
+    d->mConflictResolver.setMergeDetailTypes(d->mRemoteSource->uploadFetchHint().detailTypesHint());
+    d->mConflictResolver.setDetailEncoder(d->mRemoteSource->uploadDetailEncoder());
+    d->mItemResults.insert(syncTargetId(), Buteo::DatabaseResults());
+
+    // most fast syncs have nothing to do, without local changes the caches
+    // are only loaded if the remote side reports changes
+    if (!d->mSlowSync && !d->mContactBackend->hasChanges(lastSyncTime())) {
+        LOG_INFO("No local changes since last sync");
+        d->mProbingChanges = true;
+        return true;
+    }
+
+    loadLocalSyncData();
+    return true;
+}
+
+void
+UContactsClient::loadLocalSyncData()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    d->mContactBackend->loadCache();
+    QString conflictBaseFile = d->mContactBackend->conflictBaseFileName();
+    if (!conflictBaseFile.isEmpty()) {
+        d->mConflictResolver.load(conflictBaseFile);
+    }
+
+    QDateTime sinceDate = d->mSlowSync ? QDateTime() : lastSyncTime();
+    LOG_DEBUG("load all contacts since" << sinceDate << sinceDate.isValid());
+    // load changed contact since the last sync date or all contacts if no
+    // sync was done before
+    loadLocalContacts(sinceDate);
+}
+
+bool
+UContactsClient::startRemoteSync()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
     /*
       1. If no previous sync, go for slow-sync. Fetch all contacts
          from server
@@ -302,87 +456,313 @@ UContactsClient::start()
       8. Save the sync log
      */
 
-    // Remote source will be create after authentication since it needs some information
+    // Remote source is initialized after authentication since it needs some information
     // about the authentication (auth-token, etc..)
-
-    LOG_INFO("Sync Started at:" << QDateTime::currentDateTime().toUTC().toString(Qt::ISODate));
-    if (d->mAborted) {
-        LOG_WARNING("Sync aborted");
-        return false;
-    }
-
     stateChanged(Sync::SYNC_PROGRESS_RECEIVING_ITEMS);
 
     if (!d->mRemoteSource->init(remoteSourceProperties())) {
         LOG_WARNING("Fail to init remote source");
+        emit syncFinished(Sync::SYNC_ERROR);
         return false;
     }
 
-    if (!d->mContactBackend->init(d->mAccountId,
-                                  d->mAuth->accountDisplayName())) {
-        LOG_WARNING("Fail to init contact backend");
-        return false;
+    if (d->mProbingChanges) {
+        connect(d->mRemoteSource,
+                SIGNAL(changesProbed(int,Sync::SyncStatus)),
+                SLOT(onRemoteChangesProbed(int,Sync::SyncStatus)));
+        if (d->mRemoteSource->probeChanges(lastSyncTime())) {
+            LOG_INFO("First remote request issued after" << d->mStartupTimer.elapsed() << "ms");
+            return true;
+        }
+
+        // probes not supported, continue with a full fast sync
+        disconnect(d->mRemoteSource,
+                   SIGNAL(changesProbed(int,Sync::SyncStatus)),
+                   this,
+                   SLOT(onRemoteChangesProbed(int,Sync::SyncStatus)));
+        d->mProbingChanges = false;
+        loadLocalSyncData();
     }
 
-    d->mItemResults.insert(syncTargetId(), Buteo::DatabaseResults());
-    switch (d->mSyncDirection)
-    {
-    case Buteo::SyncProfile::SYNC_DIRECTION_TWO_WAY:
-    {
-        QDateTime sinceDate = d->mSlowSync ? QDateTime() : lastSyncTime();
+    return startRemoteFetch();
+}
 
-        LOG_DEBUG("load all contacts since" << sinceDate << sinceDate.isValid());
-        // load changed contact since the last sync date or all contacts if no
-        // sync was done before
-        loadLocalContacts(sinceDate);
+bool
+UContactsClient::startRemoteFetch()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
 
-        // load remote contacts
-        if (d->mSlowSync) {
-            connect(d->mRemoteSource,
-                    SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
-                    SLOT(onRemoteContactsFetchedForSlowSync(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)));
-        } else {
-            connect(d->mRemoteSource,
-                    SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
-                    SLOT(onRemoteContactsFetchedForFastSync(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
-        }
-        d->mRemoteSource->fetchContacts(sinceDate, !d->mSlowSync, true);
-        break;
+    // a slow sync of a sync target that already has synced contacts
+    // only transfers the contacts that differ from the remote ones
+    if (d->mSlowSync && startManifestReconciliation()) {
+        LOG_INFO("First remote request issued after" << d->mStartupTimer.elapsed() << "ms");
+        return true;
     }
-    case Buteo::SyncProfile::SYNC_DIRECTION_FROM_REMOTE:
-        LOG_WARNING("SYNC_DIRECTION_FROM_REMOTE: not implemented");
-        return false;
-    case Buteo::SyncProfile::SYNC_DIRECTION_TO_REMOTE:
-        LOG_WARNING("SYNC_DIRECTION_TO_REMOTE: not implemented");
+
+    // load remote contacts
+    QDateTime sinceDate = d->mSlowSync ? QDateTime() : lastSyncTime();
+    if (d->mSlowSync) {
+        connect(d->mRemoteSource,
+                SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
+                SLOT(onRemoteContactsFetchedForSlowSync(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)));
+        d->mRemoteSource->setKnownETags(QHash<QString, QString>());
+    } else {
+        connect(d->mRemoteSource,
+                SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
+                SLOT(onRemoteContactsFetchedForFastSync(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+        // remote contacts with the same etag as the local copy are not fetched again
+        connect(d->mRemoteSource,
+                SIGNAL(contactsUnchanged(QStringList)),
+                SLOT(onRemoteContactsUnchanged(QStringList)));
+        d->mRemoteSource->setKnownETags(d->mContactBackend->entryETags());
+    }
+    d->mRemoteSource->fetchContacts(sinceDate, !d->mSlowSync, true);
+    LOG_INFO("First remote request issued after" << d->mStartupTimer.elapsed() << "ms");
+    return true;
+}
+
+bool
+UContactsClient::retryAuthentication(Sync::SyncStatus status)
+{
+    Q_D(UContactsClient);
+
+    if ((status == Sync::SYNC_PROGRESS) || (status == Sync::SYNC_DONE)) {
+        d->mRemoteContactsReceived = true;
         return false;
-    case Buteo::SyncProfile::SYNC_DIRECTION_UNDEFINED:
-        // Not required
-    default:
-        // throw configuration error
+    }
+
+    // a cached token can be rejected before it expires, refresh it once and
+    // start the remote sync again if nothing was received yet
+    if ((status != Sync::SYNC_AUTHENTICATION_FAILURE) ||
+        d->mAuthRetried || d->mRemoteContactsReceived) {
         return false;
-        break;
-    };
+    }
 
+    LOG_WARNING("Authentication token rejected, refreshing it");
+    d->mAuthRetried = true;
+    d->mAuthenticated = false;
+    d->mRemoteManifest.clear();
+    // connections are done again by startRemoteSync
+    disconnect(d->mRemoteSource, 0, this, 0);
+    d->mAuth->invalidateToken();
+    // the remote source is still handling the error, authenticate from the event loop
+    QMetaObject::invokeMethod(this, "refreshAuthentication", Qt::QueuedConnection);
     return true;
 }
 
+void
+UContactsClient::refreshAuthentication()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    if (d->mAborted) {
+        return;
+    }
+
+    if (!d->mAuth->authenticate()) {
+        emit syncFinished(Sync::SYNC_AUTHENTICATION_FAILURE);
+    }
+}
+
+void
+UContactsClient::logFirstResponse()
+{
+    Q_D(UContactsClient);
+
+    if (!d->mFirstResponseLogged) {
+        d->mFirstResponseLogged = true;
+        LOG_INFO("Time to first byte:" << d->mStartupTimer.elapsed() << "ms");
+    }
+}
+
 QList<QContact>
 UContactsClient::prepareContactsToUpload(UContactsBackend *backend,
                                          const QSet<QContactId> &ids)
 {
-    QList<QContact> toUpdate;
+    Q_D(UContactsClient);
+
+    if (ids.isEmpty()) {
+        return QList<QContact>();
+    }
+
+    // one call for many contacts, only with the details used by the remote source
+    QList<QContact> toUpdate = backend->getContacts(ids.toList(),
+                                                    d->mRemoteSource->uploadFetchHint());
+    if (toUpdate.size() != ids.size()) {
+        LOG_CRITICAL("Fail to find" << (ids.size() - toUpdate.size()) << "local contacts");
+        return QList<QContact>();
+    }
+
+    return toUpdate;
+}
+
+bool
+UContactsClient::startManifestReconciliation()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    if (d->mContactBackend->entryRemoteIds().isEmpty()) {
+        return false;
+    }
+
+    connect(d->mRemoteSource,
+            SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
+            SLOT(onRemoteManifestFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)));
+    if (!d->mRemoteSource->fetchManifest()) {
+        LOG_DEBUG("Remote source does not support manifests, using slow sync");
+        disconnect(d->mRemoteSource,
+                   SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
+                   this,
+                   SLOT(onRemoteManifestFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)));
+        return false;
+    }
+
+    LOG_INFO("Reconciling local contacts with the remote manifest");
+    return true;
+}
+
+void
+UContactsClient::onRemoteManifestFetched(const QList<QContact> contacts,
+                                         Sync::SyncStatus status,
+                                         qreal progress)
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+    logFirstResponse();
+
+    if (d->mAborted) {
+        LOG_WARNING("Sync aborted");
+        return;
+    }
+
+    if (retryAuthentication(status)) {
+        return;
+    }
+
+    if ((status != Sync::SYNC_PROGRESS) && (status != Sync::SYNC_STARTED)) {
+        // the same signal delivers the contacts fetched after the manifest
+        disconnect(d->mRemoteSource,
+                   SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
+                   this,
+                   SLOT(onRemoteManifestFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)));
+    }
 
-    foreach(const QContactId &id, ids) {
-        QContact contact = backend->getContact(id);
-        if (!contact.isEmpty()) {
-            toUpdate << contact;
+    if ((status == Sync::SYNC_PROGRESS) || (status == Sync::SYNC_DONE)) {
+        foreach (const QContact &contact, contacts) {
+            QString etag = UContactsCustomDetail::getCustomField(contact,
+                                                                 UContactsCustomDetail::FieldContactETag).data().toString();
+            d->mRemoteManifest.insert(UContactsBackend::getRemoteId(contact), etag);
+        }
+
+        if (status == Sync::SYNC_DONE) {
+            reconcileWithManifest();
         } else {
-            LOG_CRITICAL("Fail to find local contact with id:" << id);
-            return QList<QContact>();
+            stateChanged(qRound(progress * 100));
         }
+    } else {
+        d->mRemoteManifest.clear();
+        emit syncFinished(status);
     }
+}
 
-    return toUpdate;
+void
+UContactsClient::reconcileWithManifest()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    // remote contacts added or changed since they were stored locally
+    QHash<QString, QString> localETags = d->mContactBackend->entryETags();
+    QStringList changedRemoteIds;
+    QHash<QString, QString>::const_iterator i = d->mRemoteManifest.constBegin();
+    for (; i != d->mRemoteManifest.constEnd(); ++i) {
+        if (localETags.value(i.key()) != i.value()) {
+            changedRemoteIds << i.key();
+        }
+    }
+
+    // remote contacts removed since they were stored locally
+    QStringList removedRemoteIds;
+    foreach (const QString &remoteId, d->mContactBackend->entryRemoteIds()) {
+        if (!d->mRemoteManifest.contains(remoteId)) {
+            removedRemoteIds << remoteId;
+        }
+    }
+
+    // local changes since the contacts were stored: contacts never uploaded,
+    // paired contacts that differ from the stored version (the base) and
+    // paired contacts removed locally
+    d->mAddedContactIds.clear();
+    d->mModifiedContactIds.clear();
+    d->mDeletedContactIds.clear();
+    QList<QContactId> pairedIds;
+    foreach (const QContactId &localId, d->mAllLocalContactIds) {
+        QString remoteId = d->mContactBackend->entryRemoteId(localId);
+        if (remoteId.isEmpty()) {
+            d->mAddedContactIds.insert(QString(), localId);
+        } else if (d->mConflictResolver.hasBase(remoteId)) {
+            // contacts without base are considered unchanged, there is
+            // nothing to compare them with
+            pairedIds << localId;
+        }
+    }
+
+    foreach (const QContact &contact, d->mContactBackend->getContacts(pairedIds,
+                                                                       d->mRemoteSource->uploadFetchHint())) {
+        if (!d->mConflictResolver.matchesBase(contact)) {
+            d->mModifiedContactIds.insert(UContactsBackend::getRemoteId(contact), contact.id());
+        }
+    }
+
+    // removed contacts are no longer on the index, a deleted contact with a
+    // base was stored by a sync and is still paired with the remote one
+    RemoteToLocalIdMap deletedIds = d->mContactBackend->getAllUnpurgedDeletedContactIds();
+    RemoteToLocalIdMap::const_iterator deleted = deletedIds.constBegin();
+    for (; deleted != deletedIds.constEnd(); ++deleted) {
+        if (!deleted.key().isEmpty() &&
+            d->mConflictResolver.hasBase(deleted.key()) &&
+            d->mContactBackend->entryExists(deleted.key()).isNull()) {
+            d->mDeletedContactIds.insert(deleted.key(), deleted.value());
+        }
+    }
+
+    int unchanged = d->mRemoteManifest.size() - changedRemoteIds.size();
+    LOG_INFO("Manifest reconciliation:"
+             << "\n\tRemote contacts:" << d->mRemoteManifest.size()
+             << "\n\tUnchanged:" << unchanged
+             << "\n\tChanged on remote:" << changedRemoteIds.size()
+             << "\n\tRemoved from remote:" << removedRemoteIds.size()
+             << "\n\tNew local contacts:" << d->mAddedContactIds.size()
+             << "\n\tChanged local contacts:" << d->mModifiedContactIds.size()
+             << "\n\tRemoved local contacts:" << d->mDeletedContactIds.size());
+    d->mUnchangedRemoteContacts += unchanged;
+    d->mRemoteManifest.clear();
+
+    // from here it works like a fast sync restricted to the differing contacts
+    d->mSlowSync = false;
+
+    if (!removedRemoteIds.isEmpty()) {
+        // removals are not fetched, handle them as removed remote contacts
+        // to resolve the conflicts with the local changes
+        QList<QContact> removedContacts;
+        foreach (const QString &remoteId, removedRemoteIds) {
+            QContact contact;
+            UContactsBackend::setRemoteId(contact, remoteId);
+            UContactsCustomDetail::setCustomField(contact,
+                                                  UContactsCustomDetail::FieldDeletedAt,
+                                                  QDateTime::currentDateTime());
+            removedContacts << contact;
+        }
+        storeToLocalForFastSync(removedContacts);
+    }
+
+    connect(d->mRemoteSource,
+            SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus,qreal)),
+            SLOT(onRemoteContactsFetchedForFastSync(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+    d->mRemoteSource->fetchContactsById(changedRemoteIds);
 }
 
 void
@@ -392,46 +772,101 @@ UContactsClient::onRemoteContactsFetchedForSlowSync(const QList<QContact> contac
 {
     FUNCTION_CALL_TRACE;
     Q_D(UContactsClient);
+    logFirstResponse();
 
     if (d->mAborted) {
         LOG_WARNING("Sync aborted");
         return;
     }
 
+    if (retryAuthentication(status)) {
+        return;
+    }
+
     if ((status != Sync::SYNC_PROGRESS) && (status != Sync::SYNC_STARTED)) {
-        disconnect(d->mRemoteSource);
+        disconnect(d->mRemoteSource, 0, this, 0);
     }
 
     if ((status == Sync::SYNC_PROGRESS) || (status == Sync::SYNC_DONE)) {
-        // save remote contacts locally
-        storeToLocalForSlowSync(contacts);
-
-        if (status == Sync::SYNC_DONE) {
-            stateChanged(Sync::SYNC_PROGRESS_SENDING_ITEMS);
-            QList<QContact> toUpload = prepareContactsToUpload(d->mContactBackend, d->mAllLocalContactIds);
-            connect(d->mRemoteSource,
-                    SIGNAL(transactionCommited(QList<QtContacts::QContact>,
-                                               QList<QtContacts::QContact>,
-                                               QStringList,
-                                               QMap<QString, int>,
-                                               Sync::SyncStatus)),
-                    SLOT(onContactsSavedForSlowSync(QList<QtContacts::QContact>,
-                                                    QList<QtContacts::QContact>,
-                                                    QStringList,
-                                                    QMap<QString, int>,
-                                                    Sync::SyncStatus)));
-
-            d->mRemoteSource->transaction();
-            d->mRemoteSource->saveContacts(toUpload);
-            d->mRemoteSource->commit();
+        if (d->mMaxPendingPages > 0) {
+            // Pipelined mode: the remote source requests the next page as soon
+            // as this function returns, so we only queue the page here and store
+            // it from the event loop while the next page is being downloaded.
+            d->mPendingSlowSyncPages.enqueue(contacts);
+            d->mSlowSyncFetchDone = (status == Sync::SYNC_DONE);
+
+            // keep the memory bounded: if the storage is behind the network
+            // store the oldest pages now, this delays the next fetch.
+            while (d->mPendingSlowSyncPages.size() > d->mMaxPendingPages) {
+                LOG_DEBUG("Slow sync pipeline full, storing page before fetching more");
+                storeToLocalForSlowSync(d->mPendingSlowSyncPages.dequeue());
+            }
+            QMetaObject::invokeMethod(this, "storeNextPageForSlowSync", Qt::QueuedConnection);
         } else {
+            // save remote contacts locally
+            storeToLocalForSlowSync(contacts);
+            if (status == Sync::SYNC_DONE) {
+                uploadLocalContactsForSlowSync();
+            }
+        }
+
+        if (status != Sync::SYNC_DONE) {
             stateChanged(qRound(progress * 100));
         }
     } else {
+        d->mPendingSlowSyncPages.clear();
         emit syncFinished(status);
     }
 }
 
+void
+UContactsClient::storeNextPageForSlowSync()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    if (d->mAborted) {
+        LOG_WARNING("Sync aborted");
+        d->mPendingSlowSyncPages.clear();
+        return;
+    }
+
+    // one page per call, this gives the network a chance to run between pages
+    if (!d->mPendingSlowSyncPages.isEmpty()) {
+        storeToLocalForSlowSync(d->mPendingSlowSyncPages.dequeue());
+    }
+
+    if (d->mPendingSlowSyncPages.isEmpty() && d->mSlowSyncFetchDone) {
+        d->mSlowSyncFetchDone = false;
+        uploadLocalContactsForSlowSync();
+    }
+}
+
+void
+UContactsClient::uploadLocalContactsForSlowSync()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+
+    stateChanged(Sync::SYNC_PROGRESS_SENDING_ITEMS);
+    QList<QContact> toUpload = prepareContactsToUpload(d->mContactBackend, d->mAllLocalContactIds);
+    connect(d->mRemoteSource,
+            SIGNAL(transactionCommited(QList<QtContacts::QContact>,
+                                       QList<QtContacts::QContact>,
+                                       QStringList,
+                                       QMap<QString, int>,
+                                       Sync::SyncStatus)),
+            SLOT(onContactsSavedForSlowSync(QList<QtContacts::QContact>,
+                                            QList<QtContacts::QContact>,
+                                            QStringList,
+                                            QMap<QString, int>,
+                                            Sync::SyncStatus)));
+
+    d->mRemoteSource->transaction();
+    d->mRemoteSource->saveContacts(toUpload);
+    d->mRemoteSource->commit();
+}
+
 void
 UContactsClient::onContactsSavedForSlowSync(const QList<QtContacts::QContact> &createdContacts,
                                             const QList<QtContacts::QContact> &updatedContacts,
@@ -454,7 +889,7 @@ UContactsClient::onContactsSavedForSlowSync(const QList<QtContacts::QContact> &c
                 << "\n\tError reported:" << errorMap.size());
 
     if ((status != Sync::SYNC_PROGRESS) && (status != Sync::SYNC_STARTED)) {
-        disconnect(d->mRemoteSource);
+        disconnect(d->mRemoteSource, 0, this, 0);
     }
 
     if ((status == Sync::SYNC_PROGRESS) || (status == Sync::SYNC_DONE)) {
@@ -476,10 +911,9 @@ UContactsClient::onContactsSavedForSlowSync(const QList<QtContacts::QContact> &c
             return;
         } else {
             stateChanged(Sync::SYNC_PROGRESS_FINALISING);
-            // WORKARDOUND: 'galera' contacts service take a while to fire contacts
-            // changed singal, this can cause a new sync due the storage change plugin
-            // lets wait 2 secs before fire sync finished signal
-            QTimer::singleShot(2000, this, SLOT(fireSyncFinishedSucessfully()));
+            // change signals of the contacts written by the sync are ignored by the
+            // storage change notifier, there is no need to wait for them
+            QMetaObject::invokeMethod(this, "fireSyncFinishedSucessfully", Qt::QueuedConnection);
             return;
         }
     }
@@ -487,20 +921,74 @@ UContactsClient::onContactsSavedForSlowSync(const QList<QtContacts::QContact> &c
     emit syncFinished(status);
 }
 
+void UContactsClient::onRemoteChangesProbed(int count, Sync::SyncStatus status)
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+    logFirstResponse();
+
+    if (d->mAborted) {
+        LOG_WARNING("Sync aborted");
+        return;
+    }
+
+    if ((status != Sync::SYNC_DONE) && retryAuthentication(status)) {
+        return;
+    }
+
+    disconnect(d->mRemoteSource,
+               SIGNAL(changesProbed(int,Sync::SyncStatus)),
+               this,
+               SLOT(onRemoteChangesProbed(int,Sync::SyncStatus)));
+    d->mProbingChanges = false;
+
+    if ((status == Sync::SYNC_DONE) && (count == 0)) {
+        LOG_INFO("Nothing changed since last sync, done in" << d->mStartupTimer.elapsed() << "ms");
+        stateChanged(Sync::SYNC_PROGRESS_FINALISING);
+        emit syncFinished(Sync::SYNC_DONE);
+        return;
+    }
+
+    if (status == Sync::SYNC_DONE) {
+        LOG_INFO("Remote changes since last sync:" << count);
+    } else {
+        LOG_WARNING("Fail to probe remote changes:" << status << "continuing with fast sync");
+    }
+
+    loadLocalSyncData();
+    startRemoteFetch();
+}
+
+void UContactsClient::onRemoteContactsUnchanged(const QStringList &ids)
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(UContactsClient);
+    logFirstResponse();
+    d->mRemoteContactsReceived = true;
+
+    LOG_DEBUG("Skipping unchanged remote contacts:" << ids.size());
+    d->mUnchangedRemoteContacts += ids.size();
+}
+
 void UContactsClient::onRemoteContactsFetchedForFastSync(const QList<QContact> contacts,
                                                          Sync::SyncStatus status,
                                                          qreal progress)
 {
     FUNCTION_CALL_TRACE;
     Q_D(UContactsClient);
+    logFirstResponse();
 
     if (d->mAborted) {
         LOG_WARNING("Sync aborted");
         return;
     }
 
+    if (retryAuthentication(status)) {
+        return;
+    }
+
     if ((status != Sync::SYNC_PROGRESS) && (status != Sync::SYNC_STARTED)) {
-        disconnect(d->mRemoteSource);
+        disconnect(d->mRemoteSource, 0, this, 0);
     }
 
     if ((status == Sync::SYNC_PROGRESS) || (status == Sync::SYNC_DONE)) {
@@ -519,8 +1007,17 @@ void UContactsClient::onRemoteContactsFetchedForFastSync(const QList<QContact> c
 
             // Contacts modified locally
             LOG_DEBUG("Total number of Contacts MODIFIED : " << d->mModifiedContactIds.count());
-            contactsToUpload += prepareContactsToUpload(d->mContactBackend,
-                                                        d->mModifiedContactIds.values().toSet());
+            // skip contacts touched locally without changes on the uploaded fields
+            int unchanged = 0;
+            foreach (const QContact &contact, prepareContactsToUpload(d->mContactBackend,
+                                                                      d->mModifiedContactIds.values().toSet())) {
+                if (d->mConflictResolver.matchesBase(contact)) {
+                    unchanged++;
+                } else {
+                    contactsToUpload << contact;
+                }
+            }
+            LOG_DEBUG("Modified contacts without changes to upload:" << unchanged);
 
             // Contacts deleted locally
             LOG_DEBUG("Total number of Contacts DELETED : " << d->mDeletedContactIds.count());
@@ -575,7 +1072,7 @@ UContactsClient::onContactsSavedForFastSync(const QList<QtContacts::QContact> &c
                 << "\n\tError reported:" << errorMap.size());
 
     if ((status != Sync::SYNC_PROGRESS) && (status != Sync::SYNC_STARTED)) {
-        disconnect(d->mRemoteSource);
+        disconnect(d->mRemoteSource, 0, this, 0);
     }
 
     if ((status == Sync::SYNC_PROGRESS) || (status == Sync::SYNC_DONE)) {
@@ -609,10 +1106,9 @@ UContactsClient::onContactsSavedForFastSync(const QList<QtContacts::QContact> &c
             return;
         } else {
             stateChanged(Sync::SYNC_PROGRESS_FINALISING);
-            // WORKARDOUND: 'galera' contacts service take a while to fire contacts
-            // changed singal, this can cause a new sync due the storage change plugin
-            // lets wait 2 secs before fire sync finished signal
-            QTimer::singleShot(2000, this, SLOT(fireSyncFinishedSucessfully()));
+            // change signals of the contacts written by the sync are ignored by the
+            // storage change notifier, there is no need to wait for them
+            QMetaObject::invokeMethod(this, "fireSyncFinishedSucessfully", Qt::QueuedConnection);
             return;
         }
     }
@@ -674,6 +1170,19 @@ UContactsClient::storeToLocalForSlowSync(const QList<QContact> &remoteContacts)
         if (d->mContactBackend->addContacts(cpyContacts, &statusMap)) {
             // TODO: Saving succeeded. Update sync results
             syncSuccess = true;
+            d->mConflictResolver.setBase(remoteContacts);
+
+            // journal the stored page, an interrupted slow sync resumes with a
+            // manifest reconciliation instead of storing the page again
+            QStringList remoteIds;
+            foreach (const QContact &contact, remoteContacts) {
+                remoteIds << UContactsBackend::getRemoteId(contact);
+            }
+            d->mContactBackend->appendCacheJournal(remoteIds);
+            QString conflictBaseFile = d->mContactBackend->conflictBaseFileName();
+            if (!conflictBaseFile.isEmpty()) {
+                d->mConflictResolver.appendJournal(conflictBaseFile, remoteIds);
+            }
 
             // sync report
             addProcessedItem(Sync::ITEM_ADDED,
@@ -704,8 +1213,29 @@ UContactsClient::storeToLocalForFastSync(const QList<QContact> &remoteContacts)
                                              remoteModifiedContacts,
                                              remoteDeletedContacts);
 
+    // the remote version is the base of the next sync, not the merged one
+    QList<QContact> remoteModifiedVersions(remoteModifiedContacts);
     resolveConflicts(remoteModifiedContacts, remoteDeletedContacts);
 
+    // the local copy of contacts not modified locally matches the base, if the
+    // remote content did not change too only the etag needs to be stored
+    QList<QContact> remoteUnchangedContacts;
+    QList<QContact>::iterator iter = remoteModifiedContacts.begin();
+    while (iter != remoteModifiedContacts.end()) {
+        if (!d->mModifiedContactIds.contains(UContactsBackend::getRemoteId(*iter)) &&
+            d->mConflictResolver.matchesBase(*iter)) {
+            remoteUnchangedContacts << *iter;
+            iter = remoteModifiedContacts.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    if (!remoteUnchangedContacts.isEmpty()) {
+        LOG_DEBUG ("***Updating sync fields of " << remoteUnchangedContacts.size() << " unchanged contacts");
+        d->mContactBackend->updateSyncFields(remoteUnchangedContacts);
+    }
+
     if (!remoteAddedContacts.isEmpty()) {
         LOG_DEBUG ("***Adding " << remoteAddedContacts.size() << " contacts");
         QMap<int, UContactsStatus> addedStatusMap;
@@ -736,12 +1266,16 @@ UContactsClient::storeToLocalForFastSync(const QList<QContact> &remoteContacts)
         }
     }
 
+    d->mConflictResolver.setBase(remoteAddedContacts);
+    d->mConflictResolver.setBase(remoteModifiedVersions);
+
     if (!remoteDeletedContacts.isEmpty()) {
         LOG_DEBUG ("***Deleting " << remoteDeletedContacts.size() << " contacts");
         QStringList guidList;
         for (int i=0; i<remoteDeletedContacts.size(); i++) {
             guidList << UContactsBackend::getRemoteId(remoteDeletedContacts.at(i));
         }
+        d->mConflictResolver.removeBase(guidList);
 
         QStringList localIdList = d->mContactBackend->localIds(guidList);
         QMap<int, UContactsStatus> deletedStatusMap =
@@ -785,9 +1319,10 @@ UContactsClient::loadLocalContacts(const QDateTime &since)
 
         LOG_DEBUG ("Number of contacts:" << d->mAllLocalContactIds.size ());
     } else {
-        d->mAddedContactIds = d->mContactBackend->getAllNewContactIds(since);
-        d->mModifiedContactIds = d->mContactBackend->getAllModifiedContactIds(since);
-        d->mDeletedContactIds = d->mContactBackend->getAllDeletedContactIds(since);
+        d->mContactBackend->getAllChangedContactIds(since,
+                                                    &d->mAddedContactIds,
+                                                    &d->mModifiedContactIds,
+                                                    &d->mDeletedContactIds);
 
         LOG_DEBUG ("Number of local added contacts:" << d->mAddedContactIds.size());
         LOG_DEBUG ("Number of local modified contacts:" << d->mModifiedContactIds.size());
@@ -810,6 +1345,10 @@ UContactsClient::onSyncFinished(Sync::SyncStatus aState)
 
     LOG_INFO("Sync finished with state:" << aState);
 
+    if (d->mContactBackend) {
+        d->mContactBackend->finishSyncWrites();
+    }
+
     switch(aState)
     {
         case Sync::SYNC_ERROR:
@@ -823,6 +1362,11 @@ UContactsClient::onSyncFinished(Sync::SyncStatus aState)
             break;
         }
         case Sync::SYNC_DONE:
+            // keep the id cache and the conflict base for the next sync
+            if (d->mContactBackend->saveCache() &&
+                !d->mContactBackend->conflictBaseFileName().isEmpty()) {
+                d->mConflictResolver.save(d->mContactBackend->conflictBaseFileName());
+            }
             // purge all deleted contacts
             d->mContactBackend->purgecontacts(lastSyncTime());
         case Sync::SYNC_ABORTED:
@@ -918,57 +1462,36 @@ UContactsClient::resolveConflicts(QList<QContact> &modifiedRemoteContacts,
     FUNCTION_CALL_TRACE;
     Q_D(UContactsClient);
 
-    // TODO: Handle conflicts. The steps:
-    // o Compare the list of local modified/deleted contacts with
-    //   the list of remote modified/deleted contacts
-    // o Create a new list (a map maybe) that has the contacts to
-    //   be modified/deleted using the conflict resolution policy
-    //   (server-wins, client-wins, add-new)
-    // o Return the list
-
-    //QListIterator<GContactEntry*> iter (modifiedRemoteContacts);
-    QList<QContact>::iterator iter;
-    for (iter = modifiedRemoteContacts.begin (); iter != modifiedRemoteContacts.end (); ++iter) {
-        QContact contact = *iter;
-        QString remoteId = UContactsBackend::getRemoteId(contact);
-
-        if (d->mModifiedContactIds.contains(remoteId)) {
-            if (d->mConflictResPolicy == Buteo::SyncProfile::CR_POLICY_PREFER_LOCAL_CHANGES) {
-                modifiedRemoteContacts.erase(iter);
-            } else {
-                d->mModifiedContactIds.remove(remoteId);
-            }
-        }
-
-        if (d->mDeletedContactIds.contains(remoteId)) {
-            if (d->mConflictResPolicy == Buteo::SyncProfile::CR_POLICY_PREFER_LOCAL_CHANGES) {
-                modifiedRemoteContacts.erase(iter);
-            } else {
-                d->mDeletedContactIds.remove(remoteId);
-            }
-        }
+    if (d->mModifiedContactIds.isEmpty() && d->mDeletedContactIds.isEmpty()) {
+        return;
     }
 
-    for (iter = deletedRemoteContacts.begin (); iter != deletedRemoteContacts.end (); ++iter) {
-        QContact contact = *iter;
+    // load the local version of contacts modified on both sides
+    QHash<QContactId, QString> conflictIds;
+    foreach (const QContact &contact, modifiedRemoteContacts) {
         QString remoteId = UContactsBackend::getRemoteId(contact);
-
-        if (d->mModifiedContactIds.contains(remoteId)) {
-            if (d->mConflictResPolicy == Buteo::SyncProfile::CR_POLICY_PREFER_LOCAL_CHANGES) {
-                deletedRemoteContacts.erase(iter);
-            } else {
-                d->mModifiedContactIds.remove(remoteId);
-            }
+        RemoteToLocalIdMap::const_iterator i = d->mModifiedContactIds.constFind(remoteId);
+        if (i != d->mModifiedContactIds.constEnd()) {
+            conflictIds.insert(i.value(), remoteId);
         }
+    }
 
-        if (d->mDeletedContactIds.contains(remoteId)) {
-            // If the entry is deleted both at the server and
-            // locally, then just remove it from the lists
-            // so that no further action need to be taken
-            deletedRemoteContacts.erase(iter);
-            d->mDeletedContactIds.remove(remoteId);
+    QHash<QString, QContact> localContacts;
+    if (!conflictIds.isEmpty()) {
+        QList<QContact> contacts = d->mContactBackend->getContacts(conflictIds.keys(),
+                                                                   d->mRemoteSource->uploadFetchHint());
+        localContacts.reserve(contacts.size());
+        foreach (const QContact &contact, contacts) {
+            localContacts.insert(conflictIds.value(contact.id()), contact);
         }
     }
+
+    int merged = d->mConflictResolver.resolve(&modifiedRemoteContacts,
+                                              &deletedRemoteContacts,
+                                              localContacts,
+                                              &d->mModifiedContactIds,
+                                              &d->mDeletedContactIds);
+    LOG_DEBUG("Contacts changed on both sides:" << conflictIds.size() << "merged:" << merged);
 }
 
 void
@@ -976,8 +1499,9 @@ UContactsClient::updateIdsToLocal(const QList<QContact> &contacts)
 {
     FUNCTION_CALL_TRACE;
     Q_D(UContactsClient);
-    QList<QContact> newList(contacts);
-    d->mContactBackend->modifyContacts(&newList);
+    // the contacts were not changed by the upload, only store the new remote ids and etags
+    d->mContactBackend->updateSyncFields(contacts);
+    d->mConflictResolver.setBase(contacts);
 }
 
 void
@@ -1047,4 +1571,5 @@ UContactsClient::generateResults(bool aSuccessful)
                      "RM:" << targetResults.remoteItems().modified);
         }
     }
+    LOG_INFO("Unchanged remote contacts skipped:" << d->mUnchangedRemoteContacts);
 }
@@ -132,13 +132,27 @@ private:
                                                                           const QSet<QTCONTACTS_PREPEND_NAMESPACE(QContactId)> &ids);
 
     /* slow sync */
+    void uploadLocalContactsForSlowSync();
     bool storeToLocalForSlowSync(const QList<QTCONTACTS_PREPEND_NAMESPACE(QContact)> &remoteContacts);
 
+    /* start-up */
+    bool prepareLocalSync();
+    void loadLocalSyncData();
+    bool startRemoteSync();
+    bool startRemoteFetch();
+    void logFirstResponse();
+    bool retryAuthentication(Sync::SyncStatus status);
+
+    /* manifest reconciliation */
+    bool startManifestReconciliation();
+    void reconcileWithManifest();
+
     /* fast sync */
     bool storeToLocalForFastSync(const QList<QTCONTACTS_PREPEND_NAMESPACE(QContact)> &remoteContacts);
 
 private slots:
     bool start();
+    void refreshAuthentication();
     void onAuthenticationError();
     void onAccountRemoved();
     void onStateChanged(int progress);
@@ -148,6 +162,7 @@ private slots:
 
 
     /* slow sync */
+    void storeNextPageForSlowSync();
     void onRemoteContactsFetchedForSlowSync(const QList<QtContacts::QContact> contacts,
                                             Sync::SyncStatus status,
                                             qreal progress);
@@ -156,7 +171,13 @@ private slots:
                                     const QStringList &removedContacts,
                                     const QMap<QString, int> errorList,
                                     Sync::SyncStatus status);
+    /* manifest reconciliation */
+    void onRemoteManifestFetched(const QList<QtContacts::QContact> contacts,
+                                 Sync::SyncStatus status,
+                                 qreal progress);
     /* fast sync */
+    void onRemoteChangesProbed(int count, Sync::SyncStatus status);
+    void onRemoteContactsUnchanged(const QStringList &ids);
     void onRemoteContactsFetchedForFastSync(const QList<QtContacts::QContact> contacts,
                                             Sync::SyncStatus status,
                                             qreal progress);
@@ -0,0 +1,486 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "UContactsConflictResolver.h"
+
+#include <LogMacros.h>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QStringList>
+
+#include <QContactDisplayLabel>
+#include <QContactExtendedDetail>
+#include <QContactGuid>
+#include <QContactSyncTarget>
+#include <QContactTimestamp>
+#include <QContactType>
+#include <QContactVersion>
+
+static const quint32 BASE_MAGIC   = 0x55434246; // "UCBF"
+// version 2 snapshots only hold the values written by the detail encoder
+static const quint32 BASE_VERSION = 2;
+// snapshots stored since the last save are appended to a journal,
+// a truncated last snapshot is ignored
+static const quint32 JOURNAL_MAGIC   = 0x5543424a; // "UCBJ"
+static const quint32 JOURNAL_VERSION = 2;
+
+static QString variantToString(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::String:
+        return value.toString();
+    case QVariant::StringList:
+        return value.toStringList().join(QChar(','));
+    case QVariant::ByteArray:
+        return QString::fromLatin1(value.toByteArray().toBase64());
+    case QVariant::DateTime:
+        return value.toDateTime().toUTC().toString(Qt::ISODate);
+    default:
+        break;
+    }
+
+    // contexts and sub types are stored as list of ints
+    if (value.canConvert<QVariantList>()) {
+        QStringList items;
+        foreach (const QVariant &item, value.value<QVariantList>()) {
+            items << variantToString(item);
+        }
+        return items.join(QChar(','));
+    }
+
+    return value.toString();
+}
+
+static QString detailToString(const QContactDetail &detail)
+{
+    QStringList values;
+    QMap<int, QVariant> fields = detail.values();
+    QMap<int, QVariant>::const_iterator i = fields.constBegin();
+    for (; i != fields.constEnd(); ++i) {
+        if (i.value().isNull()) {
+            continue;
+        }
+        values << QString("%1=%2").arg(i.key()).arg(variantToString(i.value()));
+    }
+    return values.join(QChar(0x1f));
+}
+
+UContactsConflictResolver::UContactsConflictResolver()
+    : mPreferLocal(false)
+    , mEncoder(0)
+{
+}
+
+void UContactsConflictResolver::setPreferLocalChanges(bool preferLocal)
+{
+    mPreferLocal = preferLocal;
+}
+
+bool UContactsConflictResolver::preferLocalChanges() const
+{
+    return mPreferLocal;
+}
+
+void UContactsConflictResolver::setMergeDetailTypes(const QList<QContactDetail::DetailType> &types)
+{
+    mMergeTypes = types;
+}
+
+void UContactsConflictResolver::setDetailEncoder(DetailEncoder encoder)
+{
+    mEncoder = encoder;
+}
+
+bool UContactsConflictResolver::isMerged(QContactDetail::DetailType type) const
+{
+    switch (type) {
+    // owned by the sync or by the contacts service, the remote version always wins
+    case QContactDetail::TypeGuid:
+    case QContactDetail::TypeTimestamp:
+    case QContactDetail::TypeExtendedDetail:
+    case QContactDetail::TypeSyncTarget:
+    case QContactDetail::TypeDisplayLabel:
+    case QContactDetail::TypeType:
+    case QContactDetail::TypeVersion:
+        return false;
+    default:
+        break;
+    }
+
+    return mMergeTypes.isEmpty() || mMergeTypes.contains(type);
+}
+
+UContactsConflictResolver::Snapshot
+UContactsConflictResolver::snapshot(const QContact &contact) const
+{
+    QMap<int, QStringList> details;
+    foreach (const QContactDetail &detail, contact.details()) {
+        if (!isMerged(detail.type())) {
+            continue;
+        }
+        // values the remote side does not store can be normalized by the
+        // contacts service and must not count as local changes
+        QString value = mEncoder ? mEncoder(detail) : detailToString(detail);
+        if (!value.isEmpty()) {
+            details[detail.type()] << value;
+        }
+    }
+
+    Snapshot result;
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QMap<int, QStringList>::iterator i = details.begin();
+    for (; i != details.end(); ++i) {
+        // the detail order is not relevant
+        i.value().sort();
+        QString value = i.value().join(QChar(0x1e));
+        result.fields.insert(i.key(), value);
+
+        hash.addData(QByteArray::number(i.key()));
+        hash.addData("\0", 1);
+        hash.addData(value.toUtf8());
+        hash.addData("\0", 1);
+    }
+    result.hash = hash.result();
+    return result;
+}
+
+void UContactsConflictResolver::setBase(const QList<QContact> &contacts)
+{
+    foreach (const QContact &contact, contacts) {
+        QString remoteId = UContactsBackend::getRemoteId(contact);
+        if (!remoteId.isEmpty()) {
+            mBase.insert(remoteId, snapshot(contact));
+        }
+    }
+}
+
+void UContactsConflictResolver::removeBase(const QStringList &remoteIds)
+{
+    foreach (const QString &remoteId, remoteIds) {
+        mBase.remove(remoteId);
+    }
+}
+
+bool UContactsConflictResolver::hasBase(const QString &remoteId) const
+{
+    return mBase.contains(remoteId);
+}
+
+bool UContactsConflictResolver::matchesBase(const QContact &contact) const
+{
+    QHash<QString, Snapshot>::const_iterator base = mBase.constFind(UContactsBackend::getRemoteId(contact));
+    if (base == mBase.constEnd()) {
+        return false;
+    }
+    return (base.value().hash == snapshot(contact).hash);
+}
+
+int UContactsConflictResolver::baseSize() const
+{
+    return mBase.size();
+}
+
+void UContactsConflictResolver::clear()
+{
+    mBase.clear();
+}
+
+bool UContactsConflictResolver::merge(const QContact &local,
+                                      const Snapshot &localSnapshot,
+                                      const Snapshot &remoteSnapshot,
+                                      const Snapshot *base,
+                                      QContact *remote) const
+{
+    QSet<int> types = localSnapshot.fields.keys().toSet();
+    types.unite(remoteSnapshot.fields.keys().toSet());
+    if (base) {
+        types.unite(base->fields.keys().toSet());
+    }
+
+    bool localChanges = false;
+    foreach (int type, types) {
+        const QString localValue = localSnapshot.fields.value(type);
+        const QString remoteValue = remoteSnapshot.fields.value(type);
+        if (localValue == remoteValue) {
+            continue;
+        }
+
+        bool takeLocal;
+        if (base && (localValue == base->fields.value(type))) {
+            // only changed on the remote side
+            takeLocal = false;
+        } else if (base && (remoteValue == base->fields.value(type))) {
+            // only changed on the local side
+            takeLocal = true;
+        } else {
+            // changed on both sides or never synced before
+            takeLocal = mPreferLocal;
+        }
+
+        if (!takeLocal) {
+            continue;
+        }
+
+        QContactDetail::DetailType detailType = static_cast<QContactDetail::DetailType>(type);
+        foreach (QContactDetail detail, remote->details(detailType)) {
+            remote->removeDetail(&detail);
+        }
+        foreach (QContactDetail detail, local.details(detailType)) {
+            remote->saveDetail(&detail);
+        }
+        localChanges = true;
+    }
+
+    return localChanges;
+}
+
+int UContactsConflictResolver::resolve(QList<QContact> *modifiedRemoteContacts,
+                                       QList<QContact> *deletedRemoteContacts,
+                                       const QHash<QString, QContact> &localContacts,
+                                       RemoteToLocalIdMap *modifiedLocalIds,
+                                       RemoteToLocalIdMap *deletedLocalIds) const
+{
+    int merged = 0;
+
+    QList<QContact> modified;
+    modified.reserve(modifiedRemoteContacts->size());
+    foreach (const QContact &contact, *modifiedRemoteContacts) {
+        QString remoteId = UContactsBackend::getRemoteId(contact);
+
+        if (deletedLocalIds->contains(remoteId)) {
+            if (mPreferLocal) {
+                // the contact will be removed from the remote side
+                continue;
+            }
+            deletedLocalIds->remove(remoteId);
+            modified << contact;
+            continue;
+        }
+
+        if (!modifiedLocalIds->contains(remoteId)) {
+            modified << contact;
+            continue;
+        }
+
+        QHash<QString, QContact>::const_iterator local = localContacts.constFind(remoteId);
+        if (local == localContacts.constEnd()) {
+            LOG_WARNING("Local version of the conflicting contact not found:" << remoteId);
+            if (!mPreferLocal) {
+                modifiedLocalIds->remove(remoteId);
+                modified << contact;
+            }
+            continue;
+        }
+
+        Snapshot localSnapshot = snapshot(local.value());
+        Snapshot remoteSnapshot = snapshot(contact);
+        if (localSnapshot.hash == remoteSnapshot.hash) {
+            // both sides did the same change
+            modifiedLocalIds->remove(remoteId);
+            modified << contact;
+            continue;
+        }
+
+        QHash<QString, Snapshot>::const_iterator base = mBase.constFind(remoteId);
+        QContact mergedContact(contact);
+        bool upload = merge(local.value(),
+                            localSnapshot,
+                            remoteSnapshot,
+                            base != mBase.constEnd() ? &base.value() : 0,
+                            &mergedContact);
+        if (!upload) {
+            modifiedLocalIds->remove(remoteId);
+        }
+        modified << mergedContact;
+        merged++;
+    }
+    *modifiedRemoteContacts = modified;
+
+    QList<QContact> deleted;
+    deleted.reserve(deletedRemoteContacts->size());
+    foreach (const QContact &contact, *deletedRemoteContacts) {
+        QString remoteId = UContactsBackend::getRemoteId(contact);
+
+        if (deletedLocalIds->contains(remoteId)) {
+            // deleted on both sides, nothing else to do
+            deletedLocalIds->remove(remoteId);
+            continue;
+        }
+
+        if (modifiedLocalIds->contains(remoteId)) {
+            if (mPreferLocal) {
+                continue;
+            }
+            modifiedLocalIds->remove(remoteId);
+        }
+        deleted << contact;
+    }
+    *deletedRemoteContacts = deleted;
+
+    return merged;
+}
+
+bool UContactsConflictResolver::load(const QString &fileName)
+{
+    clear();
+
+    bool loaded = loadBase(fileName);
+    int journalEntries = loadJournal(fileName);
+    if (journalEntries > 0) {
+        LOG_DEBUG("Conflict base journal loaded with" << journalEntries << "entries");
+    }
+    return loaded || (journalEntries > 0);
+}
+
+bool UContactsConflictResolver::loadBase(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        LOG_DEBUG("Conflict base not found:" << fileName);
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if ((magic != BASE_MAGIC) || (version != BASE_VERSION)) {
+        LOG_WARNING("Invalid conflict base:" << fileName);
+        return false;
+    }
+
+    mBase.reserve(count);
+    for (quint32 i = 0; (i < count) && (stream.status() == QDataStream::Ok); i++) {
+        QString remoteId;
+        Snapshot snapshot;
+        stream >> remoteId >> snapshot.hash >> snapshot.fields;
+        mBase.insert(remoteId, snapshot);
+    }
+
+    if ((stream.status() != QDataStream::Ok) || ((quint32) mBase.size() != count)) {
+        LOG_WARNING("Conflict base is truncated:" << fileName);
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool UContactsConflictResolver::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_WARNING("Fail to save conflict base:" << file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << BASE_MAGIC << BASE_VERSION << (quint32) mBase.size();
+
+    QHash<QString, Snapshot>::const_iterator i = mBase.constBegin();
+    for (; i != mBase.constEnd(); ++i) {
+        stream << i.key() << i.value().hash << i.value().fields;
+    }
+
+    if (!file.commit()) {
+        LOG_WARNING("Fail to save conflict base:" << file.errorString());
+        return false;
+    }
+
+    // the snapshots of the journal are part of the saved base now
+    QFile::remove(journalFileName(fileName));
+    return true;
+}
+
+int UContactsConflictResolver::loadJournal(const QString &fileName)
+{
+    QFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if ((magic != JOURNAL_MAGIC) || (version != JOURNAL_VERSION)) {
+        LOG_WARNING("Invalid conflict base journal:" << file.fileName());
+        return 0;
+    }
+
+    int count = 0;
+    while (!stream.atEnd()) {
+        QString remoteId;
+        Snapshot snapshot;
+        stream >> remoteId >> snapshot.hash >> snapshot.fields;
+        // the process can be killed while appending a snapshot
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        mBase.insert(remoteId, snapshot);
+        count++;
+    }
+    return count;
+}
+
+bool UContactsConflictResolver::appendJournal(const QString &fileName, const QStringList &remoteIds) const
+{
+    QFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        LOG_WARNING("Fail to append to conflict base journal:" << file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    if (file.size() == 0) {
+        stream << JOURNAL_MAGIC << JOURNAL_VERSION;
+    }
+
+    foreach (const QString &remoteId, remoteIds) {
+        QHash<QString, Snapshot>::const_iterator base = mBase.constFind(remoteId);
+        if (base != mBase.constEnd()) {
+            stream << remoteId << base.value().hash << base.value().fields;
+        }
+    }
+
+    if ((stream.status() != QDataStream::Ok) || !file.flush()) {
+        LOG_WARNING("Fail to append to conflict base journal:" << file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QString UContactsConflictResolver::journalFileName(const QString &fileName)
+{
+    return fileName + QStringLiteral(".journal");
+}
@@ -0,0 +1,158 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef UCONTACTSCONFLICTRESOLVER_H
+#define UCONTACTSCONFLICTRESOLVER_H
+
+#include "UContactsBackend.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include <QContact>
+#include <QContactDetail>
+
+QTCONTACTS_USE_NAMESPACE
+
+//! \brief Resolves conflicts between local and remote changes of the same contacts
+///
+/// The resolver keeps a snapshot of each contact as it was when both sides
+/// last agreed on it (the base). A contact changed on both sides is merged
+/// three-way by detail type: a detail type changed on a single side is taken
+/// from that side, the conflict policy is only used when both sides changed
+/// the same detail type or when the base is not known.
+class UContactsConflictResolver
+{
+public:
+    struct Snapshot
+    {
+        QByteArray hash;
+        QMap<int, QString> fields;  ///< serialized details by detail type
+    };
+
+    /*!
+     * \brief Serialize a detail as the remote side stores it
+     * Details serialized to an empty string are not stored on the remote side.
+     */
+    typedef QString (*DetailEncoder)(const QContactDetail &detail);
+
+    UContactsConflictResolver();
+
+    /*!
+     * \brief Prefer the local version when both sides changed the same details
+     */
+    void setPreferLocalChanges(bool preferLocal);
+    bool preferLocalChanges() const;
+
+    /*!
+     * \brief Restrict the merge to the detail types stored on the remote side
+     * An empty list merges every detail type not owned by the sync.
+     */
+    void setMergeDetailTypes(const QList<QContactDetail::DetailType> &types);
+
+    /*!
+     * \brief Restrict the snapshots to the detail values stored on the remote side
+     * Without encoder every value of the merged details is used. The base
+     * must be loaded or set after the encoder changes.
+     */
+    void setDetailEncoder(DetailEncoder encoder);
+
+    /*!
+     * \brief Store the base snapshot of contacts known to be equal on both sides
+     * The contacts must have a remote id.
+     */
+    void setBase(const QList<QContact> &contacts);
+    void removeBase(const QStringList &remoteIds);
+    bool hasBase(const QString &remoteId) const;
+
+    /*!
+     * \brief Check if the contact has the same content as its base
+     * Contacts without base never match.
+     */
+    bool matchesBase(const QContact &contact) const;
+    int baseSize() const;
+    void clear();
+
+    /*!
+     * \brief Create the snapshot of a contact, only the merged detail types are used
+     */
+    Snapshot snapshot(const QContact &contact) const;
+
+    /*!
+     * \brief Resolve the conflicts between remote and local changes
+     * \param modifiedRemoteContacts Remote changes, conflicting contacts are replaced
+     * by the merged version or removed if the local version wins
+     * \param deletedRemoteContacts Remote deletions, removed if the local version wins
+     * \param localContacts The current local version of the locally modified contacts, by remote id
+     * \param modifiedLocalIds Local changes, contacts without local changes left after
+     * the merge are removed and do not need to be uploaded
+     * \param deletedLocalIds Local deletions, removed if the remote version wins
+     * \return Returns the number of contacts merged
+     */
+    int resolve(QList<QContact> *modifiedRemoteContacts,
+                QList<QContact> *deletedRemoteContacts,
+                const QHash<QString, QContact> &localContacts,
+                RemoteToLocalIdMap *modifiedLocalIds,
+                RemoteToLocalIdMap *deletedLocalIds) const;
+
+    /*!
+     * \brief Load the base snapshots from a file created by save()
+     * The snapshots appended to the journal after the save are loaded too.
+     * \return Returns false and leaves the base empty if the file and its journal are missing or invalid
+     */
+    bool load(const QString &fileName);
+
+    /*!
+     * \brief Store the base snapshots in a file, the journal of the file is removed
+     */
+    bool save(const QString &fileName) const;
+
+    /*!
+     * \brief Append the base snapshots of some remote ids to the journal of a base file
+     */
+    bool appendJournal(const QString &fileName, const QStringList &remoteIds) const;
+
+    /*!
+     * \brief Return the journal file name of a base file
+     */
+    static QString journalFileName(const QString &fileName);
+
+private:
+    bool mPreferLocal;
+    QList<QContactDetail::DetailType> mMergeTypes;
+    DetailEncoder mEncoder;
+    QHash<QString, Snapshot> mBase;
+
+    bool loadBase(const QString &fileName);
+    int loadJournal(const QString &fileName);
+
+    bool isMerged(QContactDetail::DetailType type) const;
+    bool merge(const QContact &local,
+               const Snapshot &localSnapshot,
+               const Snapshot &remoteSnapshot,
+               const Snapshot *base,
+               QContact *remote) const;
+};
+
+#endif // UCONTACTSCONFLICTRESOLVER_H
@@ -0,0 +1,219 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "UContactsSyncWrites.h"
+
+#include <LogMacros.h>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+
+static const quint32 WRITES_MAGIC   = 0x55435357; // "UCSW"
+static const quint32 WRITES_VERSION = 2;
+// record types appended after the header
+static const quint8 RECORD_WRITES   = 1;
+static const quint8 RECORD_FINISHED = 2;
+static const quint8 RECORD_STORED   = 3;
+// maximum time between the bounds of a sync write and the change signal caused by it
+static const int SYNC_WRITE_TOLERANCE_SECS = 5;
+
+UContactsSyncWrites::UContactsSyncWrites()
+{
+}
+
+UContactsSyncWrites::~UContactsSyncWrites()
+{
+    close();
+}
+
+void UContactsSyncWrites::open(const QString &fileName)
+{
+    close();
+
+    mFileName = fileName;
+    if (mFileName.isEmpty()) {
+        return;
+    }
+
+    // the header replaces the file atomically, readers never see a mix of windows
+    QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    QSaveFile file(mFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_WARNING("Fail to save sync writes:" << file.errorString());
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << WRITES_MAGIC
+           << WRITES_VERSION
+           << QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
+
+    if (!file.commit()) {
+        LOG_WARNING("Fail to save sync writes:" << file.errorString());
+    }
+}
+
+void UContactsSyncWrites::registerIds(const QList<QContactId> &ids)
+{
+    appendIds(RECORD_WRITES, ids);
+}
+
+void UContactsSyncWrites::storedIds(const QList<QContactId> &ids)
+{
+    // a large save can take longer than the tolerance, the change signals
+    // are matched with the whole write
+    appendIds(RECORD_STORED, ids);
+}
+
+void UContactsSyncWrites::close()
+{
+    if (mFileName.isEmpty()) {
+        return;
+    }
+
+    append(RECORD_FINISHED, QDateTime::currentDateTimeUtc(), QStringList());
+    mFileName.clear();
+}
+
+bool UContactsSyncWrites::isOpen() const
+{
+    return !mFileName.isEmpty();
+}
+
+QString UContactsSyncWrites::directory()
+{
+    return QString("%1/buteo-sync-plugins-contacts")
+            .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation));
+}
+
+bool UContactsSyncWrites::read(const QString &fileName, Window *window)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 started = 0;
+    stream >> magic >> version >> started;
+    if ((stream.status() != QDataStream::Ok) ||
+        (magic != WRITES_MAGIC) || (version != WRITES_VERSION)) {
+        LOG_WARNING("Invalid sync writes file:" << fileName);
+        return false;
+    }
+
+    *window = Window();
+    window->started = QDateTime::fromMSecsSinceEpoch(started).toUTC();
+    while (!stream.atEnd()) {
+        quint8 type = 0;
+        qint64 time = 0;
+        QStringList ids;
+        stream >> type >> time >> ids;
+        // the writer may be appending the last record
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+
+        QDateTime recordTime = QDateTime::fromMSecsSinceEpoch(time).toUTC();
+        if (type == RECORD_FINISHED) {
+            window->finished = recordTime;
+        } else if (type == RECORD_WRITES) {
+            foreach (const QString &id, ids) {
+                window->ids.insert(id, recordTime);
+                window->stored.remove(id);
+            }
+        } else if (type == RECORD_STORED) {
+            foreach (const QString &id, ids) {
+                if (!window->ids.contains(id)) {
+                    window->ids.insert(id, recordTime);
+                }
+                window->stored.insert(id, recordTime);
+            }
+        }
+    }
+    return true;
+}
+
+bool UContactsSyncWrites::isSyncWrite(const Window &window, const QString &id, const QDateTime &changedAt)
+{
+    QHash<QString, QDateTime>::const_iterator writtenAt = window.ids.constFind(id);
+    if (writtenAt == window.ids.constEnd()) {
+        return false;
+    }
+
+    if (writtenAt.value().secsTo(changedAt) < -SYNC_WRITE_TOLERANCE_SECS) {
+        return false;
+    }
+
+    // a write not stored yet is still running, unless the sync finished
+    QDateTime storedAt = window.stored.value(id);
+    if (!storedAt.isValid()) {
+        storedAt = window.finished;
+    }
+    return !storedAt.isValid() ||
+           (storedAt.secsTo(changedAt) <= SYNC_WRITE_TOLERANCE_SECS);
+}
+
+void UContactsSyncWrites::appendIds(quint8 type, const QList<QContactId> &ids) const
+{
+    if (mFileName.isEmpty() || ids.isEmpty()) {
+        return;
+    }
+
+    QStringList newIds;
+    foreach (const QContactId &id, ids) {
+        if (!id.isNull()) {
+            newIds << id.toString();
+        }
+    }
+
+    if (!newIds.isEmpty()) {
+        append(type, QDateTime::currentDateTimeUtc(), newIds);
+    }
+}
+
+bool UContactsSyncWrites::append(quint8 type, const QDateTime &time, const QStringList &ids) const
+{
+    QFile file(mFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        LOG_WARNING("Fail to save sync writes:" << file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << type << time.toMSecsSinceEpoch() << ids;
+    if (stream.status() != QDataStream::Ok) {
+        LOG_WARNING("Fail to save sync writes:" << file.errorString());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef UCONTACTSSYNCWRITES_H
+#define UCONTACTSSYNCWRITES_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <QContactId>
+
+QTCONTACTS_USE_NAMESPACE
+
+//! \brief Registry of the contacts written by a sync
+///
+/// The sync plugin runs out of process, the registry is stored in a file
+/// shared with the storage change notifier. The notifier uses it to ignore
+/// the change signals caused by the sync's own writes.
+///
+/// The file is append only: a header written when the window opens, then one
+/// record per registered batch, one per stored batch and a last record when
+/// the window closes. A truncated last record is ignored by readers.
+class UContactsSyncWrites
+{
+public:
+    struct Window
+    {
+        QDateTime started;
+        QDateTime finished;             ///< invalid while the sync is running
+        QHash<QString, QDateTime> ids;      ///< last time each id was registered for a write
+        QHash<QString, QDateTime> stored;   ///< time the last write of each id was stored
+    };
+
+    UContactsSyncWrites();
+    ~UContactsSyncWrites();
+
+    /*!
+     * \brief Start a new sync window, ids of previous windows are dropped
+     */
+    void open(const QString &fileName);
+
+    /*!
+     * \brief Register the local ids of contacts written by the sync
+     * Ids must be registered before the write when they are known.
+     */
+    void registerIds(const QList<QContactId> &ids);
+
+    /*!
+     * \brief Register the local ids of contacts once their write is stored
+     * Ids of new contacts are only known at this point.
+     */
+    void storedIds(const QList<QContactId> &ids);
+
+    /*!
+     * \brief Mark the end of the sync window
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /*!
+     * \brief Directory with the registry files of all accounts
+     */
+    static QString directory();
+
+    /*!
+     * \brief Read a registry file
+     * \return Returns false if the file is missing or invalid
+     */
+    static bool read(const QString &fileName, Window *window);
+
+    /*!
+     * \brief Check if a change notified at a given time was caused by the sync
+     * The change must happen between the registration of the write and the
+     * time it was stored, or while the write runs. Later changes were done by
+     * someone else.
+     */
+    static bool isSyncWrite(const Window &window, const QString &id, const QDateTime &changedAt);
+
+private:
+    QString mFileName;
+
+    void appendIds(quint8 type, const QList<QContactId> &ids) const;
+    bool append(quint8 type, const QDateTime &time, const QStringList &ids) const;
+};
+
+#endif // UCONTACTSSYNCWRITES_H
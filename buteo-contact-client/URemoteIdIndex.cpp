@@ -0,0 +1,373 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "URemoteIdIndex.h"
+
+#include <LogMacros.h>
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+// On disk format: a header followed by one record per entry and a blob with
+// all UTF-8 strings, records point to the strings with offset and length.
+static const quint32 INDEX_MAGIC   = 0x55524944; // "URID"
+static const quint32 INDEX_VERSION = 1;
+
+// The journal is a header with the sync target followed by appended entries,
+// a truncated last entry is ignored.
+static const quint32 JOURNAL_MAGIC   = 0x55524a4c; // "URJL"
+static const quint32 JOURNAL_VERSION = 1;
+
+struct IndexHeader
+{
+    quint32 magic;
+    quint32 version;
+    qint64  timestamp;
+    quint32 count;
+    quint32 syncTargetOffset;
+    quint32 syncTargetLength;
+    quint32 blobSize;
+};
+
+struct IndexRecord
+{
+    quint32 remoteIdOffset;
+    quint32 remoteIdLength;
+    quint32 localIdOffset;
+    quint32 localIdLength;
+    quint32 etagOffset;
+    quint32 etagLength;
+};
+
+static void appendString(QByteArray &blob, const QString &value, quint32 *offset, quint32 *length)
+{
+    QByteArray data = value.toUtf8();
+    *offset = blob.size();
+    *length = data.size();
+    blob.append(data);
+}
+
+static QString readString(const char *blob, quint32 blobSize, quint32 offset, quint32 length, bool *ok)
+{
+    if ((offset > blobSize) || (length > (blobSize - offset))) {
+        *ok = false;
+        return QString();
+    }
+    return QString::fromUtf8(blob + offset, length);
+}
+
+URemoteIdIndex::URemoteIdIndex()
+{
+}
+
+void URemoteIdIndex::insert(const QString &remoteId,
+                            const QContactId &localId,
+                            const QString &etag)
+{
+    if (localId.isNull()) {
+        return;
+    }
+
+    // drop old mappings of both keys to keep the two hashes consistent
+    removeLocalId(localId);
+    if (remoteId.isEmpty()) {
+        return;
+    }
+    removeRemoteId(remoteId);
+
+    Entry entry;
+    entry.localId = localId;
+    entry.etag = etag;
+    mRemoteToLocal.insert(remoteId, entry);
+    mLocalToRemote.insert(localId, remoteId);
+}
+
+void URemoteIdIndex::removeRemoteId(const QString &remoteId)
+{
+    QHash<QString, Entry>::iterator i = mRemoteToLocal.find(remoteId);
+    if (i != mRemoteToLocal.end()) {
+        mLocalToRemote.remove(i.value().localId);
+        mRemoteToLocal.erase(i);
+    }
+}
+
+void URemoteIdIndex::removeLocalId(const QContactId &localId)
+{
+    QHash<QContactId, QString>::iterator i = mLocalToRemote.find(localId);
+    if (i != mLocalToRemote.end()) {
+        mRemoteToLocal.remove(i.value());
+        mLocalToRemote.erase(i);
+    }
+}
+
+QContactId URemoteIdIndex::localId(const QString &remoteId) const
+{
+    return mRemoteToLocal.value(remoteId).localId;
+}
+
+QString URemoteIdIndex::remoteId(const QContactId &localId) const
+{
+    return mLocalToRemote.value(localId);
+}
+
+QString URemoteIdIndex::etag(const QString &remoteId) const
+{
+    return mRemoteToLocal.value(remoteId).etag;
+}
+
+QHash<QString, QString> URemoteIdIndex::etags() const
+{
+    QHash<QString, QString> result;
+    result.reserve(mRemoteToLocal.size());
+    QHash<QString, Entry>::const_iterator i = mRemoteToLocal.constBegin();
+    for (; i != mRemoteToLocal.constEnd(); ++i) {
+        if (!i.value().etag.isEmpty()) {
+            result.insert(i.key(), i.value().etag);
+        }
+    }
+    return result;
+}
+
+bool URemoteIdIndex::containsRemoteId(const QString &remoteId) const
+{
+    return mRemoteToLocal.contains(remoteId);
+}
+
+bool URemoteIdIndex::containsLocalId(const QContactId &localId) const
+{
+    return mLocalToRemote.contains(localId);
+}
+
+QList<QString> URemoteIdIndex::remoteIds() const
+{
+    return mRemoteToLocal.keys();
+}
+
+int URemoteIdIndex::size() const
+{
+    return mRemoteToLocal.size();
+}
+
+bool URemoteIdIndex::isEmpty() const
+{
+    return mRemoteToLocal.isEmpty();
+}
+
+void URemoteIdIndex::reserve(int size)
+{
+    mRemoteToLocal.reserve(size);
+    mLocalToRemote.reserve(size);
+}
+
+void URemoteIdIndex::clear()
+{
+    mRemoteToLocal.clear();
+    mLocalToRemote.clear();
+}
+
+bool URemoteIdIndex::load(const QString &fileName, const QString &syncTarget, QDateTime *timestamp)
+{
+    clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        LOG_DEBUG("Remote id index not found:" << fileName);
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize < (qint64) sizeof(IndexHeader)) {
+        LOG_WARNING("Remote id index is truncated:" << fileName);
+        return false;
+    }
+
+    uchar *data = file.map(0, fileSize);
+    if (!data) {
+        LOG_WARNING("Fail to map remote id index:" << file.errorString());
+        return false;
+    }
+
+    IndexHeader header;
+    memcpy(&header, data, sizeof(IndexHeader));
+
+    const qint64 recordsSize = (qint64) header.count * sizeof(IndexRecord);
+    bool ok = (header.magic == INDEX_MAGIC) &&
+              (header.version == INDEX_VERSION) &&
+              (fileSize == (qint64) sizeof(IndexHeader) + recordsSize + header.blobSize);
+
+    if (ok) {
+        const IndexRecord *records = reinterpret_cast<const IndexRecord*>(data + sizeof(IndexHeader));
+        const char *blob = reinterpret_cast<const char*>(data + sizeof(IndexHeader) + recordsSize);
+
+        QString target = readString(blob, header.blobSize, header.syncTargetOffset, header.syncTargetLength, &ok);
+        if (ok && (target != syncTarget)) {
+            LOG_WARNING("Remote id index belongs to a different sync target:" << target);
+            ok = false;
+        }
+
+        if (ok) {
+            reserve(header.count);
+        }
+
+        for (quint32 i = 0; ok && (i < header.count); i++) {
+            IndexRecord record;
+            memcpy(&record, records + i, sizeof(IndexRecord));
+
+            QString remoteId = readString(blob, header.blobSize, record.remoteIdOffset, record.remoteIdLength, &ok);
+            QString localId = readString(blob, header.blobSize, record.localIdOffset, record.localIdLength, &ok);
+            QString etag = readString(blob, header.blobSize, record.etagOffset, record.etagLength, &ok);
+            if (ok) {
+                insert(remoteId, QContactId::fromString(localId), etag);
+            }
+        }
+    }
+
+    file.unmap(data);
+
+    if (!ok) {
+        LOG_WARNING("Invalid remote id index:" << fileName);
+        clear();
+        return false;
+    }
+
+    int journalEntries = loadJournal(fileName, syncTarget);
+    if (journalEntries > 0) {
+        LOG_DEBUG("Remote id index journal loaded with" << journalEntries << "entries");
+    }
+
+    if (timestamp) {
+        *timestamp = QDateTime::fromMSecsSinceEpoch(header.timestamp).toUTC();
+    }
+    return true;
+}
+
+int URemoteIdIndex::loadJournal(const QString &fileName, const QString &syncTarget)
+{
+    QFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString target;
+    stream >> magic >> version >> target;
+    if ((stream.status() != QDataStream::Ok) ||
+        (magic != JOURNAL_MAGIC) || (version != JOURNAL_VERSION) ||
+        (target != syncTarget)) {
+        LOG_WARNING("Invalid remote id index journal:" << file.fileName());
+        return 0;
+    }
+
+    int count = 0;
+    while (!stream.atEnd()) {
+        QString remoteId;
+        QString localId;
+        QString etag;
+        stream >> remoteId >> localId >> etag;
+        // the process can be killed while appending an entry
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        insert(remoteId, QContactId::fromString(localId), etag);
+        count++;
+    }
+    return count;
+}
+
+bool URemoteIdIndex::save(const QString &fileName, const QString &syncTarget, const QDateTime &timestamp) const
+{
+    QByteArray blob;
+    QByteArray records;
+    records.reserve(mRemoteToLocal.size() * sizeof(IndexRecord));
+
+    IndexHeader header;
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.timestamp = timestamp.toMSecsSinceEpoch();
+    header.count = mRemoteToLocal.size();
+    appendString(blob, syncTarget, &header.syncTargetOffset, &header.syncTargetLength);
+
+    QHash<QString, Entry>::const_iterator i = mRemoteToLocal.constBegin();
+    for (; i != mRemoteToLocal.constEnd(); ++i) {
+        IndexRecord record;
+        appendString(blob, i.key(), &record.remoteIdOffset, &record.remoteIdLength);
+        appendString(blob, i.value().localId.toString(), &record.localIdOffset, &record.localIdLength);
+        appendString(blob, i.value().etag, &record.etagOffset, &record.etagLength);
+        records.append(reinterpret_cast<const char*>(&record), sizeof(IndexRecord));
+    }
+    header.blobSize = blob.size();
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_WARNING("Fail to save remote id index:" << file.errorString());
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(IndexHeader));
+    file.write(records);
+    file.write(blob);
+    if (!file.commit()) {
+        LOG_WARNING("Fail to save remote id index:" << file.errorString());
+        return false;
+    }
+
+    // the entries of the journal are part of the saved index now
+    QFile::remove(journalFileName(fileName));
+    return true;
+}
+
+bool URemoteIdIndex::appendJournal(const QString &fileName, const QString &syncTarget, const QStringList &remoteIds) const
+{
+    QFile file(journalFileName(fileName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        LOG_WARNING("Fail to append to remote id index journal:" << file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    if (file.size() == 0) {
+        stream << JOURNAL_MAGIC << JOURNAL_VERSION << syncTarget;
+    }
+
+    foreach (const QString &remoteId, remoteIds) {
+        QHash<QString, Entry>::const_iterator entry = mRemoteToLocal.constFind(remoteId);
+        if (entry != mRemoteToLocal.constEnd()) {
+            stream << remoteId << entry.value().localId.toString() << entry.value().etag;
+        }
+    }
+
+    if ((stream.status() != QDataStream::Ok) || !file.flush()) {
+        LOG_WARNING("Fail to append to remote id index journal:" << file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QString URemoteIdIndex::journalFileName(const QString &fileName)
+{
+    return fileName + QStringLiteral(".journal");
+}
@@ -0,0 +1,140 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef UREMOTEIDINDEX_H
+#define UREMOTEIDINDEX_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <QContactId>
+
+QTCONTACTS_USE_NAMESPACE
+
+//! \brief Bidirectional index between remote ids and local contact ids
+///
+/// Both lookup directions are hashed, so resolving a remote id from a local id
+/// does not need to scan the whole cache. The index also keeps the last known
+/// etag of each remote contact and can be stored in a memory mappable file.
+/// Entries added between two saves can be appended to a journal next to the file.
+class URemoteIdIndex
+{
+public:
+    URemoteIdIndex();
+
+    /*!
+     * \brief Map a remote id to a local id
+     * Any previous mapping of the remote id or of the local id is replaced.
+     * An empty remote id removes the local id from the index.
+     */
+    void insert(const QString &remoteId,
+                const QContactId &localId,
+                const QString &etag = QString());
+
+    /*!
+     * \brief Remove the entry of a remote id
+     */
+    void removeRemoteId(const QString &remoteId);
+
+    /*!
+     * \brief Remove the entry of a local id
+     */
+    void removeLocalId(const QContactId &localId);
+
+    /*!
+     * \brief Return the local id of a remote id or a null id if not found
+     */
+    QContactId localId(const QString &remoteId) const;
+
+    /*!
+     * \brief Return the remote id of a local id or an empty string if not found
+     */
+    QString remoteId(const QContactId &localId) const;
+
+    /*!
+     * \brief Return the etag stored for a remote id
+     */
+    QString etag(const QString &remoteId) const;
+
+    /*!
+     * \brief Return the etag of every remote id that has one
+     */
+    QHash<QString, QString> etags() const;
+
+    bool containsRemoteId(const QString &remoteId) const;
+    bool containsLocalId(const QContactId &localId) const;
+
+    QList<QString> remoteIds() const;
+    int size() const;
+    bool isEmpty() const;
+    void reserve(int size);
+    void clear();
+
+    /*!
+     * \brief Load the index from a file created by save()
+     * The entries appended to the journal after the save are loaded too.
+     * \param fileName The index file
+     * \param syncTarget The sync target that the file must belong to
+     * \param timestamp Returns the time when the index was known to be valid
+     * \return Returns false and leaves the index empty if the file is missing or invalid
+     */
+    bool load(const QString &fileName, const QString &syncTarget, QDateTime *timestamp);
+
+    /*!
+     * \brief Store the index in a file, the journal of the file is removed
+     * \param fileName The index file
+     * \param syncTarget The sync target of the indexed contacts
+     * \param timestamp The time when the index was known to be valid
+     * \return Returns true if the file was written with success
+     */
+    bool save(const QString &fileName, const QString &syncTarget, const QDateTime &timestamp) const;
+
+    /*!
+     * \brief Append the current entries of some remote ids to the journal of an index file
+     * \param fileName The index file
+     * \param syncTarget The sync target of the indexed contacts
+     * \param remoteIds The remote ids added or changed since the last save
+     * \return Returns true if the entries were written with success
+     */
+    bool appendJournal(const QString &fileName, const QString &syncTarget, const QStringList &remoteIds) const;
+
+    /*!
+     * \brief Return the journal file name of an index file
+     */
+    static QString journalFileName(const QString &fileName);
+
+private:
+    struct Entry
+    {
+        QContactId localId;
+        QString etag;
+    };
+
+    QHash<QString, Entry> mRemoteToLocal;
+    QHash<QContactId, QString> mLocalToRemote;
+
+    int loadJournal(const QString &fileName, const QString &syncTarget);
+};
+
+#endif // UREMOTEIDINDEX_H
@@ -0,0 +1,89 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "GBatchQueue.h"
+
+GBatchQueue::GBatchQueue()
+{
+}
+
+QQueue<GBatchQueue::Operation> &GBatchQueue::queue(GoogleContactStream::UpdateType type)
+{
+    switch (type) {
+    case GoogleContactStream::Add:
+        return mAdd;
+    case GoogleContactStream::Modify:
+        return mModify;
+    case GoogleContactStream::Remove:
+    default:
+        return mRemove;
+    }
+}
+
+void GBatchQueue::enqueue(GoogleContactStream::UpdateType type, const QContact &contact)
+{
+    queue(type).enqueue(qMakePair(contact, QStringList()));
+}
+
+GBatchQueue::Page GBatchQueue::takePage(int limit)
+{
+    static const GoogleContactStream::UpdateType types[] = { GoogleContactStream::Add,
+                                                             GoogleContactStream::Modify,
+                                                             GoogleContactStream::Remove };
+    Page page;
+    for (int t = 0; t < 3; t++) {
+        QQueue<Operation> &q = queue(types[t]);
+        while (!q.isEmpty() && (page.size() < limit)) {
+            // QContact is implicitly shared, dequeue does not copy the contact data
+            page.insertMulti(types[t], q.dequeue());
+        }
+    }
+    return page;
+}
+
+void GBatchQueue::putBack(const Page &page)
+{
+    // values() returns the most recent inserted first, prepending them
+    // restores the original order
+    foreach (GoogleContactStream::UpdateType type, page.uniqueKeys()) {
+        QQueue<Operation> &q = queue(type);
+        foreach (const Operation &op, page.values(type)) {
+            q.prepend(op);
+        }
+    }
+}
+
+int GBatchQueue::size() const
+{
+    return mAdd.size() + mModify.size() + mRemove.size();
+}
+
+bool GBatchQueue::isEmpty() const
+{
+    return mAdd.isEmpty() && mModify.isEmpty() && mRemove.isEmpty();
+}
+
+void GBatchQueue::clear()
+{
+    mAdd.clear();
+    mModify.clear();
+    mRemove.clear();
+}
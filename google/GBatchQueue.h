@@ -0,0 +1,72 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef GBATCHQUEUE_H
+#define GBATCHQUEUE_H
+
+#include "GContactStream.h"
+
+#include <QContact>
+#include <QMultiMap>
+#include <QPair>
+#include <QQueue>
+#include <QStringList>
+
+QTCONTACTS_USE_NAMESPACE
+
+//! \brief Pending batch operations
+///
+/// Operations are kept on one FIFO queue per operation type. Pages are handed
+/// out with adds first, then modifications and removals, and taking a page
+/// costs O(page size).
+class GBatchQueue
+{
+public:
+    typedef QPair<QContact, QStringList> Operation;
+    typedef QMultiMap<GoogleContactStream::UpdateType, Operation> Page;
+
+    GBatchQueue();
+
+    void enqueue(GoogleContactStream::UpdateType type, const QContact &contact);
+
+    /*!
+     * \brief Remove up to "limit" operations from the queue
+     */
+    Page takePage(int limit);
+
+    /*!
+     * \brief Return a page taken by takePage() to the front of the queue
+     */
+    void putBack(const Page &page);
+
+    int size() const;
+    bool isEmpty() const;
+    void clear();
+
+private:
+    QQueue<Operation> mAdd;
+    QQueue<Operation> mModify;
+    QQueue<Operation> mRemove;
+
+    QQueue<Operation> &queue(GoogleContactStream::UpdateType type);
+};
+
+#endif // GBATCHQUEUE_H
@@ -0,0 +1,75 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "GBatchSizer.h"
+#include "GTransport.h"
+
+#include <LogMacros.h>
+
+GBatchSizer::GBatchSizer(int pageSize, int minPageSize, int maxPageSize,
+                         int maxPageBytes, int fastReplyMsecs)
+    : mPageSize(pageSize),
+      mMinPageSize(minPageSize),
+      mMaxPageSize(maxPageSize),
+      mMaxPageBytes(maxPageBytes),
+      mMinPageBytes(maxPageBytes / 8),
+      mFastReplyMsecs(fastReplyMsecs)
+{
+}
+
+int GBatchSizer::pageSize() const
+{
+    return mPageSize;
+}
+
+int GBatchSizer::maxPageBytes() const
+{
+    return mMaxPageBytes;
+}
+
+void GBatchSizer::success(int entries, qint64 msecs)
+{
+    // only grow if the page was full, smaller pages does not tell us anything
+    if ((msecs < mFastReplyMsecs) && (entries >= mPageSize) && (mPageSize < mMaxPageSize)) {
+        mPageSize = qMin(mMaxPageSize, mPageSize + qMax(1, mPageSize / 2));
+        LOG_INFO("Batch page size increased to" << mPageSize << "entries");
+    }
+}
+
+bool GBatchSizer::failure(int errorCode)
+{
+    switch (errorCode) {
+    case GTransport::HTTP_REQUEST_ENTITY_TOO_LARGE:
+        mMaxPageBytes = qMax(mMinPageBytes, mMaxPageBytes / 2);
+        // fall through
+    case GTransport::HTTP_REQUEST_TIMEOUT:
+    case 500:
+    case 502:
+    case 503:
+    case 504:
+        mPageSize = qMax(mMinPageSize, mPageSize / 2);
+        LOG_INFO("Batch page size decreased to" << mPageSize << "entries and"
+                 << mMaxPageBytes << "bytes after error" << errorCode);
+        return true;
+    default:
+        return false;
+    }
+}
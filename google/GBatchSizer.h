@@ -0,0 +1,64 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef GBATCHSIZER_H
+#define GBATCHSIZER_H
+
+#include <QtGlobal>
+
+//! \brief Chooses the size of the batch pages sent to the server
+///
+/// Pages are limited by number of entries and by encoded size. The entry
+/// limit grows while the server replies fast and full pages succeed, and both
+/// limits shrink when a request times out or fails with 413 or 5xx.
+class GBatchSizer
+{
+public:
+    GBatchSizer(int pageSize, int minPageSize, int maxPageSize,
+                int maxPageBytes, int fastReplyMsecs);
+
+    int pageSize() const;
+    int maxPageBytes() const;
+
+    /*!
+     * \brief Register a successful batch request
+     * \param entries Number of entries sent on the request
+     * \param msecs Time taken by the request
+     */
+    void success(int entries, qint64 msecs);
+
+    /*!
+     * \brief Register a failed batch request
+     * \param errorCode The HTTP error code of the request
+     * \return Returns true if the error can be caused by the page size, the following pages are smaller
+     */
+    bool failure(int errorCode);
+
+private:
+    int mPageSize;
+    int mMinPageSize;
+    int mMaxPageSize;
+    int mMaxPageBytes;
+    int mMinPageBytes;
+    int mFastReplyMsecs;
+};
+
+#endif // GBATCHSIZER_H
@@ -27,6 +27,23 @@
 #include "GConfig.h"
 
 const int GConfig::MAX_RESULTS = 30;
+const int GConfig::MAX_AVATAR_DOWNLOADS = 6;
+const int GConfig::AVATAR_DOWNLOAD_TIMEOUT = 30000;
+const int GConfig::MAX_AVATAR_UPLOADS = 4;
+const int GConfig::REQUEST_TIMEOUT = 60000;
+const int GConfig::MAX_PARALLEL_FETCHES = 4;
+const int GConfig::MANIFEST_MAX_RESULTS = 1000;
+// the group membership is needed because only "My Contacts" entries are parsed
+const QString GConfig::MANIFEST_FIELDS = "openSearch:totalResults,link[@rel='next'],"
+                                         "entry(@gd:etag,id,gContact:groupMembershipInfo)";
+const int GConfig::PROBE_MAX_RESULTS = 1;
+const QString GConfig::PROBE_FIELDS = "openSearch:totalResults";
+const int GConfig::BATCH_MIN_RESULTS = 5;
+const int GConfig::BATCH_MAX_RESULTS = 100;
+const int GConfig::BATCH_MAX_BYTES = 512 * 1024;
+const int GConfig::BATCH_FAST_REPLY = 3000;
+const int GConfig::BATCH_MAX_RETRIES = 3;
+const qint64 GConfig::AVATAR_CACHE_MAX_SIZE = 50 * 1024 * 1024;
 const QString GConfig::SCOPE_URL = "https://www.google.com/m8/feeds/";
 const QString GConfig::GCONTACT_URL = SCOPE_URL + "/contacts/default/";
 
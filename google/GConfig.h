@@ -33,6 +33,27 @@ class GConfig
 {
 public:
     static const int MAX_RESULTS;
+    static const int MAX_AVATAR_DOWNLOADS;
+    static const int AVATAR_DOWNLOAD_TIMEOUT;
+    static const int MAX_AVATAR_UPLOADS;
+    static const int REQUEST_TIMEOUT;
+    static const int MAX_PARALLEL_FETCHES;
+
+    /* Etag manifest used to reconcile a sync target without a sync log */
+    static const int MANIFEST_MAX_RESULTS;
+    static const QString MANIFEST_FIELDS;
+
+    /* Count of the changed entries, checked before a fast sync */
+    static const int PROBE_MAX_RESULTS;
+    static const QString PROBE_FIELDS;
+
+    /* Batch page sizing */
+    static const int BATCH_MIN_RESULTS;
+    static const int BATCH_MAX_RESULTS;
+    static const int BATCH_MAX_BYTES;
+    static const int BATCH_FAST_REPLY;
+    static const int BATCH_MAX_RETRIES;
+    static const qint64 AVATAR_CACHE_MAX_SIZE;
     static const QString SCOPE_URL;
     static const QString GCONTACT_URL;
 
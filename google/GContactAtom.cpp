@@ -31,6 +31,7 @@ GoogleContactAtom::BatchOperationResponse::BatchOperationResponse()
 }
 
 GoogleContactAtom::GoogleContactAtom()
+    : mTotalResults(-1)
 {
 }
 
@@ -188,6 +189,16 @@ QList<QContact> GoogleContactAtom::deletedEntryContacts() const
     return mDeletedContactList;
 }
 
+void GoogleContactAtom::addUnchangedEntry(const QString &remoteId)
+{
+    mUnchangedEntries.append(remoteId);
+}
+
+QStringList GoogleContactAtom::unchangedEntries() const
+{
+    return mUnchangedEntries;
+}
+
 void GoogleContactAtom::addEntrySystemGroup(const QString &systemGroupId, const QString &systemGroupAtomId)
 {
     mSystemGroupAtomIds.insert(systemGroupId, systemGroupAtomId);
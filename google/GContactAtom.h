@@ -80,6 +80,9 @@ public:
     QList<QPair<QContact, QStringList> > entryContacts() const;
     void addDeletedEntryContact(const QContact &contact);
     QList<QContact> deletedEntryContacts() const;
+    // entries skipped because their etag did not change
+    void addUnchangedEntry(const QString &remoteId);
+    QStringList unchangedEntries() const;
 
     void addEntrySystemGroup(const QString &systemGroupId, const QString &systemGroupAtomId);
     QMap<QString, QString> entrySystemGroups() const;
@@ -129,6 +132,7 @@ private:
 
     QList<QContact> mDeletedContactList;
     QList<QPair<QContact, QStringList> > mContactList;
+    QStringList mUnchangedEntries;
 
     QMap<QString, QString> mSystemGroupAtomIds;
 
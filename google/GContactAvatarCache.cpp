@@ -0,0 +1,145 @@
+/****************************************************************************
+ **
+ ** Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ **
+ ** This program/library is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public License
+ ** version 2.1 as published by the Free Software Foundation.
+ **
+ ** This program/library is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this program/library; if not, write to the Free
+ ** Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ ** 02110-1301 USA
+ **
+ ****************************************************************************/
+
+
+#include "GContactAvatarCache.h"
+
+#include <LogMacros.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <utime.h>
+
+static QString sha1(const QByteArray &data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+GContactAvatarCache::GContactAvatarCache(const QString &cacheDir, qint64 maxSize)
+    : mBlobsDir(cacheDir + "/blobs"),
+      mEtagsDir(cacheDir + "/etags"),
+      mCacheDir(cacheDir),
+      mMaxSize(maxSize),
+      mSize(-1)
+{
+    QDir().mkpath(mBlobsDir);
+    QDir().mkpath(mEtagsDir);
+}
+
+QString GContactAvatarCache::cacheDir() const
+{
+    return mCacheDir;
+}
+
+QString GContactAvatarCache::etagFileName(const QString &etag) const
+{
+    // etags can contain any character use a hash as file name
+    return QString("%1/%2").arg(mEtagsDir).arg(sha1(etag.toUtf8()));
+}
+
+QUrl GContactAvatarCache::lookup(const QString &etag)
+{
+    if (etag.isEmpty()) {
+        return QUrl();
+    }
+
+    // QFileInfo follows the link, this fails if the blob was evicted
+    QFileInfo info(etagFileName(etag));
+    if (!info.exists()) {
+        return QUrl();
+    }
+
+    // update the access time used by the eviction
+    QString blob = info.canonicalFilePath();
+    ::utime(QFile::encodeName(blob).constData(), 0);
+    return QUrl::fromLocalFile(blob);
+}
+
+QUrl GContactAvatarCache::insert(const QString &etag, const QByteArray &imgData)
+{
+    QString blob = QString("%1/%2").arg(mBlobsDir).arg(sha1(imgData));
+
+    if (QFile::exists(blob)) {
+        // same image used by other contact
+        ::utime(QFile::encodeName(blob).constData(), 0);
+    } else {
+        QSaveFile file(blob);
+        if (!file.open(QIODevice::WriteOnly) ||
+            (file.write(imgData) != imgData.size()) ||
+            !file.commit()) {
+            LOG_WARNING("Fail to save avatar on cache:" << file.errorString());
+            return QUrl();
+        }
+        if (mSize >= 0) {
+            mSize += imgData.size();
+        }
+    }
+
+    if (!etag.isEmpty()) {
+        QString link = etagFileName(etag);
+        QFile::remove(link);
+        if (!QFile::link(blob, link)) {
+            LOG_WARNING("Fail to link avatar etag:" << etag);
+        }
+    }
+
+    // the new image is the most recently used, it is not evicted
+    if ((mSize < 0) || (mSize > mMaxSize)) {
+        evict();
+    }
+
+    return QUrl::fromLocalFile(blob);
+}
+
+void GContactAvatarCache::evict()
+{
+    // most recently used first
+    QFileInfoList blobs = QDir(mBlobsDir).entryInfoList(QDir::Files, QDir::Time);
+
+    qint64 size = 0;
+    int removed = 0;
+    mSize = 0;
+    foreach (const QFileInfo &blob, blobs) {
+        size += blob.size();
+        if (size > mMaxSize) {
+            QFile::remove(blob.absoluteFilePath());
+            removed++;
+        } else {
+            mSize = size;
+        }
+    }
+
+    if (removed == 0) {
+        return;
+    }
+
+    // remove links for evicted images
+    QFileInfoList links = QDir(mEtagsDir).entryInfoList(QDir::System | QDir::Files);
+    foreach (const QFileInfo &link, links) {
+        if (!link.exists()) {
+            QFile::remove(link.absoluteFilePath());
+        }
+    }
+    LOG_DEBUG("Avatar cache evicted" << removed << "images");
+}
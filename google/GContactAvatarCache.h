@@ -0,0 +1,74 @@
+/****************************************************************************
+ **
+ ** Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ **
+ ** This program/library is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public License
+ ** version 2.1 as published by the Free Software Foundation.
+ **
+ ** This program/library is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this program/library; if not, write to the Free
+ ** Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ ** 02110-1301 USA
+ **
+ ****************************************************************************/
+
+
+#ifndef GOOGLECONTACTAVATARCACHE_H
+#define GOOGLECONTACTAVATARCACHE_H
+
+#include <QString>
+#include <QUrl>
+#include <QByteArray>
+
+//! \brief Persistent avatar cache keyed by the Google photo etag
+///
+/// Images are stored once by the sha1 of their content on "blobs" and every
+/// known photo etag is a symbolic link on "etags" pointing to its image.
+/// Blobs are evicted in least recently used order when the cache gets bigger
+/// than the size limit.
+///
+/// The cache directory is shared by all accounts, a photo etag identifies the
+/// same image for any of them. The size limit applies to the whole directory,
+/// images stored by other syncs are only counted when evict() scans it.
+class GContactAvatarCache
+{
+public:
+    GContactAvatarCache(const QString &cacheDir, qint64 maxSize);
+
+    /*!
+     * \brief Return the local file of the image with the etag or an empty url if not cached
+     */
+    QUrl lookup(const QString &etag);
+
+    /*!
+     * \brief Store a image in the cache, evicting old images if the cache gets too big
+     * \return The local file of the image or an empty url in case of error
+     */
+    QUrl insert(const QString &etag, const QByteArray &imgData);
+
+    /*!
+     * \brief Remove the least recently used images until the cache fits on the size limit
+     */
+    void evict();
+
+    QString cacheDir() const;
+
+private:
+    QString mBlobsDir;
+    QString mEtagsDir;
+    QString mCacheDir;
+    qint64 mMaxSize;
+    // size of the blobs after the last eviction plus the blobs inserted since,
+    // -1 until the directory is scanned
+    qint64 mSize;
+
+    QString etagFileName(const QString &etag) const;
+};
+
+#endif // GOOGLECONTACTAVATARCACHE_H
@@ -22,6 +22,8 @@
 
 #include "GContactImageDownloader.h"
 #include "GTransport.h"
+#include "GConfig.h"
+#include "GContactAvatarCache.h"
 
 #include <LogMacros.h>
 
@@ -29,12 +31,17 @@
 #include <QNetworkReply>
 #include <QNetworkAccessManager>
 #include <QTemporaryFile>
+#include <QTimer>
 
 GContactImageDownloader::GContactImageDownloader(const QString &authToken, QObject *parent)
     : QObject(parent),
-      mEventLoop(0),
+      mNetworkAccessManager(0),
+      mMaxConcurrentRequests(GConfig::MAX_AVATAR_DOWNLOADS),
+      mRequestTimeout(GConfig::AVATAR_DOWNLOAD_TIMEOUT),
+      mCache(0),
       mAuthToken(authToken),
-      mAbort(false)
+      mAbort(false),
+      mFinished(false)
 {
 }
 
@@ -45,8 +52,20 @@ GContactImageDownloader::~GContactImageDownloader()
     }
 }
 
-void GContactImageDownloader::push(const QUrl &imgUrl)
+void GContactImageDownloader::push(const QUrl &imgUrl, const QString &etag)
 {
+    if (mCache) {
+        QUrl localFile = mCache->lookup(etag);
+        if (!localFile.isEmpty()) {
+            LOG_DEBUG("Avatar found on cache:" << imgUrl);
+            mResults.insert(imgUrl, localFile);
+            return;
+        }
+    }
+
+    if (!etag.isEmpty()) {
+        mEtags.insert(imgUrl, etag);
+    }
     mQueue.push_back(imgUrl);
 }
 
@@ -55,37 +74,103 @@ QMap<QUrl, QUrl> GContactImageDownloader::donwloaded()
     return mResults;
 }
 
-void GContactImageDownloader::exec()
+void GContactImageDownloader::setMaxConcurrentRequests(int count)
+{
+    mMaxConcurrentRequests = qMax(1, count);
+}
+
+void GContactImageDownloader::setRequestTimeout(int msecs)
+{
+    mRequestTimeout = msecs;
+}
+
+void GContactImageDownloader::setCache(GContactAvatarCache *cache)
+{
+    mCache = cache;
+}
+
+void GContactImageDownloader::start()
 {
-    QNetworkAccessManager *networkAccessManager = new QNetworkAccessManager;
-    connect(networkAccessManager,
-            SIGNAL(finished(QNetworkReply*)),
-            SLOT(onRequestFinished(QNetworkReply*)),
-            Qt::QueuedConnection);
+    if (!mNetworkAccessManager) {
+        mNetworkAccessManager = new QNetworkAccessManager(this);
+        connect(mNetworkAccessManager,
+                SIGNAL(finished(QNetworkReply*)),
+                SLOT(onRequestFinished(QNetworkReply*)));
+    }
 
+    // all requests share the same host, the network access manager keeps
+    // the connections alive and reuses them for the next requests
+    startRequests();
+    if (mRunningRequests.isEmpty()) {
+        finish();
+    }
+}
+
+bool GContactImageDownloader::isFinished() const
+{
+    return mFinished;
+}
+
+void GContactImageDownloader::exec()
+{
     QEventLoop eventLoop;
-    mEventLoop = &eventLoop;
+    connect(this, SIGNAL(finished()), &eventLoop, SLOT(quit()));
 
-    while(!mQueue.isEmpty()) {
+    start();
+    if (!mFinished) {
+        // wait for all downloads to finish
+        eventLoop.exec();
+    }
+}
+
+void GContactImageDownloader::abort()
+{
+    mAbort = true;
+    mQueue.clear();
+
+    // aborting a reply emits finished synchronously
+    foreach(QNetworkReply *reply, mRunningRequests.toList()) {
+        reply->abort();
+    }
+}
+
+void GContactImageDownloader::startRequests()
+{
+    while (!mAbort &&
+           !mQueue.isEmpty() &&
+           (mRunningRequests.size() < mMaxConcurrentRequests)) {
         QNetworkRequest request(mQueue.takeFirst());
         request.setRawHeader(QStringLiteral("GData-Version").toUtf8(), QStringLiteral("3.0").toUtf8());
         request.setRawHeader(QStringLiteral("Authorization").toUtf8(),
                              QStringLiteral("Bearer %1").arg(mAuthToken).toUtf8());
-        networkAccessManager->get(request);
-
-        // wait for the download to finish
-        eventLoop.exec();
-
-        // should we abort?
-        if (mAbort) {
-            break;
+        QNetworkReply *reply = mNetworkAccessManager->get(request);
+        mRunningRequests << reply;
+
+        if (mRequestTimeout > 0) {
+            // the timer is owned by the reply and will be destroyed with it
+            QTimer *timer = new QTimer(reply);
+            timer->setSingleShot(true);
+            connect(timer, SIGNAL(timeout()), SLOT(onRequestTimeout()));
+            timer->start(mRequestTimeout);
         }
     }
-    delete networkAccessManager;
+}
+
+void GContactImageDownloader::onRequestTimeout()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender()->parent());
+    if (reply && mRunningRequests.contains(reply)) {
+        LOG_WARNING("Avatar download timeout:" << reply->url());
+        reply->abort();
+    }
 }
 
 void GContactImageDownloader::onRequestFinished(QNetworkReply *reply)
 {
+    if (!mRunningRequests.remove(reply)) {
+        return;
+    }
+
     if (reply->error() != QNetworkReply::NoError) {
         LOG_WARNING("Fail to download avatar:" << reply->errorString());
         emit donwloadError(reply->url(), reply->errorString());
@@ -94,15 +179,37 @@ void GContactImageDownloader::onRequestFinished(QNetworkReply *reply)
         mResults.insert(reply->url(), localFile);
         emit downloadFinished(reply->url(), localFile);
     }
+    reply->deleteLater();
+
+    startRequests();
+    if (mRunningRequests.isEmpty()) {
+        finish();
+    }
+}
+
+void GContactImageDownloader::finish()
+{
+    if (mFinished) {
+        return;
+    }
 
-    if (mEventLoop) {
-        mEventLoop->quit();
+    // called from the reply handler, the connections are released later
+    mFinished = true;
+    if (mNetworkAccessManager) {
+        mNetworkAccessManager->deleteLater();
+        mNetworkAccessManager = 0;
     }
+    emit finished();
 }
 
 QUrl GContactImageDownloader::saveImage(const QUrl &remoteFile, const QByteArray &imgData)
 {
-    Q_UNUSED(remoteFile);
+    if (mCache) {
+        QUrl localFile = mCache->insert(mEtags.value(remoteFile), imgData);
+        if (!localFile.isEmpty()) {
+            return localFile;
+        }
+    }
 
     QTemporaryFile tmp;
     if (tmp.open()) {
@@ -114,4 +221,3 @@ QUrl GContactImageDownloader::saveImage(const QUrl &remoteFile, const QByteArray
     }
     return QUrl();
 }
-
@@ -29,11 +29,14 @@
 #include <QQueue>
 #include <QThread>
 #include <QMap>
+#include <QHash>
 #include <QMutex>
 #include <QEventLoop>
+#include <QSet>
 #include <QtNetwork/QNetworkAccessManager>
 
 class GTransport;
+class GContactAvatarCache;
 
 class GContactImageDownloader: public QObject
 {
@@ -43,25 +46,49 @@ public:
     explicit GContactImageDownloader(const QString &authToken, QObject *parent = 0);
     ~GContactImageDownloader();
 
-    void push(const QUrl &imgUrl);
+    void push(const QUrl &imgUrl, const QString &etag = QString());
     QMap<QUrl, QUrl> donwloaded();
+    // start the downloads, finished() is emitted when all of them are done
+    void start();
+    bool isFinished() const;
+    // start the downloads and wait for them on a local event loop
     void exec();
 
+    // number of downloads running at same time
+    void setMaxConcurrentRequests(int count);
+    // time in msecs to wait for a download before cancel it, 0 disables the timeout
+    void setRequestTimeout(int msecs);
+    // images found on the cache are not downloaded, downloaded images are stored on it
+    void setCache(GContactAvatarCache *cache);
+
+public slots:
+    void abort();
+
 signals:
     void downloadFinished(const QUrl &imgUrl, const QUrl &localFile);
     void donwloadError(const QUrl &imgUrl, const QString &error);
+    void finished();
 
 private slots:
     void onRequestFinished(QNetworkReply *reply);
+    void onRequestTimeout();
 
 private:
-    QEventLoop *mEventLoop;
+    QNetworkAccessManager *mNetworkAccessManager;
+    QSet<QNetworkReply*> mRunningRequests;
+    int mMaxConcurrentRequests;
+    int mRequestTimeout;
     QQueue<QUrl> mQueue;
+    QHash<QUrl, QString> mEtags;
+    GContactAvatarCache *mCache;
     QString mAuthToken;
     QMap<QUrl, QUrl> mResults;
     bool mAbort;
+    bool mFinished;
     QStringList mTempFiles;
 
+    void startRequests();
+    void finish();
     QUrl saveImage(const QUrl &remoteFile, const QByteArray &imgData);
 };
 
@@ -23,6 +23,7 @@
 #include "GContactImageUploader.h"
 #include "GContactStream.h"
 #include "GContactAtom.h"
+#include "GConfig.h"
 #include "UContactsCustomDetail.h"
 
 #include <LogMacros.h>
@@ -30,20 +31,26 @@
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QNetworkAccessManager>
-#include <QScopedPointer>
 #include <QDomDocument>
+#include <QFile>
 
 #define GOOGLE_URL          "https://www.google.com/m8/feeds/contacts/default/full"
 #define GOOGLE_PHOTO_URL    "https://www.google.com/m8/feeds/photos/media/%1/%2"
 
+// max number of operations accepted by google on a batch request
+#define GOOGLE_BATCH_LIMIT  100
+
 GContactImageUploader::GContactImageUploader(const QString &authToken,
                                              const QString &accountId,
                                              QObject *parent)
     : QObject(parent),
-      mEventLoop(0),
+      mNetworkAccessManager(0),
+      mEtagsReply(0),
       mAuthToken(authToken),
       mAccountId(accountId),
-      mAbort(false)
+      mMaxConcurrentRequests(GConfig::MAX_AVATAR_UPLOADS),
+      mAbort(false),
+      mFinished(false)
 {
 }
 
@@ -57,86 +64,112 @@ QMap<QString, GContactImageUploader::UploaderReply> GContactImageUploader::resul
     return mResults;
 }
 
-/*
- * This is a sync function since the contact sync process happen in a different
- * thread we do not need this function to be async
- */
-void GContactImageUploader::exec()
+bool GContactImageUploader::isFinished() const
 {
-    if (mQueue.isEmpty()) {
-        return;
-    }
+    return mFinished;
+}
 
-    QDateTime startTime = QDateTime::currentDateTime().toUTC();
-    QScopedPointer<QNetworkAccessManager> networkAccessManager(new QNetworkAccessManager);
-    connect(networkAccessManager.data(),
+void GContactImageUploader::setMaxConcurrentRequests(int count)
+{
+    mMaxConcurrentRequests = qMax(1, count);
+}
+
+void GContactImageUploader::start()
+{
+    mNetworkAccessManager = new QNetworkAccessManager(this);
+    connect(mNetworkAccessManager,
             SIGNAL(finished(QNetworkReply*)),
-            SLOT(onRequestFinished(QNetworkReply*)),
-            Qt::QueuedConnection);
+            SLOT(onRequestFinished(QNetworkReply*)));
 
-    QEventLoop eventLoop;
-    mEventLoop = &eventLoop;
-    mUploadCompleted = false;
+    startUploads();
+    if (mRunningUploads.isEmpty()) {
+        // nothing to upload, keep "finished" asynchronous
+        QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+    }
+}
 
-    while(!mQueue.isEmpty()) {
+void GContactImageUploader::abort()
+{
+    mAbort = true;
+    mQueue.clear();
+    mUploadedIds.clear();
+
+    // aborting a reply emits finished synchronously
+    foreach(QNetworkReply *reply, mRunningUploads.keys()) {
+        reply->abort();
+    }
+    if (mEtagsReply) {
+        mEtagsReply->abort();
+    }
+}
+
+void GContactImageUploader::startUploads()
+{
+    while (!mAbort &&
+           !mQueue.isEmpty() &&
+           (mRunningUploads.size() < mMaxConcurrentRequests)) {
         QPair<QString, QUrl> data = mQueue.takeFirst();
 
-        QByteArray imgData;
         QFile imgFile(data.second.toLocalFile());
         if (!imgFile.open(QIODevice::ReadOnly)) {
             LOG_WARNING("Fail to open file:" << data.second.toLocalFile());
             continue;
         }
-        imgData = imgFile.readAll();
-        imgFile.close();;
-        mCurrentRemoteId = data.first;
+        QByteArray imgData = imgFile.readAll();
+        imgFile.close();
 
         // upload photo
         QString requestUrl = QString(GOOGLE_PHOTO_URL)
                 .arg(mAccountId)
-                .arg(mCurrentRemoteId);
+                .arg(data.first);
         QNetworkRequest request(requestUrl);
         request.setRawHeader(QStringLiteral("GData-Version").toUtf8(), QStringLiteral("3.0").toUtf8());
         request.setRawHeader(QStringLiteral("Authorization").toUtf8(),
                              QStringLiteral("Bearer %1").arg(mAuthToken).toUtf8());
         request.setRawHeader(QStringLiteral("Content-Type").toUtf8(), QStringLiteral("image/*").toUtf8());
         request.setRawHeader(QStringLiteral("If-Match").toUtf8(), QStringLiteral("*").toUtf8());
-        networkAccessManager->put(request, imgData);
-
-        // wait for the upload to finish
-        eventLoop.exec();
-
-        // should we abort?
-        if (mAbort) {
-            break;
-        }
+        mRunningUploads.insert(mNetworkAccessManager->put(request, imgData), data.first);
     }
+}
 
-    mUploadCompleted = true;
-
-    if (mAbort) {
+/*
+ * After upload the pictures the contact etag get updated we need to retrieve
+ * the new ones. Use a batch query with the uploaded entries only.
+ */
+void GContactImageUploader::queryEtags()
+{
+    if (mAbort || mUploadedIds.isEmpty()) {
+        finish();
         return;
     }
 
-    // After upload the pictures the contact etag get updated we need to retrieve
-    // the new ones
-    QString requestUrl =
-            QString("%1?updated-min=%2&fields=entry(@gd:etag, id, link(@rel, @gd:etag))")
-            .arg(GOOGLE_URL)
-            .arg(startTime.toString(Qt::ISODate));
-    QNetworkRequest request(requestUrl);
+    QByteArray body("<feed xmlns=\"http://www.w3.org/2005/Atom\" "
+                    "xmlns:batch=\"http://schemas.google.com/gdata/batch\">");
+    for (int i = 0; (i < GOOGLE_BATCH_LIMIT) && !mUploadedIds.isEmpty(); i++) {
+        QString remoteId = mUploadedIds.takeFirst();
+        body += QString("<entry>"
+                            "<batch:id>%1</batch:id>"
+                            "<batch:operation type=\"query\"/>"
+                            "<id>%2/%1</id>"
+                        "</entry>").arg(remoteId).arg(GOOGLE_URL).toUtf8();
+    }
+    body += "</feed>";
+
+    QNetworkRequest request(QUrl(QStringLiteral(GOOGLE_URL "/batch")));
     request.setRawHeader(QStringLiteral("GData-Version").toUtf8(), QStringLiteral("3.0").toUtf8());
     request.setRawHeader(QStringLiteral("Authorization").toUtf8(),
                          QStringLiteral("Bearer %1").arg(mAuthToken).toUtf8());
-    networkAccessManager->get(request);
-
-    // wait for the reply to finish
-    eventLoop.exec();
+    request.setRawHeader(QStringLiteral("Content-Type").toUtf8(),
+                         QStringLiteral("application/atom+xml; charset=UTF-8; type=feed").toUtf8());
+    mEtagsReply = mNetworkAccessManager->post(request, body);
 }
 
 void GContactImageUploader::onRequestFinished(QNetworkReply *reply)
 {
-    if (mUploadCompleted) {
+    reply->deleteLater();
+
+    if (reply == mEtagsReply) {
+        mEtagsReply = 0;
         if (reply->error() != QNetworkReply::NoError) {
             LOG_WARNING("Fail to retrieve new etags:" << reply->errorString());
         } else {
@@ -150,20 +183,37 @@ void GContactImageUploader::onRequestFinished(QNetworkReply *reply)
                 }
             }
         }
+        queryEtags();
+        return;
+    }
+
+    if (!mRunningUploads.contains(reply)) {
+        return;
+    }
+
+    QString remoteId = mRunningUploads.take(reply);
+    mResults.insert(remoteId, UploaderReply());
+    if (reply->error() != QNetworkReply::NoError) {
+        LOG_WARNING("Fail to upload avatar:" << reply->errorString());
+        emit uploadError(remoteId, reply->errorString());
     } else {
-        mResults.insert(mCurrentRemoteId, UploaderReply());
-        if (reply->error() != QNetworkReply::NoError) {
-            LOG_WARNING("Fail to upload avatar:" << reply->errorString());
-            emit uploadError(mCurrentRemoteId, reply->errorString());
-        } else {
-            LOG_TRACE("Avatar upload result" << reply->readAll());
-        }
-        mCurrentRemoteId.clear();
+        LOG_TRACE("Avatar upload result" << reply->readAll());
+        mUploadedIds << remoteId;
     }
 
-    if (mEventLoop) {
-        mEventLoop->quit();
+    startUploads();
+    if (mRunningUploads.isEmpty()) {
+        queryEtags();
+    }
+}
+
+void GContactImageUploader::finish()
+{
+    if (mFinished) {
+        return;
     }
+    mFinished = true;
+    emit finished();
 }
 
 QMap<QString, GContactImageUploader::UploaderReply> GContactImageUploader::parseEntryList(const QByteArray &data) const
@@ -25,14 +25,14 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QQueue>
 #include <QMap>
-#include <QMutex>
-#include <QEventLoop>
+#include <QHash>
 #include <QNetworkReply>
 
-
+class QNetworkAccessManager;
 
 class GContactImageUploader: public QObject
 {
@@ -53,26 +53,45 @@ public:
 
     void push(const QString &remoteId, const QUrl &imgUrl);
     QMap<QString, UploaderReply> result();
-    void exec();
+    bool isFinished() const;
+
+    // number of uploads running at same time
+    void setMaxConcurrentRequests(int count);
+
+    /*
+     * Start the uploads and return immediately, "finished" is emitted
+     * after all images were uploaded and the new etags retrieved
+     */
+    void start();
+
+public slots:
+    void abort();
 
 signals:
     void uploadFinished(const QUrl &remoteId, const GContactImageUploader::UploaderReply &eTag);
     void uploadError(const QUrl &remoteId, const QString &error);
+    void finished();
 
 private slots:
     void onRequestFinished(QNetworkReply *reply);
+    void finish();
 
 private:
-    QEventLoop *mEventLoop;
+    QNetworkAccessManager *mNetworkAccessManager;
     QQueue<QPair<QString, QUrl> > mQueue;
+    QHash<QNetworkReply*, QString> mRunningUploads;
+    QNetworkReply *mEtagsReply;
+    QStringList mUploadedIds;
     QString mAuthToken;
     QString mAccountId;
-    QString mCurrentRemoteId;
     QMap<QString, UploaderReply> mResults;
+    int mMaxConcurrentRequests;
     bool mAbort;
-    bool mUploadCompleted;
+    bool mFinished;
 
-     QMap<QString, UploaderReply> parseEntryList(const QByteArray &data) const;
+    void startUploads();
+    void queryEtags();
+    QMap<QString, UploaderReply> parseEntryList(const QByteArray &data) const;
 };
 
 #endif // GOOGLECONTACTIMAGEUPLOADER_H
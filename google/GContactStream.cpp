@@ -33,22 +33,50 @@
 #include <QDateTime>
 #include <QtContacts/QContactId>
 
+namespace {
+
+struct ElementLookup
+{
+    const char *name;
+    int element;
+};
+
+int lookupElement(const ElementLookup *table, int size, const QStringRef &name)
+{
+    int first = 0;
+    int last = size - 1;
+    while (first <= last) {
+        int middle = (first + last) / 2;
+        int cmp = name.compare(QLatin1String(table[middle].name));
+        if (cmp == 0) {
+            return table[middle].element;
+        } else if (cmp < 0) {
+            last = middle - 1;
+        } else {
+            first = middle + 1;
+        }
+    }
+    return 0;
+}
+
+}
+
 GoogleContactStream::GoogleContactStream(bool response, const QString &accountEmail, QObject* parent)
     : QObject(parent)
+    , mParseDetails(!response)
     , mXmlReader(0)
     , mAtom(0)
+    , mScanOffset(0)
+    , mScanDepth(0)
     , mXmlWriter(0)
     , mAccountEmail(accountEmail)
 {
-    if (response == true) {
-        initResponseFunctionMap();
-    } else {
-        initFunctionMap();
-    }
 }
 
 GoogleContactStream::~GoogleContactStream()
 {
+    delete mAtom;
+    delete mXmlReader;
 }
 
 GoogleContactAtom *GoogleContactStream::parse(const QByteArray &xmlBuffer)
@@ -59,17 +87,167 @@ GoogleContactAtom *GoogleContactStream::parse(const QByteArray &xmlBuffer)
     Q_CHECK_PTR(mXmlReader);
     Q_CHECK_PTR(mAtom);
 
-    while (!mXmlReader->atEnd() && !mXmlReader->hasError()) {
-        if (mXmlReader->readNextStartElement()) {
-            Handler handler = mAtomFunctionMap.value(mXmlReader->name().toString());
-            if (handler) {
-                (*this.*handler)();
+    parseElements();
+
+    delete mXmlReader;
+    mXmlReader = 0;
+
+    GoogleContactAtom *atom = mAtom;
+    mAtom = 0;
+    return atom;
+}
+
+void GoogleContactStream::addData(const QByteArray &data)
+{
+    if (!mAtom) {
+        mAtom = new GoogleContactAtom;
+        mXmlReader = new QXmlStreamReader;
+        mPendingData.clear();
+        mScanOffset = 0;
+        mScanDepth = 0;
+    }
+
+    // the handlers read a whole element and cannot resume, the reader only
+    // gets data up to the end of the last complete feed child
+    mPendingData += data;
+    int completeSize = scanCompleteElements();
+    if (completeSize > 0) {
+        mXmlReader->addData(mPendingData.left(completeSize));
+        mPendingData.remove(0, completeSize);
+        mScanOffset -= completeSize;
+        parseElements();
+    }
+}
+
+GoogleContactAtom *GoogleContactStream::finishParse()
+{
+    if (!mAtom) {
+        return 0;
+    }
+
+    // every complete element was parsed by addData, data left means the
+    // reply was truncated
+    if (mXmlReader->hasError() &&
+        (mXmlReader->error() != QXmlStreamReader::PrematureEndOfDocument)) {
+        LOG_WARNING("Fail to parse feed:" << mXmlReader->errorString());
+    } else if ((mScanDepth > 0) || !mPendingData.trimmed().isEmpty()) {
+        LOG_WARNING("Reply does not contain a complete feed");
+    }
+
+    delete mXmlReader;
+    mXmlReader = 0;
+    mPendingData.clear();
+
+    GoogleContactAtom *atom = mAtom;
+    mAtom = 0;
+    return atom;
+}
+
+int GoogleContactStream::scanCompleteElements()
+{
+    // markup is matched on the bytes without decoding them, a token
+    // incomplete at the end of the data is scanned again with more data
+    int completeSize = 0;
+    const int size = mPendingData.size();
+    while (mScanOffset < size) {
+        int start = mPendingData.indexOf('<', mScanOffset);
+        if (start < 0) {
+            mScanOffset = size;
+            break;
+        }
+
+        const char *token = mPendingData.constData() + start;
+        int available = size - start;
+        int end = -1;
+        bool closesChild = false;
+        if (((available < 9) && (qstrncmp(token, "<![CDATA[", available) == 0)) ||
+            ((available < 4) && (qstrncmp(token, "<!--", available) == 0))) {
+            // not enough data to tell the token type
+            break;
+        } else if (qstrncmp(token, "<!--", 4) == 0) {
+            end = mPendingData.indexOf("-->", start + 4);
+            end = (end < 0) ? -1 : end + 2;
+        } else if (qstrncmp(token, "<![CDATA[", 9) == 0) {
+            end = mPendingData.indexOf("]]>", start + 9);
+            end = (end < 0) ? -1 : end + 2;
+        } else if (token[1] == '?') {
+            end = mPendingData.indexOf("?>", start + 2);
+            end = (end < 0) ? -1 : end + 1;
+        } else if (token[1] == '!') {
+            end = mPendingData.indexOf('>', start + 2);
+        } else if (token[1] == '/') {
+            end = mPendingData.indexOf('>', start + 2);
+            if (end >= 0) {
+                mScanDepth--;
+                closesChild = (mScanDepth <= 1);
             }
+        } else {
+            // start tag, attribute values can hold '>'
+            char quote = 0;
+            for (int i = start + 1; (i < size) && (end < 0); i++) {
+                char c = mPendingData.at(i);
+                if (quote) {
+                    quote = (c == quote) ? 0 : quote;
+                } else if ((c == '"') || (c == '\'')) {
+                    quote = c;
+                } else if (c == '>') {
+                    end = i;
+                }
+            }
+            if (end >= 0) {
+                if (mPendingData.at(end - 1) == '/') {
+                    closesChild = (mScanDepth == 1);
+                } else {
+                    mScanDepth++;
+                }
+            }
+        }
+
+        if (end < 0) {
+            // wait for the rest of the token
+            break;
+        }
+        mScanOffset = end + 1;
+        if (closesChild) {
+            completeSize = mScanOffset;
         }
     }
+    return completeSize;
+}
 
-    delete mXmlReader;
-    return mAtom;
+void GoogleContactStream::setKnownETags(const QHash<QString, QString> &etags)
+{
+    mKnownETags = etags;
+}
+
+void GoogleContactStream::skipEntry()
+{
+    while (!mXmlReader->atEnd() &&
+           !((mXmlReader->tokenType() == QXmlStreamReader::EndElement) &&
+             (mXmlReader->name() == QLatin1String("entry")))) {
+        mXmlReader->readNext();
+    }
+}
+
+void GoogleContactStream::parseElements()
+{
+    // PrematureEndOfDocument is recovered by reading again after addData
+    while (mXmlReader->hasError() ?
+           (mXmlReader->error() == QXmlStreamReader::PrematureEndOfDocument) :
+           !mXmlReader->atEnd()) {
+        if (!mXmlReader->readNextStartElement()) {
+            if (mXmlReader->error() == QXmlStreamReader::PrematureEndOfDocument) {
+                // wait for more data
+                return;
+            }
+            continue;
+        }
+
+        Handler handler = atomHandler(atomElement(mXmlReader->name()));
+        if (handler) {
+            (*this.*handler)();
+        }
+    }
 }
 
 QByteArray GoogleContactStream::encode(const QMultiMap<GoogleContactStream::UpdateType, QPair<QContact, QStringList> > &updates)
@@ -101,50 +279,135 @@ QByteArray GoogleContactStream::encode(const QMultiMap<GoogleContactStream::Upda
 
 // ----------------------------------------
 
-void GoogleContactStream::initAtomFunctionMap()
-{
-    mAtomFunctionMap.insert("updated", &GoogleContactStream::handleAtomUpdated);
-    mAtomFunctionMap.insert("category", &GoogleContactStream::handleAtomCategory);
-    mAtomFunctionMap.insert("author", &GoogleContactStream::handleAtomAuthor);
-    mAtomFunctionMap.insert("id", &GoogleContactStream::handleAtomId);
-    mAtomFunctionMap.insert("totalResults", &GoogleContactStream::handleAtomOpenSearch);
-    mAtomFunctionMap.insert("startIndex", &GoogleContactStream::handleAtomOpenSearch);
-    mAtomFunctionMap.insert("itemsPerPage", &GoogleContactStream::handleAtomOpenSearch);
-    mAtomFunctionMap.insert("link", &GoogleContactStream::handleAtomLink);
-    mAtomFunctionMap.insert("entry", &GoogleContactStream::handleAtomEntry);
-    mAtomFunctionMap.insert("generator", &GoogleContactStream::handleAtomGenerator);
-    mAtomFunctionMap.insert("title", &GoogleContactStream::handleAtomTitle);
-}
-
-void GoogleContactStream::initResponseFunctionMap()
-{
-    initAtomFunctionMap();
-    // TODO: move the batch request response handling stuff here.
-}
-
-void GoogleContactStream::initFunctionMap()
-{
-    initAtomFunctionMap();
-    mContactFunctionMap.insert("updated", &GoogleContactStream::handleEntryUpdated);
-    //mContactFunctionMap.insert("app:edited", &GoogleContactStream::handleEntryUpdated);
-    mContactFunctionMap.insert("gContact:birthday", &GoogleContactStream::handleEntryBirthday);
-    mContactFunctionMap.insert("gContact:gender", &GoogleContactStream::handleEntryGender);
-    mContactFunctionMap.insert("gContact:hobby", &GoogleContactStream::handleEntryHobby);
-    mContactFunctionMap.insert("gContact:nickname", &GoogleContactStream::handleEntryNickname);
-    mContactFunctionMap.insert("gContact:occupation", &GoogleContactStream::handleEntryOccupation);
-    mContactFunctionMap.insert("gContact:website", &GoogleContactStream::handleEntryWebsite);
-    mContactFunctionMap.insert("gContact:groupMembershipInfo", &GoogleContactStream::handleEntryGroup);
-    mContactFunctionMap.insert("gContact:event", &GoogleContactStream::handleEntryEvent);
-    mContactFunctionMap.insert("gContact:jot", &GoogleContactStream::handleEntryJot);
-    mContactFunctionMap.insert("gContact:relation", &GoogleContactStream::handleRelation);
-    mContactFunctionMap.insert("gd:email", &GoogleContactStream::handleEntryEmail);
-    mContactFunctionMap.insert("gd:im", &GoogleContactStream::handleEntryIm);
-    mContactFunctionMap.insert("gd:name", &GoogleContactStream::handleEntryName);
-    mContactFunctionMap.insert("gd:organization", &GoogleContactStream::handleEntryOrganization);
-    mContactFunctionMap.insert("gd:phoneNumber", &GoogleContactStream::handleEntryPhoneNumber);
-    mContactFunctionMap.insert("gd:structuredPostalAddress", &GoogleContactStream::handleEntryStructuredPostalAddress);
-    mContactFunctionMap.insert("gd:extendedProperty", &GoogleContactStream::handleEntryExtendedProperty);
-
+GoogleContactStream::Element GoogleContactStream::atomElement(const QStringRef &name)
+{
+    // feed elements by local name, sorted for the binary search
+    static const ElementLookup ATOM_ELEMENTS[] = {
+        { "author", ElementAuthor },
+        { "category", ElementCategory },
+        { "entry", ElementEntry },
+        { "generator", ElementGenerator },
+        { "id", ElementId },
+        { "itemsPerPage", ElementItemsPerPage },
+        { "link", ElementLink },
+        { "startIndex", ElementStartIndex },
+        { "title", ElementTitle },
+        { "totalResults", ElementTotalResults },
+        { "updated", ElementUpdated }
+    };
+
+    return Element(lookupElement(ATOM_ELEMENTS,
+                                 sizeof(ATOM_ELEMENTS) / sizeof(ATOM_ELEMENTS[0]),
+                                 name));
+}
+
+GoogleContactStream::Element GoogleContactStream::entryElement(const QStringRef &qualifiedName)
+{
+    // entry elements by qualified name, sorted for the binary search
+    static const ElementLookup ENTRY_ELEMENTS[] = {
+        { "batch:id", ElementBatchId },
+        { "batch:operation", ElementBatchOperation },
+        { "batch:status", ElementBatchStatus },
+        { "entry", ElementEntry },
+        { "gContact:birthday", ElementBirthday },
+        { "gContact:event", ElementEvent },
+        { "gContact:gender", ElementGender },
+        { "gContact:groupMembershipInfo", ElementGroupMembershipInfo },
+        { "gContact:hobby", ElementHobby },
+        { "gContact:jot", ElementJot },
+        { "gContact:nickname", ElementNickname },
+        { "gContact:occupation", ElementOccupation },
+        { "gContact:relation", ElementRelation },
+        { "gContact:systemGroup", ElementSystemGroup },
+        { "gContact:website", ElementWebsite },
+        { "gd:deleted", ElementDeleted },
+        { "gd:email", ElementEmail },
+        { "gd:extendedProperty", ElementExtendedProperty },
+        { "gd:im", ElementIm },
+        { "gd:name", ElementName },
+        { "gd:organization", ElementOrganization },
+        { "gd:phoneNumber", ElementPhoneNumber },
+        { "gd:structuredPostalAddress", ElementStructuredPostalAddress },
+        { "id", ElementId },
+        { "link", ElementLink },
+        { "updated", ElementUpdated }
+    };
+
+    return Element(lookupElement(ENTRY_ELEMENTS,
+                                 sizeof(ENTRY_ELEMENTS) / sizeof(ENTRY_ELEMENTS[0]),
+                                 qualifiedName));
+}
+
+GoogleContactStream::Handler GoogleContactStream::atomHandler(Element element)
+{
+    switch (element) {
+    case ElementUpdated:
+        return &GoogleContactStream::handleAtomUpdated;
+    case ElementCategory:
+        return &GoogleContactStream::handleAtomCategory;
+    case ElementAuthor:
+        return &GoogleContactStream::handleAtomAuthor;
+    case ElementId:
+        return &GoogleContactStream::handleAtomId;
+    case ElementTotalResults:
+    case ElementStartIndex:
+    case ElementItemsPerPage:
+        return &GoogleContactStream::handleAtomOpenSearch;
+    case ElementLink:
+        return &GoogleContactStream::handleAtomLink;
+    case ElementEntry:
+        return &GoogleContactStream::handleAtomEntry;
+    case ElementGenerator:
+        return &GoogleContactStream::handleAtomGenerator;
+    case ElementTitle:
+        return &GoogleContactStream::handleAtomTitle;
+    default:
+        return 0;
+    }
+}
+
+GoogleContactStream::DetailHandler GoogleContactStream::detailHandler(Element element)
+{
+    switch (element) {
+    case ElementUpdated:
+        return &GoogleContactStream::handleEntryUpdated;
+    case ElementBirthday:
+        return &GoogleContactStream::handleEntryBirthday;
+    case ElementGender:
+        return &GoogleContactStream::handleEntryGender;
+    case ElementHobby:
+        return &GoogleContactStream::handleEntryHobby;
+    case ElementNickname:
+        return &GoogleContactStream::handleEntryNickname;
+    case ElementOccupation:
+        return &GoogleContactStream::handleEntryOccupation;
+    case ElementWebsite:
+        return &GoogleContactStream::handleEntryWebsite;
+    case ElementGroupMembershipInfo:
+        return &GoogleContactStream::handleEntryGroup;
+    case ElementEvent:
+        return &GoogleContactStream::handleEntryEvent;
+    case ElementJot:
+        return &GoogleContactStream::handleEntryJot;
+    case ElementRelation:
+        return &GoogleContactStream::handleRelation;
+    case ElementEmail:
+        return &GoogleContactStream::handleEntryEmail;
+    case ElementIm:
+        return &GoogleContactStream::handleEntryIm;
+    case ElementName:
+        return &GoogleContactStream::handleEntryName;
+    case ElementOrganization:
+        return &GoogleContactStream::handleEntryOrganization;
+    case ElementPhoneNumber:
+        return &GoogleContactStream::handleEntryPhoneNumber;
+    case ElementStructuredPostalAddress:
+        return &GoogleContactStream::handleEntryStructuredPostalAddress;
+    case ElementExtendedProperty:
+        return &GoogleContactStream::handleEntryExtendedProperty;
+    default:
+        return 0;
+    }
 }
 
 // ----------------------------------------
@@ -258,10 +521,11 @@ void GoogleContactStream::handleAtomEntry()
     bool isBatchOperationResponse = false;
     GoogleContactAtom::BatchOperationResponse response;
 
-    while (!((mXmlReader->tokenType() == QXmlStreamReader::EndElement) && (mXmlReader->name() == "entry"))) {
+    while (!((mXmlReader->tokenType() == QXmlStreamReader::EndElement) && (mXmlReader->name() == QLatin1String("entry")))) {
         if (mXmlReader->tokenType() == QXmlStreamReader::StartElement) {
-            isInGroup |=  (mXmlReader->qualifiedName().toString() == QStringLiteral("gContact:groupMembershipInfo"));
-            DetailHandler handler = mContactFunctionMap.value(mXmlReader->qualifiedName().toString());
+            Element element = entryElement(mXmlReader->qualifiedName());
+            isInGroup |= (element == ElementGroupMembershipInfo);
+            DetailHandler handler = mParseDetails ? detailHandler(element) : 0;
             if (handler) {
                 QContactDetail convertedDetail = (*this.*handler)();
                 if (convertedDetail != QContactDetail()) {
@@ -269,18 +533,18 @@ void GoogleContactStream::handleAtomEntry()
                 } else {
                     LOG_WARNING("Handle not found for " << mXmlReader->qualifiedName().toString());
                 }
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("gd:deleted")) {
+            } else if (element == ElementDeleted) {
                 isDeleted = true;
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("batch:id")) {
+            } else if (element == ElementBatchId) {
                 isBatchOperationResponse = true;
                 handleEntryBatchId(&response);
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("batch:operation")) {
+            } else if (element == ElementBatchOperation) {
                 isBatchOperationResponse = true;
                 handleEntryBatchOperation(&response);
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("batch:status")) {
+            } else if (element == ElementBatchStatus) {
                 isBatchOperationResponse = true;
                 handleEntryBatchStatus(&response);
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("link")) {
+            } else if (element == ElementLink) {
                 // There are several possible links:
                 // Avatar Photo link
                 // Self query link
@@ -304,15 +568,25 @@ void GoogleContactStream::handleAtomEntry()
                 if (!unsupportedElement.isEmpty()) {
                     unsupportedElements.append(unsupportedElement);
                 }
-            } else if (mXmlReader->name().toString() == QStringLiteral("entry")) {
+            } else if (element == ElementEntry) {
                 // read the etag out of the entry.
                 response.eTag = mXmlReader->attributes().value("gd:etag").toString();
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("gContact:systemGroup")) {
+            } else if (element == ElementSystemGroup) {
                 systemGroupId = mXmlReader->attributes().value("id").toString();
-            } else if (mXmlReader->qualifiedName().toString() == QStringLiteral("id")) {
+            } else if (element == ElementId) {
                 // either a contact id or a group id.
                 QContactDetail guidDetail = handleEntryId(&systemGroupAtomId);
                 entryContact.saveDetail(&guidDetail);
+
+                // the entry did not change since it was stored locally
+                QString remoteId = entryContact.detail<QContactGuid>().guid();
+                if (!response.eTag.isEmpty() &&
+                    mKnownETags.contains(remoteId) &&
+                    (mKnownETags.value(remoteId) == response.eTag)) {
+                    skipEntry();
+                    mAtom->addUnchangedEntry(remoteId);
+                    return;
+                }
             } else {
                 // This is some XML element which we don't handle.
                 // We should store it, so that we can send it back when we upload changes.
@@ -873,6 +1147,54 @@ QContactDetail GoogleContactStream::handleEntryGroup()
 
 // ----------------------------------------
 
+QContactFetchHint GoogleContactStream::contactUpdateFetchHint()
+{
+    // must be kept in sync with the details handled by encodeContactUpdate()
+    QList<QContactDetail::DetailType> types;
+    types << QContactDetail::TypeGuid
+          << QContactDetail::TypeTimestamp
+          << QContactDetail::TypeName
+          << QContactDetail::TypePhoneNumber
+          << QContactDetail::TypeEmailAddress
+          << QContactDetail::TypeAddress
+          << QContactDetail::TypeUrl
+          << QContactDetail::TypeBirthday
+          << QContactDetail::TypeNote
+          << QContactDetail::TypeHobby
+          << QContactDetail::TypeOrganization
+          << QContactDetail::TypeAvatar
+          << QContactDetail::TypeAnniversary
+          << QContactDetail::TypeNickname
+          << QContactDetail::TypeGender
+          << QContactDetail::TypeOnlineAccount
+          << QContactDetail::TypeFamily
+          << QContactDetail::TypeFavorite
+          << QContactDetail::TypeExtendedDetail
+          << QContactDetail::TypeRingtone;
+
+    QContactFetchHint hint;
+    hint.setDetailTypesHint(types);
+    hint.setOptimizationHints(QContactFetchHint::NoRelationships |
+                              QContactFetchHint::NoActionPreferences |
+                              QContactFetchHint::NoBinaryBlobs);
+    return hint;
+}
+
+QString GoogleContactStream::encodeDetail(const QContactDetail &detail)
+{
+    // avatars are uploaded by GContactImageUploader, not as part of the entry
+    if (detail.type() == QContactDetail::TypeAvatar) {
+        return QContactAvatar(detail).imageUrl().toString();
+    }
+
+    QByteArray xml;
+    QXmlStreamWriter writer(&xml);
+    GoogleContactStream stream(false);
+    stream.mXmlWriter = &writer;
+    stream.encodeContactDetail(detail, QContact(), 0);
+    return QString::fromUtf8(xml);
+}
+
 void GoogleContactStream::encodeContactUpdate(const QContact &qContact,
                                               const QStringList &unsupportedElements,
                                               const GoogleContactStream::UpdateType updateType,
@@ -907,65 +1229,7 @@ void GoogleContactStream::encodeContactUpdate(const QContact &qContact,
     bool hasGroup = false;
 
     Q_FOREACH (const QContactDetail &detail, allDetails) {
-        switch(detail.type()) {
-            case QContactDetail::TypeName: {
-                encodeName(detail);
-            }   break;
-            case QContactDetail::TypePhoneNumber: {
-                encodePhoneNumber(detail);
-            }   break;
-            case QContactDetail::TypeEmailAddress: {
-                encodeEmailAddress(detail);
-            }   break;
-            case QContactDetail::TypeAddress: {
-                encodeAddress(detail);
-            }   break;
-            case QContactDetail::TypeUrl: {
-                encodeUrl(detail);
-            }   break;
-            case QContactDetail::TypeBirthday: {
-                encodeBirthday(detail);
-            }   break;
-            case QContactDetail::TypeNote: {
-                encodeNote(detail);
-            }   break;
-            case QContactDetail::TypeHobby: {
-                encodeHobby(detail);
-            }   break;
-            case QContactDetail::TypeOrganization: {
-                encodeOrganization(detail);
-            }   break;
-            case QContactDetail::TypeAvatar: {
-                encodeAvatar(detail, qContact);
-            }   break;
-            case QContactDetail::TypeAnniversary: {
-                encodeAnniversary(detail);
-            }   break;
-            case QContactDetail::TypeNickname: {
-                encodeNickname(detail);
-            }   break;
-            case QContactDetail::TypeGender: {
-                encodeGender(detail);
-            }   break;
-            case QContactDetail::TypeOnlineAccount: {
-                encodeOnlineAccount(detail);
-            }   break;
-            case QContactDetail::TypeFamily: {
-                encodeFamily(detail);
-            }   break;
-            case QContactDetail::TypeFavorite: {
-                encodeFavorite(detail);
-            }   break;
-            case QContactDetail::TypeExtendedDetail: {
-                encodeExtendedProperty(detail, &hasGroup);
-            }   break;
-            case QContactDetail::TypeRingtone: {
-                encodeRingTone(detail);
-            }   break;
-            // TODO: handle the custom detail fields.
-            default: {
-            }   break;
-        }
+        encodeContactDetail(detail, qContact, &hasGroup);
     }
     if (!hasGroup) {
         // Make sure that the contact has at least one group
@@ -978,6 +1242,71 @@ void GoogleContactStream::encodeContactUpdate(const QContact &qContact,
     mXmlWriter->writeEndElement();
 }
 
+void GoogleContactStream::encodeContactDetail(const QContactDetail &detail,
+                                              const QContact &qContact,
+                                              bool *hasGroup)
+{
+    switch(detail.type()) {
+        case QContactDetail::TypeName: {
+            encodeName(detail);
+        }   break;
+        case QContactDetail::TypePhoneNumber: {
+            encodePhoneNumber(detail);
+        }   break;
+        case QContactDetail::TypeEmailAddress: {
+            encodeEmailAddress(detail);
+        }   break;
+        case QContactDetail::TypeAddress: {
+            encodeAddress(detail);
+        }   break;
+        case QContactDetail::TypeUrl: {
+            encodeUrl(detail);
+        }   break;
+        case QContactDetail::TypeBirthday: {
+            encodeBirthday(detail);
+        }   break;
+        case QContactDetail::TypeNote: {
+            encodeNote(detail);
+        }   break;
+        case QContactDetail::TypeHobby: {
+            encodeHobby(detail);
+        }   break;
+        case QContactDetail::TypeOrganization: {
+            encodeOrganization(detail);
+        }   break;
+        case QContactDetail::TypeAvatar: {
+            encodeAvatar(detail, qContact);
+        }   break;
+        case QContactDetail::TypeAnniversary: {
+            encodeAnniversary(detail);
+        }   break;
+        case QContactDetail::TypeNickname: {
+            encodeNickname(detail);
+        }   break;
+        case QContactDetail::TypeGender: {
+            encodeGender(detail);
+        }   break;
+        case QContactDetail::TypeOnlineAccount: {
+            encodeOnlineAccount(detail);
+        }   break;
+        case QContactDetail::TypeFamily: {
+            encodeFamily(detail);
+        }   break;
+        case QContactDetail::TypeFavorite: {
+            encodeFavorite(detail);
+        }   break;
+        case QContactDetail::TypeExtendedDetail: {
+            encodeExtendedProperty(detail, hasGroup);
+        }   break;
+        case QContactDetail::TypeRingtone: {
+            encodeRingTone(detail);
+        }   break;
+        // TODO: handle the custom detail fields.
+        default: {
+        }   break;
+    }
+}
+
 void GoogleContactStream::startBatchFeed()
 {
     mXmlWriter->writeStartElement("atom:feed");
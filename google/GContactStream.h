@@ -31,6 +31,7 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
 
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
@@ -60,6 +61,7 @@
 #include <QContactFavorite>
 #include <QContactExtendedDetail>
 #include <QContactRingtone>
+#include <QContactFetchHint>
 
 QTCONTACTS_USE_NAMESPACE
 
@@ -81,14 +83,65 @@ public:
     QByteArray encode(const QMultiMap<GoogleContactStream::UpdateType, QPair<QContact, QStringList> > &updates);
     GoogleContactAtom* parse(const QByteArray &xmlBuffer);
 
+    // incremental parsing: each entry is parsed as soon as its end tag arrives,
+    // only the data not parsed yet is kept in memory
+    void addData(const QByteArray &data);
+    GoogleContactAtom* finishParse();
+
+    // entries with one of these remote id and etag pairs are not decoded
+    void setKnownETags(const QHash<QString, QString> &etags);
+
+    // restricts a local fetch to the details used by encode()
+    static QContactFetchHint contactUpdateFetchHint();
+
+    // the values of a detail written by encode(), empty if none are written
+    static QString encodeDetail(const QContactDetail &detail);
+
 signals:
     void parseDone(bool);
 
 // Decoding XML stream to QContacts
 private:
-    void initAtomFunctionMap();
-    void initResponseFunctionMap();
-    void initFunctionMap();
+    // elements handled by the parser, resolved without allocating the element name
+    enum Element {
+        ElementUnknown = 0,
+        ElementAuthor,
+        ElementCategory,
+        ElementEntry,
+        ElementGenerator,
+        ElementId,
+        ElementItemsPerPage,
+        ElementLink,
+        ElementStartIndex,
+        ElementTitle,
+        ElementTotalResults,
+        ElementUpdated,
+        ElementBatchId,
+        ElementBatchOperation,
+        ElementBatchStatus,
+        ElementBirthday,
+        ElementEvent,
+        ElementGender,
+        ElementGroupMembershipInfo,
+        ElementHobby,
+        ElementJot,
+        ElementNickname,
+        ElementOccupation,
+        ElementRelation,
+        ElementSystemGroup,
+        ElementWebsite,
+        ElementDeleted,
+        ElementEmail,
+        ElementExtendedProperty,
+        ElementIm,
+        ElementName,
+        ElementOrganization,
+        ElementPhoneNumber,
+        ElementStructuredPostalAddress
+    };
+
+    void parseElements();
+    int scanCompleteElements();
 
     // Atom feed elements handler methods
     void handleAtomUpdated();
@@ -132,6 +185,7 @@ private:
     // unknown / unsupported element handler methods
     QString handleEntryLink(QContactAvatar *avatar, bool *isAvatar, QString *etag);
     QString handleEntryUnknownElement();
+    void skipEntry();
 
     // generic context parse
     QList<int> handleContext(const QString &rel) const;
@@ -139,11 +193,23 @@ private:
     typedef void (GoogleContactStream::*Handler)();
     typedef QContactDetail (GoogleContactStream::*DetailHandler)();
 
-    QMap<QString, GoogleContactStream::Handler> mAtomFunctionMap;
-    QMap<QString, GoogleContactStream::DetailHandler> mContactFunctionMap;
+    static Element atomElement(const QStringRef &name);
+    static Element entryElement(const QStringRef &qualifiedName);
+    static Handler atomHandler(Element element);
+    static DetailHandler detailHandler(Element element);
+
+    bool mParseDetails;
+    QHash<QString, QString> mKnownETags;
     QXmlStreamReader *mXmlReader;
     GoogleContactAtom *mAtom;
 
+    // incremental parsing: received data is kept on mPendingData until a
+    // byte scan of its markup finds the end of a feed child element, only
+    // complete elements are given to mXmlReader
+    QByteArray mPendingData;
+    int mScanOffset;
+    int mScanDepth;
+
 // Encoding QContacts to XML stream
 private:
     void encodeContactUpdate(const QContact &qContact,
@@ -152,6 +218,9 @@ private:
                              const bool batch);
     void startBatchFeed();
     void endBatchFeed();
+    void encodeContactDetail(const QContactDetail &detail,
+                             const QContact &qContact,
+                             bool *hasGroup);
     void encodeBatchTag(const UpdateType updateType, const QString &batchElementId);
     void encodeId(const QContact &qContact, bool isUpdate = false);
     void encodeUpdatedTimestamp(const QContact &qContact);
@@ -29,6 +29,7 @@
 #include "GConfig.h"
 #include "GContactStream.h"
 #include "GContactImageDownloader.h"
+#include "GContactAvatarCache.h"
 #include "GContactImageUploader.h"
 #include "buteosyncfw_p.h"
 
@@ -41,6 +42,8 @@
 #include <QtContacts/QContact>
 #include <QtContacts/QContactGuid>
 #include <QtContacts/QContact>
+#include <QStandardPaths>
+#include <QUrlQuery>
 
 QTCONTACTS_USE_NAMESPACE
 
@@ -48,8 +51,24 @@ GRemoteSource::GRemoteSource(QObject *parent)
     : UAbstractRemoteSource(parent),
       mTransport(new GTransport),
       mState(GRemoteSource::STATE_IDLE),
-      mStartIndex(0),
-      mFetchAvatars(true)
+      mFetchAvatars(true),
+      mFetchIncludeDeleted(false),
+      mFetchManifest(false),
+      mFetchingById(false),
+      mFetchByIdTotal(0),
+      mFetchPlanned(false),
+      mFetchTotalResults(0),
+      mLastFetchIndex(0),
+      mBatchSizer(GConfig::MAX_RESULTS,
+                  GConfig::BATCH_MIN_RESULTS,
+                  GConfig::BATCH_MAX_RESULTS,
+                  GConfig::BATCH_MAX_BYTES,
+                  GConfig::BATCH_FAST_REPLY),
+      mBatchRetries(0),
+      mRetryingBatchPage(false),
+      mFailedBatchPage(false),
+      mBatchStatus(Sync::SYNC_DONE),
+      mProbeStatus(Sync::SYNC_DONE)
 {
     connect(mTransport.data(),
             SIGNAL(finishedRequest()),
@@ -58,10 +77,19 @@ GRemoteSource::GRemoteSource(QObject *parent)
     connect(mTransport.data(),
             SIGNAL(error(int)),
             SLOT(networkError(int)));
+
+    connect(mTransport.data(),
+            SIGNAL(transportError(int)),
+            SLOT(networkTransportError(int)));
+
+    connect(mTransport.data(),
+            SIGNAL(dataReceived(QByteArray)),
+            SLOT(fetchDataReceived(QByteArray)));
 }
 
 GRemoteSource::~GRemoteSource()
 {
+    qDeleteAll(mFetchParsers);
 }
 
 bool GRemoteSource::init(const QVariantMap &properties)
@@ -78,8 +106,13 @@ bool GRemoteSource::init(const QVariantMap &properties)
     mAuthToken = properties.value("AUTH-TOKEN").toString();
     mSyncTarget = properties.value("SYNC-TARGET").toString();
     mRemoteUri = properties.value(Buteo::KEY_REMOTE_DATABASE).toString();
-    mStartIndex = 1;
+    resetFetchState();
     mPendingBatchOps.clear();
+    mCurrentBatchPage.clear();
+    mBatchRetries = 0;
+    mRetryingBatchPage = false;
+    mFailedBatchPage = false;
+    mBatchStatus = Sync::SYNC_DONE;
     mState = GRemoteSource::STATE_IDLE;
 
     if (mRemoteUri.isEmpty()) {
@@ -87,14 +120,41 @@ bool GRemoteSource::init(const QVariantMap &properties)
         mRemoteUri = QStringLiteral("https://www.google.com/m8/feeds/contacts/default/full/");
     }
 
+    QString avatarCacheDir = properties.value("AVATAR-CACHE-DIR").toString();
+    if (avatarCacheDir.isEmpty()) {
+        avatarCacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+                         QStringLiteral("/buteo-sync-plugins-contacts/avatars");
+    }
+    mAvatarCache.reset(new GContactAvatarCache(avatarCacheDir, GConfig::AVATAR_CACHE_MAX_SIZE));
+    mAvatarCache->evict();
+
     LOG_DEBUG("Setting remote URI to" << mRemoteUri);
     mTransport->setUrl(mRemoteUri);
+    mTransport->setTimeout(GConfig::REQUEST_TIMEOUT);
+
+    // extra connections used to fetch the feed pages in parallel
+    qDeleteAll(mFetchTransports);
+    mFetchTransports.clear();
+    int maxFetches = properties.value("MAX-PARALLEL-FETCHES", GConfig::MAX_PARALLEL_FETCHES).toInt();
+    for (int i = 1; i < maxFetches; i++) {
+        GTransport *transport = new GTransport(this);
+        transport->setTimeout(GConfig::REQUEST_TIMEOUT);
+        connect(transport, SIGNAL(finishedRequest()), SLOT(networkRequestFinished()));
+        connect(transport, SIGNAL(error(int)), SLOT(networkError(int)));
+        connect(transport, SIGNAL(transportError(int)), SLOT(networkTransportError(int)));
+        connect(transport, SIGNAL(dataReceived(QByteArray)), SLOT(fetchDataReceived(QByteArray)));
+        mFetchTransports << transport;
+    }
+    LOG_DEBUG("Max parallel page fetches:" << (mFetchTransports.size() + 1));
 
     QString proxyHost = properties.value(Buteo::KEY_HTTP_PROXY_HOST).toString();
     // Set proxy, if available
     if (!proxyHost.isEmpty()) {
         QString proxyPort = properties.value(Buteo::KEY_HTTP_PROXY_PORT).toString();
         mTransport->setProxy(proxyHost, proxyPort);
+        foreach (GTransport *transport, mFetchTransports) {
+            transport->setProxy(proxyHost, proxyPort);
+        }
         LOG_DEBUG("Proxy host:" << proxyHost);
         LOG_DEBUG("Proxy port:" << proxyPort);
     } else {
@@ -107,7 +167,20 @@ bool GRemoteSource::init(const QVariantMap &properties)
 void GRemoteSource::abort()
 {
     disconnect(mTransport.data());
+    foreach (GTransport *transport, mFetchTransports) {
+        disconnect(transport);
+    }
     mState = STATE_ABORTED;
+    cancelAvatarDownloads();
+
+    while (!mPendingCommits.isEmpty()) {
+        GContactImageUploader *uploader = mPendingCommits.dequeue().uploader;
+        if (uploader) {
+            uploader->disconnect(this);
+            uploader->abort();
+            uploader->deleteLater();
+        }
+    }
 }
 
 void GRemoteSource::fetchContacts(const QDateTime &since, bool includeDeleted, bool fetchAvatar)
@@ -119,45 +192,360 @@ void GRemoteSource::fetchContacts(const QDateTime &since, bool includeDeleted, b
     }
 
     mFetchAvatars = fetchAvatar;
+    startFetch(since, includeDeleted, false);
+}
+
+bool GRemoteSource::fetchManifest()
+{
+    FUNCTION_CALL_TRACE;
+    if (mState != GRemoteSource::STATE_IDLE) {
+        LOG_WARNING("GRemote source is not in idle state, current state is" << mState);
+        return false;
+    }
+
+    // only the id and the etag of each entry are requested, this allows
+    // much bigger pages than a full fetch
+    mFetchAvatars = false;
+    startFetch(QDateTime(), false, true);
+    return true;
+}
+
+void GRemoteSource::fetchContactsById(const QStringList &remoteIds)
+{
+    FUNCTION_CALL_TRACE;
+    if (mState != GRemoteSource::STATE_IDLE) {
+        LOG_WARNING("GRemote source is not in idle state, current state is" << mState);
+        emit contactsFetched(QList<QContact>(), Sync::SYNC_ERROR, -1.0);
+        return;
+    }
+
+    mState = GRemoteSource::STATE_FETCHING_CONTACTS;
+    resetFetchState();
+    mFetchAvatars = true;
+    mFetchingById = true;
+    mFetchByIdQueue = remoteIds;
+    mFetchByIdTotal = remoteIds.size();
+
+    // keep the same behaviour of fetchContacts() where the result is
+    // never notified before this function returns
+    QMetaObject::invokeMethod(this, "fetchNextContactsById", Qt::QueuedConnection);
+}
+
+void GRemoteSource::fetchNextContactsById()
+{
+    FUNCTION_CALL_TRACE;
+    if ((mState != GRemoteSource::STATE_FETCHING_CONTACTS) || !mFetchingById) {
+        return;
+    }
+
+    if (mFetchByIdQueue.isEmpty()) {
+        mFetchingById = false;
+        mState = GRemoteSource::STATE_IDLE;
+        emit contactsFetched(QList<QContact>(), Sync::SYNC_DONE, 1.0);
+        return;
+    }
+
+    // the entries are requested by a batch query, in pages of the
+    // biggest size accepted by the server
+    QByteArray body("<feed xmlns=\"http://www.w3.org/2005/Atom\" "
+                    "xmlns:batch=\"http://schemas.google.com/gdata/batch\">");
+    for (int i = 0; (i < GConfig::BATCH_MAX_RESULTS) && !mFetchByIdQueue.isEmpty(); i++) {
+        QString remoteId = mFetchByIdQueue.takeFirst();
+        body += QString("<entry>"
+                            "<batch:id>%1</batch:id>"
+                            "<batch:operation type=\"query\"/>"
+                            "<id>%2%1</id>"
+                        "</entry>").arg(remoteId).arg(mRemoteUri).toUtf8();
+    }
+    body += "</feed>";
+
+    LOG_INFO("Fetching" << (mFetchByIdTotal - mFetchByIdQueue.size()) << "of"
+             << mFetchByIdTotal << "contacts by id");
+
+    mTransport->reset();
+    mTransport->setUrl(mRemoteUri + "batch");
+    mTransport->setGDataVersionHeader();
+    mTransport->setAuthToken(mAuthToken);
+    mTransport->setData(body);
+    mTransport->addHeader("Content-Type", "application/atom+xml; charset=UTF-8; type=feed");
+    LOG_TRACE("POST DATA:" << body);
+    mTransport->request(GTransport::POST);
+}
+
+bool GRemoteSource::probeChanges(const QDateTime &since)
+{
+    FUNCTION_CALL_TRACE;
+    if (mState != GRemoteSource::STATE_IDLE) {
+        LOG_WARNING("GRemote source is not in idle state, current state is" << mState);
+        return false;
+    }
+
+    if (!since.isValid()) {
+        return false;
+    }
+
+    // only the number of entries updated or removed since the last sync
+    // is requested, the reply does not contain any entry
+    mState = GRemoteSource::STATE_PROBING;
+    mProbeStatus = Sync::SYNC_DONE;
+    resetFetchState();
+    mTransport->reset();
+    mTransport->setUrl(mRemoteUri);
+    mTransport->setUpdatedMin(since);
+    mTransport->setMaxResults(GConfig::PROBE_MAX_RESULTS);
+    mTransport->setShowDeleted();
+    mTransport->setFields(GConfig::PROBE_FIELDS);
+    mTransport->setGroupFilter(mAccountName, GConfig::GROUP_MY_CONTACTS_ID);
+    mTransport->setGDataVersionHeader();
+    mTransport->addHeader(QByteArray("Authorization"),
+                          QString("Bearer " + mAuthToken).toUtf8());
+    mTransport->request(GTransport::GET);
+    return true;
+}
+
+QContactFetchHint GRemoteSource::uploadFetchHint() const
+{
+    return GoogleContactStream::contactUpdateFetchHint();
+}
+
+UContactsConflictResolver::DetailEncoder GRemoteSource::uploadDetailEncoder() const
+{
+    return &GoogleContactStream::encodeDetail;
+}
+
+void GRemoteSource::startFetch(const QDateTime &since, bool includeDeleted, bool manifest)
+{
     mState = GRemoteSource::STATE_FETCHING_CONTACTS;
-    fetchRemoteContacts(since, includeDeleted, 1);
+
+    // the first page tells how many pages are left, they are fetched
+    // in parallel after it arrives
+    resetFetchState();
+    mFetchIncludeDeleted = includeDeleted;
+    mFetchManifest = manifest;
+    mFetchOrder << 1;
+    mLastFetchIndex = 1;
+    mRunningFetches.insert(mTransport.data(), 1);
+    mTransport->reset();
+    mTransport->setUrl(mRemoteUri);
+    fetchRemoteContacts(mTransport.data(), since, includeDeleted, 1);
+}
+
+int GRemoteSource::fetchPageSize() const
+{
+    return mFetchManifest ? GConfig::MANIFEST_MAX_RESULTS : GConfig::MAX_RESULTS;
+}
+
+void GRemoteSource::resetFetchState()
+{
+    mFetchManifest = false;
+    mFetchingById = false;
+    mFetchByIdTotal = 0;
+    mFetchByIdQueue.clear();
+    mFetchPlanned = false;
+    mFetchTotalResults = 0;
+    mLastFetchIndex = 0;
+    mFetchUrl.clear();
+    mFetchOrder.clear();
+    mPendingFetches.clear();
+
+    // replies of the cancelled pages must not be credited to the next fetch
+    foreach (GTransport *transport, mRunningFetches.keys()) {
+        transport->abort();
+    }
+    mRunningFetches.clear();
+    mFetchedPages.clear();
+    cancelAvatarDownloads();
+    qDeleteAll(mFetchParsers);
+    mFetchParsers.clear();
+}
+
+void GRemoteSource::planFetches(const GoogleContactAtom *atom, int startIndex)
+{
+    mFetchUrl = atom->nextEntriesUrl();
+    if (atom->totalResults() > 0) {
+        mFetchTotalResults = atom->totalResults();
+    }
+
+    int nextIndex = QUrlQuery(QUrl(mFetchUrl)).queryItemValue(GConfig::START_INDEX_TAG).toInt();
+    if (nextIndex <= startIndex) {
+        nextIndex = startIndex + fetchPageSize();
+    }
+
+    // the next link of the last known page extends the feed
+    if (nextIndex > mLastFetchIndex) {
+        appendFetch(nextIndex);
+    }
+
+    // the page size is known after the first page, plan the remaining ones
+    if (!mFetchPlanned && !mFetchTransports.isEmpty() && (mFetchTotalResults > 0)) {
+        mFetchPlanned = true;
+        int pageSize = nextIndex - startIndex;
+        for (int index = nextIndex + pageSize; index <= mFetchTotalResults; index += pageSize) {
+            appendFetch(index);
+        }
+        LOG_DEBUG("Planned" << mFetchOrder.size() << "pages of" << pageSize << "contacts");
+    }
+}
+
+void GRemoteSource::appendFetch(int startIndex)
+{
+    mFetchOrder << startIndex;
+    mPendingFetches.enqueue(startIndex);
+    mLastFetchIndex = startIndex;
+}
+
+GTransport *GRemoteSource::idleFetchTransport() const
+{
+    if (!mRunningFetches.contains(mTransport.data())) {
+        return mTransport.data();
+    }
+
+    foreach (GTransport *transport, mFetchTransports) {
+        if (!mRunningFetches.contains(transport)) {
+            return transport;
+        }
+    }
+    return 0;
+}
+
+void GRemoteSource::scheduleFetches()
+{
+    // the transport is marked as busy before the request because the
+    // reply can be delivered before request() returns
+    while ((mState == GRemoteSource::STATE_FETCHING_CONTACTS) && !mPendingFetches.isEmpty()) {
+        GTransport *transport = idleFetchTransport();
+        if (!transport) {
+            break;
+        }
+
+        int startIndex = mPendingFetches.dequeue();
+        mRunningFetches.insert(transport, startIndex);
+        LOG_TRACE("FETCH MORE CONTACTS FROM INDEX:" << startIndex);
+        transport->reset();
+        transport->setUrl(mFetchUrl);
+        fetchRemoteContacts(transport, QDateTime(), mFetchIncludeDeleted, startIndex);
+    }
+}
+
+void GRemoteSource::emitFetchedPages()
+{
+    // pages can arrive in any order, notify them in the feed order
+    while ((mState == GRemoteSource::STATE_FETCHING_CONTACTS) &&
+           !mFetchOrder.isEmpty() &&
+           mFetchedPages.contains(mFetchOrder.first())) {
+        int startIndex = mFetchOrder.takeFirst();
+        QList<QContact> remoteContacts = mFetchedPages.take(startIndex);
+
+        Sync::SyncStatus syncStatus;
+        qreal progress = -1.0;
+        if (mFetchOrder.isEmpty()) {
+            LOG_DEBUG("NO contacts to retrieve");
+            syncStatus = Sync::SYNC_DONE;
+            progress = 1.0;
+            mState = GRemoteSource::STATE_IDLE;
+        } else {
+            LOG_DEBUG("Has more contacts to retrieve");
+            syncStatus = Sync::SYNC_PROGRESS;
+            if (mFetchTotalResults > 0) {
+                progress = qMin(mFetchOrder.first() / (qreal) mFetchTotalResults, 1.0);
+            }
+        }
+
+        LOG_TRACE("NOTIFY CONTACTS FETCHED:" << remoteContacts.size() << "Progress" << progress);
+        emit contactsFetched(remoteContacts, syncStatus, progress);
+    }
+}
+
+void GRemoteSource::emitContactsFetchedById(const QList<QContact> &contacts)
+{
+    Sync::SyncStatus syncStatus = Sync::SYNC_DONE;
+    qreal progress = 1.0;
+    if (mFetchByIdQueue.isEmpty()) {
+        mFetchingById = false;
+        mState = GRemoteSource::STATE_IDLE;
+    } else {
+        syncStatus = Sync::SYNC_PROGRESS;
+        progress = (mFetchByIdTotal - mFetchByIdQueue.size()) / (qreal) mFetchByIdTotal;
+    }
+
+    emit contactsFetched(contacts, syncStatus, progress);
+    if (syncStatus == Sync::SYNC_PROGRESS) {
+        fetchNextContactsById();
+    }
 }
 
-void GRemoteSource::fetchAvatars(QList<QContact> *contacts)
+void GRemoteSource::downloadAvatars(int startIndex, const QList<QContact> &contacts)
 {
     // keep downloader object live while GRemoteSource exists to avoid removing
     // the temporary files used to store avatars.
     // The files will be removed when the object get destroyed
     GContactImageDownloader *downloader = new GContactImageDownloader(mAuthToken, this);
-    QMap<QUrl, QPair<QContactAvatar, QContact*> > avatars;
+    downloader->setCache(mAvatarCache.data());
 
-    for(int i=0; i < contacts->size(); i++) {
-        QContact &c = (*contacts)[i];
+    foreach (const QContact &c, contacts) {
+        // avatars with the same etag are loaded from the cache
+        QString avatarEtag =
+                UContactsCustomDetail::getCustomField(c,
+                                                      UContactsCustomDetail::FieldContactAvatarETag).data().toString();
         foreach (const QContactAvatar &avatar, c.details<QContactAvatar>()) {
             if (!avatar.imageUrl().isLocalFile()) {
                 LOG_DEBUG("Download avatar:" << avatar.imageUrl());
-                avatars.insert(avatar.imageUrl(), qMakePair(avatar, &c));
-                downloader->push(avatar.imageUrl());
+                downloader->push(avatar.imageUrl(), avatarEtag);
             }
         }
     }
 
-    downloader->exec();
+    // the page is notified when its avatars are downloaded, the reply
+    // handler returns and other pages keep being fetched meanwhile
+    mAvatarDownloads.insert(downloader, qMakePair(startIndex, contacts));
+    connect(downloader, SIGNAL(finished()), SLOT(avatarsDownloaded()));
+    downloader->start();
+}
+
+void GRemoteSource::avatarsDownloaded()
+{
+    GContactImageDownloader *downloader = qobject_cast<GContactImageDownloader*>(sender());
+    if (!mAvatarDownloads.contains(downloader)) {
+        return;
+    }
 
+    QPair<int, QList<QContact> > page = mAvatarDownloads.take(downloader);
     QMap<QUrl, QUrl> downloaded = downloader->donwloaded();
-    foreach (const QUrl &avatarUrl, avatars.keys()) {
-        QPair<QContactAvatar, QContact*> &p = avatars[avatarUrl];
-        LOG_DEBUG("Replace avatar image:" <<  p.first.imageUrl() << downloaded.value(avatarUrl));
-        p.first.setImageUrl(downloaded.value(avatarUrl));
-        p.second->saveDetail(&p.first);
+    for (int i = 0; i < page.second.size(); i++) {
+        QContact &c = page.second[i];
+        foreach (QContactAvatar avatar, c.details<QContactAvatar>()) {
+            if (!avatar.imageUrl().isLocalFile()) {
+                LOG_DEBUG("Replace avatar image:" << avatar.imageUrl() << downloaded.value(avatar.imageUrl()));
+                avatar.setImageUrl(downloaded.value(avatar.imageUrl()));
+                c.saveDetail(&avatar);
+            }
+        }
+    }
+
+    // pages fetched by id have no start index
+    if (page.first == 0) {
+        emitContactsFetchedById(page.second);
+    } else {
+        mFetchedPages.insert(page.first, page.second);
+        emitFetchedPages();
+    }
+}
+
+void GRemoteSource::cancelAvatarDownloads()
+{
+    // the downloaders are kept until GRemoteSource is destroyed
+    foreach (GContactImageDownloader *downloader, mAvatarDownloads.keys()) {
+        downloader->disconnect(this);
+        downloader->abort();
     }
+    mAvatarDownloads.clear();
 }
 
-void GRemoteSource::uploadAvatars(QList<QContact> *contacts)
+GContactImageUploader *GRemoteSource::uploadAvatars(const QList<QContact> &contacts)
 {
-    GContactImageUploader uploader(mAuthToken, mAccountName);
+    GContactImageUploader *uploader = 0;
 
-    foreach(const QContact &c, *contacts) {
+    foreach(const QContact &c, contacts) {
         QString localId = UContactsBackend::getLocalId(c);
         LOG_DEBUG("Will upload avatar for:" << localId);
         if (mLocalIdToAvatar.contains(localId)) {
@@ -179,7 +567,10 @@ void GRemoteSource::uploadAvatars(QList<QContact> *contacts)
                           << "\n\tRemote version:" << rEtag.data().toString()
                           << "\n\tLocal version:" << avatar.first);
                 LOG_DEBUG("Uploade avatar:" << remoteId << avatar.second);
-                uploader.push(remoteId, avatar.second);
+                if (!uploader) {
+                    uploader = new GContactImageUploader(mAuthToken, mAccountName, this);
+                }
+                uploader->push(remoteId, avatar.second);
             } else if (!avatar.second.isLocalFile()) {
                 LOG_DEBUG("Contact avatar is not local" << avatar.second);
             } else {
@@ -190,9 +581,20 @@ void GRemoteSource::uploadAvatars(QList<QContact> *contacts)
         }
     }
 
-    uploader.exec();
+    if (uploader) {
+        connect(uploader, SIGNAL(finished()), SLOT(flushTransactionCommits()));
+        uploader->start();
+    }
+    return uploader;
+}
+
+void GRemoteSource::applyAvatarUploads(QList<QContact> *contacts, GContactImageUploader *uploader)
+{
+    QMap<QString, GContactImageUploader::UploaderReply> result;
+    if (uploader) {
+        result = uploader->result();
+    }
 
-    QMap<QString, GContactImageUploader::UploaderReply> result = uploader.result();
     for(int i =0; i < contacts->size(); i++) {
         QContact &c = (*contacts)[i];
 
@@ -220,6 +622,55 @@ void GRemoteSource::uploadAvatars(QList<QContact> *contacts)
     }
 }
 
+void GRemoteSource::queueTransactionCommited(const QList<QContact> &created,
+                                             const QList<QContact> &changed,
+                                             const QList<QContact> &removed,
+                                             const QMap<QString, int> &errorMap,
+                                             Sync::SyncStatus status,
+                                             GContactImageUploader *uploader)
+{
+    PendingCommit commit;
+    commit.created = created;
+    commit.changed = changed;
+    commit.removed = removed;
+    commit.errorMap = errorMap;
+    commit.status = status;
+    commit.uploader = uploader;
+    mPendingCommits.enqueue(commit);
+
+    flushTransactionCommits();
+}
+
+void GRemoteSource::flushTransactionCommits()
+{
+    // commits are notified in the same order as the batch pages, a page
+    // waits for its avatar uploads to finish
+    while (!mPendingCommits.isEmpty()) {
+        GContactImageUploader *uploader = mPendingCommits.head().uploader;
+        if (uploader && !uploader->isFinished()) {
+            break;
+        }
+
+        PendingCommit commit = mPendingCommits.dequeue();
+        applyAvatarUploads(&commit.created, uploader);
+        applyAvatarUploads(&commit.changed, uploader);
+        if (uploader) {
+            uploader->deleteLater();
+        }
+
+        if (commit.status != Sync::SYNC_PROGRESS) {
+            mState = GRemoteSource::STATE_IDLE;
+            mLocalIdToAvatar.clear();
+        }
+
+        emitTransactionCommited(commit.created,
+                                commit.changed,
+                                commit.removed,
+                                commit.errorMap,
+                                commit.status);
+    }
+}
+
 void GRemoteSource::saveContactsNonBatch(const QList<QContact> contacts)
 {
     FUNCTION_CALL_TRACE;
@@ -232,11 +683,9 @@ void GRemoteSource::saveContactsNonBatch(const QList<QContact> contacts)
     foreach (const QContact &contact, contacts) {
         QString remoteId = UContactsBackend::getRemoteId(contact);
         if (remoteId.isEmpty()) {
-            mPendingBatchOps.insertMulti(GoogleContactStream::Add,
-                                         qMakePair(contact, QStringList()));
+            mPendingBatchOps.enqueue(GoogleContactStream::Add, contact);
         } else {
-            mPendingBatchOps.insertMulti(GoogleContactStream::Modify,
-                                         qMakePair(contact, QStringList()));
+            mPendingBatchOps.enqueue(GoogleContactStream::Modify, contact);
         }
     }
 
@@ -253,8 +702,7 @@ void GRemoteSource::removeContactsNonBatch(const QList<QContact> contacts)
 
     mState = GRemoteSource::STATE_BATCH_RUNNING;
     foreach (const QContact &contact, contacts) {
-        mPendingBatchOps.insertMulti(GoogleContactStream::Remove,
-                                     qMakePair(contact, QStringList()));
+        mPendingBatchOps.enqueue(GoogleContactStream::Remove, contact);
     }
 
     batchOperationContinue();
@@ -286,8 +734,7 @@ void GRemoteSource::batch(const QList<QContact> &contactsToCreate,
 
         mLocalIdToAvatar.insert(QString("qtcontacts:galera::%1").arg(localID),
                                 qMakePair(avatarEtag, contact.detail<QContactAvatar>().imageUrl()));
-        mPendingBatchOps.insertMulti(GoogleContactStream::Add,
-                                     qMakePair(contact, QStringList()));
+        mPendingBatchOps.enqueue(GoogleContactStream::Add, contact);
     }
 
     foreach (const QContact &contact, contactsToUpdate) {
@@ -298,13 +745,11 @@ void GRemoteSource::batch(const QList<QContact> &contactsToCreate,
 
         mLocalIdToAvatar.insert(QString("qtcontacts:galera::%1").arg(localID),
                                 qMakePair(avatarEtag, contact.detail<QContactAvatar>().imageUrl()));
-        mPendingBatchOps.insertMulti(GoogleContactStream::Modify,
-                                     qMakePair(contact, QStringList()));
+        mPendingBatchOps.enqueue(GoogleContactStream::Modify, contact);
     }
 
     foreach (const QContact &contact, contactsToRemove) {
-        mPendingBatchOps.insertMulti(GoogleContactStream::Remove,
-                                     qMakePair(contact, QStringList()));
+        mPendingBatchOps.enqueue(GoogleContactStream::Remove, contact);
     }
 
     batchOperationContinue();
@@ -320,38 +765,32 @@ GRemoteSource::batchOperationContinue()
         return;
     }
 
-    int limit = qMin(mPendingBatchOps.size(), GConfig::MAX_RESULTS);
-    // no pending batch ops
-    if (limit < 1)  {
+    // no pending batch ops, the batch fails if one of its pages failed
+    if (mPendingBatchOps.isEmpty())  {
         LOG_DEBUG ("No pending operations");
-        emit transactionCommited(QList<QContact>(),
+        Sync::SyncStatus syncStatus = mBatchStatus;
+        mBatchStatus = Sync::SYNC_DONE;
+        queueTransactionCommited(QList<QContact>(),
+                                 QList<QContact>(),
                                  QList<QContact>(),
-                                 QStringList(),
                                  QMap<QString, int>(),
-                                 Sync::SYNC_DONE);
+                                 syncStatus,
+                                 0);
         return;
     }
-    QMultiMap<GoogleContactStream::UpdateType, QPair<QContact, QStringList> > batchPage;
-    QPair<QContact, QStringList> value;
-
-    while (batchPage.size() < limit) {
-        GoogleContactStream::UpdateType type;
-
-        if (!mPendingBatchOps.values(GoogleContactStream::Add).isEmpty()) {
-            type = GoogleContactStream::Add;
-        } else if (!mPendingBatchOps.values(GoogleContactStream::Modify).isEmpty()) {
-            type = GoogleContactStream::Modify;
-        } else if (!mPendingBatchOps.values(GoogleContactStream::Remove).isEmpty()) {
-            type = GoogleContactStream::Remove;
-        }
-
-        value = mPendingBatchOps.values(type).first();
-        mPendingBatchOps.remove(type, value);
-        batchPage.insertMulti(type, value);
-    }
-
+    // split the page until it fits on the byte budget
     GoogleContactStream encoder(false, mAccountName);
-    QByteArray encodedContacts = encoder.encode(batchPage);
+    mCurrentBatchPage = mPendingBatchOps.takePage(mBatchSizer.pageSize());
+    QByteArray encodedContacts = encoder.encode(mCurrentBatchPage);
+    while ((encodedContacts.size() > mBatchSizer.maxPageBytes()) && (mCurrentBatchPage.size() > 1)) {
+        int pageSize = mCurrentBatchPage.size() / 2;
+        mPendingBatchOps.putBack(mCurrentBatchPage);
+        mCurrentBatchPage = mPendingBatchOps.takePage(pageSize);
+        GoogleContactStream pageEncoder(false, mAccountName);
+        encodedContacts = pageEncoder.encode(mCurrentBatchPage);
+    }
+    LOG_INFO("Sending batch page with" << mCurrentBatchPage.size() << "entries and"
+             << encodedContacts.size() << "bytes");
 
     mTransport->reset();
     mTransport->setUrl(mRemoteUri + "batch");
@@ -360,6 +799,7 @@ GRemoteSource::batchOperationContinue()
     mTransport->setData(encodedContacts);
     mTransport->addHeader("Content-Type", "application/atom+xml; charset=UTF-8; type=feed");
     LOG_TRACE("POST DATA:" << encodedContacts);
+    mBatchTimer.start();
     mTransport->request(GTransport::POST);
 }
 
@@ -405,7 +845,7 @@ void GRemoteSource::emitTransactionCommited(const QList<QContact> &created,
 }
 
 void
-GRemoteSource::fetchRemoteContacts(const QDateTime &since, bool includeDeleted, int startIndex)
+GRemoteSource::fetchRemoteContacts(GTransport *transport, const QDateTime &since, bool includeDeleted, int startIndex)
 {
     FUNCTION_CALL_TRACE;
     if (mState == GRemoteSource::STATE_ABORTED) {
@@ -419,26 +859,92 @@ GRemoteSource::fetchRemoteContacts(const QDateTime &since, bool includeDeleted,
      o Use mTransport to perform network fetch
     */
     if (since.isValid()) {
-        mTransport->setUpdatedMin(since);
+        transport->setUpdatedMin(since);
     }
 
     if (startIndex > 1) {
-        mTransport->setStartIndex(startIndex);
+        transport->setStartIndex(startIndex);
     }
 
-    mTransport->setMaxResults(GConfig::MAX_RESULTS);
+    transport->setMaxResults(fetchPageSize());
     if (includeDeleted) {
-        mTransport->setShowDeleted();
+        transport->setShowDeleted();
+    }
+
+    if (mFetchManifest) {
+        transport->setFields(GConfig::MANIFEST_FIELDS);
     }
 
     // TODO: only fetch contacts from "My Contacts" group for now
     // we should implement support for all groups
-    mTransport->setGroupFilter(mAccountName, GConfig::GROUP_MY_CONTACTS_ID);
+    transport->setGroupFilter(mAccountName, GConfig::GROUP_MY_CONTACTS_ID);
 
-    mTransport->setGDataVersionHeader();
-    mTransport->addHeader(QByteArray("Authorization"),
+    transport->setGDataVersionHeader();
+    transport->addHeader(QByteArray("Authorization"),
                           QString("Bearer " + mAuthToken).toUtf8());
-    mTransport->request(GTransport::GET);
+
+    // the page is parsed while it is received
+    delete mFetchParsers.take(transport);
+    GoogleContactStream *parser = new GoogleContactStream(false);
+    if (!mFetchManifest) {
+        parser->setKnownETags(knownETags());
+    }
+    mFetchParsers.insert(transport, parser);
+    transport->setStreamingReply(true);
+    transport->request(GTransport::GET);
+}
+
+void GRemoteSource::fetchDataReceived(const QByteArray &data)
+{
+    GoogleContactStream *parser = mFetchParsers.value(qobject_cast<GTransport*>(sender()));
+    if (parser) {
+        parser->addData(data);
+    }
+}
+
+QList<QContact> GRemoteSource::fetchedContacts(const GoogleContactAtom *atom)
+{
+    QList<QContact> remoteContacts;
+
+    // for each remote contact, there are some associated XML elements which
+    // could not be stored in QContactDetail form (eg, link URIs etc).
+    // build up some datastructures to help us retrieve that information
+    // when we need it.
+    // we also store the etag data out-of-band to avoid spurious contact saves
+    // when the etag changes are reported by the remote server.
+    // finally, we can set the id of the contact.
+    QList<QPair<QContact, QStringList> > remoteAddModContacts = atom->entryContacts();
+    for (int i = 0; i < remoteAddModContacts.size(); ++i) {
+        QContact c = remoteAddModContacts[i].first;
+        QContactGuid guid =  c.detail<QContactGuid>();
+        UContactsBackend::setRemoteId(c, guid.guid());
+        c.removeDetail(&guid);
+        // FIXME: This code came from the meego implementation, until now we did not face
+        // any unsupported xml element. Keep the code here in case some unsupported element
+        // apper. Then we should store it some how on our backend.
+        //  m_unsupportedXmlElements[accountId].insert(
+        //          c.detail<QContactGuid>().guid(),
+        //          remoteAddModContacts[i].second);
+        //  m_contactEtags[accountId].insert(c.detail<QContactGuid>().guid(), c.detail<QContactOriginMetadata>().id());
+        // c.setId(QContactId::fromString(m_contactIds[accountId].value(c.detail<QContactGuid>().guid())));
+        // m_remoteAddMods[accountId].append(c);
+        remoteContacts << c;
+    }
+
+    QList<QContact> remoteDelContacts = atom->deletedEntryContacts();
+    for (int i = 0; i < remoteDelContacts.size(); ++i) {
+        QContact c = remoteDelContacts[i];
+        QContactGuid guid =  c.detail<QContactGuid>();
+        UContactsBackend::setRemoteId(c, guid.guid());
+        c.removeDetail(&guid);
+        // FIXME
+        // c.setId(QContactId::fromString(m_contactIds[accountId].value(c.detail<QContactGuid>().guid())));
+        // m_contactAvatars[accountId].remove(c.detail<QContactGuid>().guid()); // just in case the avatar was outstanding.
+        // m_remoteDels[accountId].append(c);
+        remoteContacts << c;
+    }
+
+    return remoteContacts;
 }
 
 /**
@@ -457,36 +963,116 @@ GRemoteSource::networkRequestFinished()
         return;
     }
 
+    GTransport *transport = qobject_cast<GTransport*>(sender());
+    if (!transport) {
+        transport = mTransport.data();
+    }
+
+    if ((transport != mTransport.data()) && !mRunningFetches.contains(transport)) {
+        LOG_DEBUG("Ignoring reply of a cancelled page request");
+        return;
+    }
+
+    if ((mState == GRemoteSource::STATE_PROBING) && (mProbeStatus != Sync::SYNC_DONE)) {
+        mState = GRemoteSource::STATE_IDLE;
+        emit changesProbed(-1, mProbeStatus);
+        return;
+    }
+
+    if (mRetryingBatchPage) {
+        // the failed page was put back on the queue, send it again with the new size
+        mRetryingBatchPage = false;
+        batchOperationContinue();
+        return;
+    }
+
+    if (mFailedBatchPage) {
+        // the server may have applied the page, its entries are reported as
+        // failed instead of being sent again
+        mFailedBatchPage = false;
+        QMap<QString, int> errorMap;
+        foreach (const GBatchQueue::Operation &op, mCurrentBatchPage) {
+            errorMap.insert(op.first.id().toString(), QContactManager::UnspecifiedError);
+        }
+        mCurrentBatchPage.clear();
+        mBatchRetries = 0;
+        queueTransactionCommited(QList<QContact>(),
+                                 QList<QContact>(),
+                                 QList<QContact>(),
+                                 errorMap,
+                                 Sync::SYNC_PROGRESS,
+                                 0);
+        batchOperationContinue();
+        return;
+    }
+
     // o Error - if network error, set the sync results with the code
     // o Call uninit
     // o Stop sync
     // o If success, invoke the mParser->parse ()
     Sync::SyncStatus syncStatus = Sync::SYNC_ERROR;
-    GTransport::HTTP_REQUEST_TYPE requestType = mTransport->requestType();
-    if (mTransport->hasReply()) {
-        QByteArray data = mTransport->replyBody();
-        LOG_TRACE(data);
-        if (data.isNull () || data.isEmpty()) {
-            LOG_INFO("Nothing returned from server");
-            syncStatus = Sync::SYNC_CONNECTION_ERROR;
-            goto operationFailed;
+    GTransport::HTTP_REQUEST_TYPE requestType = transport->requestType();
+    if (transport->hasReply()) {
+        GoogleContactAtom *atom = 0;
+        QScopedPointer<GoogleContactStream> streamParser(mFetchParsers.take(transport));
+        if (streamParser) {
+            atom = streamParser->finishParse();
+            if (!atom) {
+                LOG_INFO("Nothing returned from server");
+                syncStatus = Sync::SYNC_CONNECTION_ERROR;
+                goto operationFailed;
+            }
+        } else {
+            QByteArray data = transport->replyBody();
+            LOG_TRACE(data);
+            if (data.isNull () || data.isEmpty()) {
+                LOG_INFO("Nothing returned from server");
+                syncStatus = Sync::SYNC_CONNECTION_ERROR;
+                goto operationFailed;
+            }
+
+            GoogleContactStream parser(false);
+            atom = parser.parse(data);
         }
 
-        GoogleContactStream parser(false);
-        GoogleContactAtom *atom = parser.parse(data);
         if (!atom) {
             LOG_CRITICAL("NULL atom object. Something wrong with parsing");
             goto operationFailed;
         }
 
-        if ((requestType == GTransport::POST) ||
-            (requestType == GTransport::PUT)) {
+        if (mState == GRemoteSource::STATE_PROBING) {
+            LOG_INFO("Remote changes since last sync:" << atom->totalResults());
+            mState = GRemoteSource::STATE_IDLE;
+            emit changesProbed(atom->totalResults(), Sync::SYNC_DONE);
+        } else if (mFetchingById && (requestType == GTransport::POST)) {
+            LOG_DEBUG("@@@PREVIOUS REQUEST TYPE=POST (query)");
+            foreach (const GoogleContactAtom::BatchOperationResponse &response, atom->batchOperationResponses()) {
+                if (response.isError) {
+                    // the contact can be removed after the manifest was fetched
+                    LOG_WARNING("Fail to fetch contact:" << response.operationId
+                                << response.code << response.reason);
+                }
+            }
+
+            QList<QContact> remoteContacts = fetchedContacts(atom);
+            LOG_INFO("received information about" << remoteContacts.size() << "contacts");
+
+            if (mFetchAvatars) {
+                downloadAvatars(0, remoteContacts);
+            } else {
+                emitContactsFetchedById(remoteContacts);
+            }
+        } else if ((requestType == GTransport::POST) ||
+                   (requestType == GTransport::PUT)) {
             QList<QContact> addedContacts;
             QList<QContact> modContacts;
             QList<QContact> delContacts;
             QMap<QString, int> errorMap;
 
             LOG_DEBUG("@@@PREVIOUS REQUEST TYPE=POST");
+            mBatchSizer.success(mCurrentBatchPage.size(), mBatchTimer.elapsed());
+            mCurrentBatchPage.clear();
+            mBatchRetries = 0;
             QMap<QString, GoogleContactAtom::BatchOperationResponse> operationResponses = atom->batchOperationResponses();
             QMap<QString, QString> batchOperationRemoteIdToType;
             QMap<QString, QString> batchOperationRemoteToLocalId;
@@ -532,23 +1118,21 @@ GRemoteSource::networkRequestFinished()
             delContacts += atom->deletedEntryContacts();
             LOG_DEBUG("Number of deleted contacts:" << delContacts.size());
 
-            if (!atom->nextEntriesUrl().isEmpty()) {
+            // batch replies do not have next link, check for pending pages
+            // and for the failure of a previous page
+            if (!mPendingBatchOps.isEmpty() || (mBatchStatus != Sync::SYNC_DONE)) {
                 syncStatus = Sync::SYNC_PROGRESS;
             } else {
-                //TODO: avatars
                 syncStatus = Sync::SYNC_DONE;
-                mState = GRemoteSource::STATE_IDLE;
             }
 
-            uploadAvatars(&addedContacts);
-            uploadAvatars(&modContacts);
-
-            emitTransactionCommited(addedContacts, modContacts, delContacts, errorMap, syncStatus);
+            // avatars are uploaded while the next page is sent, the commit
+            // of this page is notified after its uploads finish
+            GContactImageUploader *uploader = uploadAvatars(addedContacts + modContacts);
+            queueTransactionCommited(addedContacts, modContacts, delContacts, errorMap, syncStatus, uploader);
 
             if (syncStatus == Sync::SYNC_PROGRESS) {
                 batchOperationContinue();
-            } else {
-                mLocalIdToAvatar.clear();
             }
         } else if (requestType == GTransport::GET) {
             LOG_DEBUG ("@@@PREVIOUS REQUEST TYPE=GET");
@@ -556,88 +1140,36 @@ GRemoteSource::networkRequestFinished()
                 LOG_WARNING("Received a network request finish but the state is not fetching contacts" << mState);
                 return;
             }
+            int startIndex = mRunningFetches.take(transport);
 
             LOG_INFO("received information about" <<
                      atom->entryContacts().size() << "add/mod contacts and " <<
-                     atom->deletedEntryContacts().size() << "del contacts");
-
-            QList<QContact> remoteContacts;
-
-            // for each remote contact, there are some associated XML elements which
-            // could not be stored in QContactDetail form (eg, link URIs etc).
-            // build up some datastructures to help us retrieve that information
-            // when we need it.
-            // we also store the etag data out-of-band to avoid spurious contact saves
-            // when the etag changes are reported by the remote server.
-            // finally, we can set the id of the contact.
-            QList<QPair<QContact, QStringList> > remoteAddModContacts = atom->entryContacts();
-            for (int i = 0; i < remoteAddModContacts.size(); ++i) {
-                QContact c = remoteAddModContacts[i].first;
-                QContactGuid guid =  c.detail<QContactGuid>();
-                UContactsBackend::setRemoteId(c, guid.guid());
-                c.removeDetail(&guid);
-                // FIXME: This code came from the meego implementation, until now we did not face
-                // any unsupported xml element. Keep the code here in case some unsupported element
-                // apper. Then we should store it some how on our backend.
-                //  m_unsupportedXmlElements[accountId].insert(
-                //          c.detail<QContactGuid>().guid(),
-                //          remoteAddModContacts[i].second);
-                //  m_contactEtags[accountId].insert(c.detail<QContactGuid>().guid(), c.detail<QContactOriginMetadata>().id());
-                // c.setId(QContactId::fromString(m_contactIds[accountId].value(c.detail<QContactGuid>().guid())));
-                // m_remoteAddMods[accountId].append(c);
-                remoteContacts << c;
-            }
+                     atom->deletedEntryContacts().size() << "del contacts and " <<
+                     atom->unchangedEntries().size() << "unchanged contacts");
 
-            if (mFetchAvatars) {
-                fetchAvatars(&remoteContacts);
+            if (!atom->unchangedEntries().isEmpty()) {
+                emit contactsUnchanged(atom->unchangedEntries());
             }
 
-            QList<QContact> remoteDelContacts = atom->deletedEntryContacts();
-            for (int i = 0; i < remoteDelContacts.size(); ++i) {
-                QContact c = remoteDelContacts[i];
-                QContactGuid guid =  c.detail<QContactGuid>();
-                UContactsBackend::setRemoteId(c, guid.guid());
-                c.removeDetail(&guid);
-                // FIXME
-                // c.setId(QContactId::fromString(m_contactIds[accountId].value(c.detail<QContactGuid>().guid())));
-                // m_contactAvatars[accountId].remove(c.detail<QContactGuid>().guid()); // just in case the avatar was outstanding.
-                // m_remoteDels[accountId].append(c);
-                remoteContacts << c;
-            }
+            QList<QContact> remoteContacts = fetchedContacts(atom);
 
             bool hasMore = (!atom->nextEntriesUrl().isNull() ||
                             !atom->nextEntriesUrl().isEmpty());
             if (hasMore) {
-                // Request for the next batch
                 // This condition will make this slot to be
                 // called again and again until there are no more
                 // entries left to be fetched from the server
-                mStartIndex += GConfig::MAX_RESULTS;
-                mTransport->setUrl(atom->nextEntriesUrl());
-                syncStatus = Sync::SYNC_PROGRESS;
-                LOG_DEBUG("Has more contacts to retrieve");
-            } else {
-                LOG_DEBUG("NO contacts to retrieve");
-                syncStatus = Sync::SYNC_DONE;
-                mState = GRemoteSource::STATE_IDLE;
-            }
-
-            // progress
-            qreal progress = -1.0;
-            if (hasMore && (atom->totalResults() > 0)) {
-                progress = (mStartIndex / (qreal) atom->totalResults());
-            } else if (!hasMore) {
-                progress = 1.0;
+                planFetches(atom, startIndex);
             }
 
-            LOG_TRACE("NOTIFY CONTACTS FETCHED:" << remoteContacts.size() << "Progress" << progress);
-            emit contactsFetched(remoteContacts, syncStatus, progress);
-
-            if (hasMore) {
-                LOG_TRACE("FETCH MORE CONTACTS FROM INDEX:" << mStartIndex);
-                fetchRemoteContacts(QDateTime(),
-                                    mTransport->showDeleted(),
-                                    mStartIndex);
+            // request the next pages before notifying this one
+            scheduleFetches();
+            if (mFetchAvatars) {
+                // the page waits for its avatars while the next ones are fetched
+                downloadAvatars(startIndex, remoteContacts);
+            } else {
+                mFetchedPages.insert(startIndex, remoteContacts);
+                emitFetchedPages();
             }
         }
         delete atom;
@@ -646,15 +1178,22 @@ GRemoteSource::networkRequestFinished()
 
 operationFailed:
     switch(mState) {
+    case GRemoteSource::STATE_PROBING:
+        // the sync can continue from the signal, the state must be updated first
+        mState = GRemoteSource::STATE_IDLE;
+        emit changesProbed(-1, syncStatus);
+        return;
     case GRemoteSource::STATE_FETCHING_CONTACTS:
+        resetFetchState();
         contactsFetched(QList<QContact>(), syncStatus, -1.0);
         break;
     case GRemoteSource::STATE_BATCH_RUNNING:
-        emitTransactionCommited(QList<QContact>(),
-                                QList<QContact>(),
-                                QList<QContact>(),
-                                QMap<QString, int>(),
-                                syncStatus);
+        queueTransactionCommited(QList<QContact>(),
+                                 QList<QContact>(),
+                                 QList<QContact>(),
+                                 QMap<QString, int>(),
+                                 syncStatus,
+                                 0);
         break;
     default:
         break;
@@ -662,11 +1201,29 @@ operationFailed:
     mState = GRemoteSource::STATE_IDLE;
 }
 
+bool
+GRemoteSource::isCancelledFetch(const QObject *sender) const
+{
+    const GTransport *transport = qobject_cast<const GTransport*>(sender);
+    return (transport && (transport != mTransport.data()) &&
+            !mRunningFetches.contains(const_cast<GTransport*>(transport)));
+}
+
 void
 GRemoteSource::networkError(int errorCode)
 {
     FUNCTION_CALL_TRACE;
 
+    if (isCancelledFetch(sender())) {
+        LOG_DEBUG("Ignoring error of a cancelled page request" << errorCode);
+        return;
+    }
+
+    if (mRetryingBatchPage || mFailedBatchPage) {
+        // error already handled, waiting for the request to finish
+        return;
+    }
+
     Sync::SyncStatus syncStatus = Sync::SYNC_ERROR;
     switch (errorCode)
     {
@@ -692,16 +1249,76 @@ GRemoteSource::networkError(int errorCode)
         break;
     };
 
+    // the following pages are smaller after errors caused by the page size
+    if ((mState == GRemoteSource::STATE_BATCH_RUNNING) &&
+        !mCurrentBatchPage.isEmpty() &&
+        mBatchSizer.failure(errorCode)) {
+        // inserts are not idempotent, a page with inserts is only sent again
+        // when the server refused it, after a timeout or a server failure
+        // it may have been applied
+        bool refused = (errorCode == GTransport::HTTP_REQUEST_ENTITY_TOO_LARGE);
+        if ((refused || !mCurrentBatchPage.contains(GoogleContactStream::Add)) &&
+            (mBatchRetries < GConfig::BATCH_MAX_RETRIES)) {
+            mBatchRetries++;
+            LOG_WARNING("Batch request failed with" << errorCode << "retrying" << mBatchRetries);
+            mPendingBatchOps.putBack(mCurrentBatchPage);
+            mCurrentBatchPage.clear();
+            mRetryingBatchPage = true;
+            return;
+        } else if (!refused) {
+            LOG_WARNING("Batch request failed with" << errorCode << "skipping page with"
+                        << mCurrentBatchPage.size() << "entries");
+            mBatchStatus = syncStatus;
+            mFailedBatchPage = true;
+            return;
+        }
+    }
+
+    networkFailure(syncStatus);
+}
+
+void
+GRemoteSource::networkTransportError(int networkError)
+{
+    FUNCTION_CALL_TRACE;
+
+    if (isCancelledFetch(sender())) {
+        LOG_DEBUG("Ignoring error of a cancelled page request" << networkError);
+        return;
+    }
+
+    if (mRetryingBatchPage || mFailedBatchPage) {
+        // error already handled, waiting for the request to finish
+        return;
+    }
+
+    LOG_WARNING("Request failed with network error" << networkError);
+    networkFailure(Sync::SYNC_CONNECTION_ERROR);
+}
+
+void
+GRemoteSource::networkFailure(Sync::SyncStatus syncStatus)
+{
+    if (mState == GRemoteSource::STATE_PROBING) {
+        // notified when the request finishes, the first error is the cause
+        if (mProbeStatus == Sync::SYNC_DONE) {
+            mProbeStatus = syncStatus;
+        }
+        return;
+    }
+
     switch(mState) {
     case GRemoteSource::STATE_FETCHING_CONTACTS:
+        resetFetchState();
         contactsFetched(QList<QContact>(), syncStatus, -1.0);
         break;
     case GRemoteSource::STATE_BATCH_RUNNING:
-        emitTransactionCommited(QList<QContact>(),
-                                QList<QContact>(),
-                                QList<QContact>(),
-                                QMap<QString, int>(),
-                                syncStatus);
+        queueTransactionCommited(QList<QContact>(),
+                                 QList<QContact>(),
+                                 QList<QContact>(),
+                                 QMap<QString, int>(),
+                                 syncStatus,
+                                 0);
         break;
     default:
         break;
@@ -714,6 +1331,11 @@ const GTransport *GRemoteSource::transport() const
     return mTransport.data();
 }
 
+QList<GTransport*> GRemoteSource::fetchTransports() const
+{
+    return mFetchTransports;
+}
+
 int GRemoteSource::state() const
 {
     return mState;
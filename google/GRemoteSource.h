@@ -25,13 +25,20 @@
  */
 
 #include "GContactStream.h"
+#include "GBatchQueue.h"
+#include "GBatchSizer.h"
 
 #include <UAbstractRemoteSource.h>
 
 #include <QHash>
+#include <QElapsedTimer>
+#include <QQueue>
 #include <QScopedPointer>
 
 class GTransport;
+class GContactImageDownloader;
+class GContactAvatarCache;
+class GContactImageUploader;
 
 class GRemoteSource : public UAbstractRemoteSource
 {
@@ -44,9 +51,15 @@ public:
     bool init(const QVariantMap &properties);
     void abort();
     void fetchContacts(const QDateTime &since, bool includeDeleted, bool fetchAvatar = true);
+    bool fetchManifest();
+    void fetchContactsById(const QStringList &remoteIds);
+    bool probeChanges(const QDateTime &since);
+    QtContacts::QContactFetchHint uploadFetchHint() const;
+    UContactsConflictResolver::DetailEncoder uploadDetailEncoder() const;
 
     // help on tests
     const GTransport *transport() const;
+    QList<GTransport*> fetchTransports() const;
     int state() const;
 
 protected:
@@ -60,30 +73,90 @@ protected:
 private slots:
     void networkRequestFinished();
     void networkError(int errorCode);
+    void networkTransportError(int networkError);
+    void fetchDataReceived(const QByteArray &data);
+    void fetchNextContactsById();
+    void flushTransactionCommits();
+    void avatarsDownloaded();
 
 private:
     enum SyncState {
         STATE_IDLE = 0,
         STATE_FETCHING_CONTACTS,
         STATE_BATCH_RUNNING,
+        STATE_PROBING,
         STATE_ABORTED
     };
 
+    struct PendingCommit {
+        QList<QtContacts::QContact> created;
+        QList<QtContacts::QContact> changed;
+        QList<QtContacts::QContact> removed;
+        QMap<QString, int> errorMap;
+        Sync::SyncStatus status;
+        GContactImageUploader *uploader;
+    };
+
     QScopedPointer<GTransport> mTransport;
+    QList<GTransport*> mFetchTransports;
+    QScopedPointer<GContactAvatarCache> mAvatarCache;
     QString mRemoteUri;
     QString mAuthToken;
     QString mSyncTarget;
     QString mAccountName;
     SyncState mState;
-    int mStartIndex;
     bool mFetchAvatars;
+    bool mFetchIncludeDeleted;
+    bool mFetchManifest;
+    bool mFetchingById;
+    int mFetchByIdTotal;
+    QStringList mFetchByIdQueue;
+    bool mFetchPlanned;
+    int mFetchTotalResults;
+    int mLastFetchIndex;
+    QString mFetchUrl;
+    QList<int> mFetchOrder;
+    QQueue<int> mPendingFetches;
+    QHash<GTransport*, int> mRunningFetches;
+    QHash<GTransport*, GoogleContactStream*> mFetchParsers;
+    QMap<int, QList<QtContacts::QContact> > mFetchedPages;
+    QHash<GContactImageDownloader*, QPair<int, QList<QtContacts::QContact> > > mAvatarDownloads;
     QMap<QString, QPair<QString, QUrl> > mLocalIdToAvatar;
     QMap<QString, QContact> mLocalIdToContact;
-    QMultiMap<GoogleContactStream::UpdateType, QPair<QtContacts::QContact, QStringList> > mPendingBatchOps;
+    GBatchQueue mPendingBatchOps;
+    GBatchQueue::Page mCurrentBatchPage;
+    GBatchSizer mBatchSizer;
+    QElapsedTimer mBatchTimer;
+    int mBatchRetries;
+    bool mRetryingBatchPage;
+    bool mFailedBatchPage;
+    Sync::SyncStatus mBatchStatus;
+    Sync::SyncStatus mProbeStatus;
+    QQueue<PendingCommit> mPendingCommits;
 
-    void fetchAvatars(QList<QtContacts::QContact> *contacts);
-    void uploadAvatars(QList<QContact> *contacts);
-    void fetchRemoteContacts(const QDateTime &since, bool includeDeleted, int startIndex);
+    void downloadAvatars(int startIndex, const QList<QtContacts::QContact> &contacts);
+    void cancelAvatarDownloads();
+    GContactImageUploader *uploadAvatars(const QList<QtContacts::QContact> &contacts);
+    void applyAvatarUploads(QList<QtContacts::QContact> *contacts, GContactImageUploader *uploader);
+    void queueTransactionCommited(const QList<QtContacts::QContact> &created,
+                                  const QList<QtContacts::QContact> &changed,
+                                  const QList<QtContacts::QContact> &removed,
+                                  const QMap<QString, int> &errorMap,
+                                  Sync::SyncStatus status,
+                                  GContactImageUploader *uploader);
+    void startFetch(const QDateTime &since, bool includeDeleted, bool manifest);
+    void fetchRemoteContacts(GTransport *transport, const QDateTime &since, bool includeDeleted, int startIndex);
+    int fetchPageSize() const;
+    QList<QtContacts::QContact> fetchedContacts(const GoogleContactAtom *atom);
+    void resetFetchState();
+    bool isCancelledFetch(const QObject *sender) const;
+    void networkFailure(Sync::SyncStatus syncStatus);
+    void planFetches(const GoogleContactAtom *atom, int startIndex);
+    void appendFetch(int startIndex);
+    void scheduleFetches();
+    void emitFetchedPages();
+    void emitContactsFetchedById(const QList<QtContacts::QContact> &contacts);
+    GTransport *idleFetchTransport() const;
     void batchOperationContinue();
     int parseErrorReponse(const GoogleContactAtom::BatchOperationResponse &response);
     void emitTransactionCommited(const QList<QtContacts::QContact> &created,
@@ -30,6 +30,7 @@
 #include <QNetworkProxy>
 #include <QDateTime>
 #include <QUrlQuery>
+#include <QTimer>
 
 #include <LogMacros.h>
 
@@ -55,6 +56,7 @@ const QString SHOW_DELETED_TAG("showdeleted");
 const QString REQUIRE_ALL_DELETED("requirealldeleted");
 const QString SORTORDER_TAG("sortorder");
 const QString GROUP_QUERY_TAG("group");
+const QString FIELDS_TAG("fields");
 
 const QString PHOTO_TAG("photos");
 const QString MEDIA_TAG("media");
@@ -66,8 +68,15 @@ public:
     GTransportPrivate(QObject *parent)
         : mNetworkRequest(0),
           mNetworkReply(0),
-          mNetworkMgr(new QNetworkAccessManager(parent))
+          mNetworkMgr(new QNetworkAccessManager(parent)),
+          mTimeoutTimer(new QTimer(parent)),
+          mTimedOut(false),
+          mStreamingReply(false),
+          mNetworkError(QNetworkReply::NoError),
+          mResponseCode(0)
     {
+        mTimeoutTimer->setSingleShot(true);
+        QObject::connect(mTimeoutTimer, SIGNAL(timeout()), parent, SLOT(requestTimeout()));
     }
 
     void
@@ -91,6 +100,9 @@ public:
     QNetworkRequest *mNetworkRequest;
     QNetworkReply *mNetworkReply;
     QScopedPointer<QNetworkAccessManager> mNetworkMgr;
+    QTimer *mTimeoutTimer;
+    bool mTimedOut;
+    bool mStreamingReply;
 
     QUrl mUrl;
     QList<QPair<QByteArray, QByteArray> > mHeaders;
@@ -251,6 +263,7 @@ GTransport::request(const HTTP_REQUEST_TYPE type)
     }
 
     d->mNetworkReplyBody = "";
+    d->mResponseCode = 0;
     d->mNetworkRequest = new QNetworkRequest();
     d->mNetworkRequest->setUrl(d->mUrl);
     setHeaders();
@@ -292,6 +305,13 @@ GTransport::request(const HTTP_REQUEST_TYPE type)
                                   << ":" << d->mNetworkRequest->rawHeader(headerList.at (i)));
     }
     connect(d->mNetworkReply, SIGNAL(readyRead()), SLOT(readyRead()));
+    connect(d->mNetworkReply, SIGNAL(downloadProgress(qint64,qint64)), SLOT(transferProgress(qint64,qint64)));
+    connect(d->mNetworkReply, SIGNAL(uploadProgress(qint64,qint64)), SLOT(transferProgress(qint64,qint64)));
+
+    d->mTimedOut = false;
+    if (d->mTimeoutTimer->interval() > 0) {
+        d->mTimeoutTimer->start();
+    }
 }
 
 bool
@@ -318,11 +338,24 @@ GTransport::readyRead()
     FUNCTION_CALL_TRACE;
     Q_D(GTransport);
 
+    if (sender() != d->mNetworkReply) {
+        // reply of an aborted request
+        return;
+    }
+
+    if (d->mTimeoutTimer->isActive()) {
+        d->mTimeoutTimer->start();
+    }
+
     d->mResponseCode = d->mNetworkReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     LOG_DEBUG ("++RESPONSE CODE:" << d->mResponseCode);
     QByteArray bytes = d->mNetworkReply->readAll();
     if (d->mResponseCode >= 200 && d->mResponseCode <= 300) {
-        d->mNetworkReplyBody += bytes;
+        if (d->mStreamingReply) {
+            emit dataReceived(bytes);
+        } else {
+            d->mNetworkReplyBody += bytes;
+        }
     } else {
         LOG_DEBUG ("SERVER ERROR:" << bytes);
         emit error(d->mResponseCode);
@@ -338,10 +371,26 @@ GTransport::finishedSlot(QNetworkReply *reply)
 //    QVariant statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
 //    QVariant redirectionUrl = reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
 
-    d->mNetworkError = reply->error();
+    if (reply != d->mNetworkReply) {
+        // reply of an aborted request
+        reply->deleteLater();
+        return;
+    }
 
-    if (d->mNetworkError != QNetworkReply::NoError) {
-        emit error(d->mNetworkError);
+    d->mTimeoutTimer->stop();
+    d->mNetworkError = reply->error();
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (d->mTimedOut) {
+        emit error(HTTP_REQUEST_TIMEOUT);
+    } else if (statusCode > 300) {
+        // replies with a body were already reported by readyRead()
+        if (d->mResponseCode != statusCode) {
+            emit error(statusCode);
+        }
+    } else if (d->mNetworkError != QNetworkReply::NoError) {
+        // NetworkError values overlap with HTTP status codes, never use error() for them
+        emit transportError(d->mNetworkError);
     }
 
     emit finishedRequest();
@@ -415,6 +464,21 @@ bool GTransport::showDeleted() const
     return urlQuery.hasQueryItem(SHOW_DELETED_TAG);
 }
 
+void
+GTransport::setFields(const QString &fields)
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(GTransport);
+
+    QUrlQuery urlQuery(d->mUrl);
+    if (urlQuery.hasQueryItem(FIELDS_TAG)) {
+        urlQuery.removeQueryItem(FIELDS_TAG);
+    }
+
+    urlQuery.addQueryItem(FIELDS_TAG, fields);
+    d->mUrl.setQuery(urlQuery);
+}
+
 void
 GTransport::setStartIndex(const int index)
 {
@@ -447,4 +511,62 @@ GTransport::reset()
     d->mHeaders.clear ();
     d->mPostData.clear ();
     d->mNetworkReplyBody.clear();
+    d->mStreamingReply = false;
+}
+
+void
+GTransport::abort()
+{
+    Q_D(GTransport);
+
+    d->mTimeoutTimer->stop();
+    if (d->mNetworkReply) {
+        // the reply is ignored when the network access manager reports it finished
+        QNetworkReply *reply = d->mNetworkReply;
+        d->mNetworkReply = 0;
+        reply->disconnect(this);
+        reply->abort();
+    }
+}
+
+void
+GTransport::setTimeout(int msecs)
+{
+    Q_D(GTransport);
+
+    d->mTimeoutTimer->setInterval(msecs);
+}
+
+void
+GTransport::setStreamingReply(bool enabled)
+{
+    Q_D(GTransport);
+
+    d->mStreamingReply = enabled;
+}
+
+void
+GTransport::requestTimeout()
+{
+    FUNCTION_CALL_TRACE;
+    Q_D(GTransport);
+
+    if (d->mNetworkReply && d->mNetworkReply->isRunning()) {
+        LOG_WARNING("Request timeout:" << d->mUrl);
+        d->mTimedOut = true;
+        d->mNetworkReply->abort();
+    }
+}
+
+void
+GTransport::transferProgress(qint64 bytes, qint64 total)
+{
+    Q_UNUSED(bytes);
+    Q_UNUSED(total);
+    Q_D(GTransport);
+
+    // slow transfers are fine while data keeps flowing
+    if ((sender() == d->mNetworkReply) && d->mTimeoutTimer->isActive()) {
+        d->mTimeoutTimer->start();
+    }
 }
@@ -70,23 +70,37 @@ public:
     void setMaxResults(unsigned int limit);
     void setShowDeleted();
     void setGroupFilter(const QString &account, const QString &groupId);
+    // request a partial response with only the given elements
+    void setFields(const QString &fields);
     bool showDeleted() const;
     void setStartIndex(const int index);
     HTTP_REQUEST_TYPE requestType();
     void reset();
+    // abort the running request, it does not emit any signal after this
+    void abort();
+    // abort requests without network activity for msecs and report it as a 408 error, 0 disables it
+    void setTimeout(int msecs);
+    // deliver the reply body through dataReceived instead of buffering it
+    void setStreamingReply(bool enabled);
 
     typedef enum
     {
         HTTP_OK = 200,
         HTTP_CONTACT_CREATED = 201,
-        HTTP_PRECONDITION_FAILED = 412
+        HTTP_REQUEST_TIMEOUT = 408,
+        HTTP_PRECONDITION_FAILED = 412,
+        HTTP_REQUEST_ENTITY_TOO_LARGE = 413
     } RESPONSE_CODE;
 
     static const QString GDATA_VERSION_HEADER;
 
 signals:
     void finishedRequest();
+    // HTTP status code of a failed request
     void error(int errorCode);
+    // failure without an HTTP status, as a QNetworkReply::NetworkError
+    void transportError(int networkError);
+    void dataReceived(const QByteArray &data);
 
     // used by tests
     void requested(const QUrl &url, QByteArray *result);
@@ -94,6 +108,8 @@ signals:
 private slots:
     virtual void finishedSlot(QNetworkReply* reply);
     virtual void readyRead();
+    void requestTimeout();
+    void transferProgress(qint64 bytes, qint64 total);
 
 private:
     QScopedPointer<GTransportPrivate> d_ptr;
@@ -21,16 +21,66 @@
  ****************************************************************************/
 
 #include "ContactsChangeNotifier.h"
+#include "UContactsSyncWrites.h"
 #include "LogMacros.h"
 #include <QList>
+#include <QDir>
+
+#include <QContactDetailFilter>
+#include <QContactExtendedDetail>
+#include <QContactGuid>
+#include <QContactIdFilter>
+#include <QContactSyncTarget>
+#include <QContactType>
+
+#include <ProfileManager.h>
+#include <SyncProfile.h>
 
 const QString DEFAULT_CONTACTS_MANAGER("galera");
+// a sync window open longer than this belongs to a sync that did not finish
+const int SYNC_WINDOW_MAX_SECS(3600);
+// interval used to check for the end of a sync while changes are pending
+const int SYNC_WINDOW_CHECK_INTERVAL(5000);
+// bursts of changes are notified once they stop for the quiet period,
+// but never later than the max delay after the first change
+const int DEFAULT_QUIET_PERIOD(1000);
+const int DEFAULT_MAX_DELAY(10000);
+// number of contacts resolved to its sync target on each query
+const int SYNC_TARGET_QUERY_SIZE(200);
+const QString PROFILE_CATEGORY_KEY("category");
+const QString PROFILE_CATEGORY_CONTACTS("contacts");
+// environment variables used to tune the coalescing of change notifications (ms),
+// the notifier plugin has no profile to read settings from
+static const char *QUIET_PERIOD_ENV("BUTEO_CONTACTS_CHANGE_QUIET_PERIOD");
+static const char *MAX_DELAY_ENV("BUTEO_CONTACTS_CHANGE_MAX_DELAY");
+
+static int envValue(const char *name)
+{
+    bool ok = false;
+    int value = qgetenv(name).toInt(&ok);
+    return ok ? value : -1;
+}
 
-ContactsChangeNotifier::ContactsChangeNotifier()
-    : iDisabled(true)
+ContactsChangeNotifier::ContactsChangeNotifier(const QString &managerName)
+    : iDisabled(true),
+      iActiveSyncTargetsLoaded(false)
 {
     FUNCTION_CALL_TRACE;
-    iManager = new QContactManager(DEFAULT_CONTACTS_MANAGER);
+    iManager = new QContactManager(managerName.isEmpty() ? DEFAULT_CONTACTS_MANAGER : managerName);
+
+    iSyncWindowTimer.setSingleShot(true);
+    iSyncWindowTimer.setInterval(SYNC_WINDOW_CHECK_INTERVAL);
+    connect(&iSyncWindowTimer, SIGNAL(timeout()), SLOT(flushChanges()));
+
+    iQuietTimer.setSingleShot(true);
+    iMaxDelayTimer.setSingleShot(true);
+    setCoalescing(DEFAULT_QUIET_PERIOD, DEFAULT_MAX_DELAY);
+    setCoalescing(envValue(QUIET_PERIOD_ENV), envValue(MAX_DELAY_ENV));
+    connect(&iQuietTimer, SIGNAL(timeout()), SLOT(flushChanges()));
+    connect(&iMaxDelayTimer, SIGNAL(timeout()), SLOT(flushChanges()));
+
+    connect(&iProfileManager, SIGNAL(profileChanged(QString, int, QString)),
+                              SLOT(onProfileChanged()));
 }
 
 ContactsChangeNotifier::~ContactsChangeNotifier()
@@ -50,6 +100,16 @@ void ContactsChangeNotifier::enable()
 
         connect(iManager, SIGNAL(contactsChanged(const QList<QContactId>&)),
                           SLOT(onContactsChanged(const QList<QContactId>&)));
+
+        // the end of a sync is notified by the update of its writes file
+        QString syncWritesDir = UContactsSyncWrites::directory();
+        QDir().mkpath(syncWritesDir);
+        iSyncWritesWatcher.addPath(syncWritesDir);
+        watchSyncWrites();
+        connect(&iSyncWritesWatcher, SIGNAL(directoryChanged(QString)),
+                                     SLOT(onSyncWritesChanged()));
+        connect(&iSyncWritesWatcher, SIGNAL(fileChanged(QString)),
+                                     SLOT(onSyncWritesChanged()));
         iDisabled = false;
     }
 }
@@ -58,10 +118,8 @@ void ContactsChangeNotifier::onContactsAdded(const QList<QContactId>& ids)
 {
     FUNCTION_CALL_TRACE;
     if(ids.count()) {
-        foreach(const QContactId &id, ids) {
-            LOG_DEBUG("Added contact with id" << id);
-        }
-        emit change();
+        LOG_DEBUG("Added contacts:" << ids.count());
+        queueChanges(ids);
     }
 }
 
@@ -69,10 +127,8 @@ void ContactsChangeNotifier::onContactsRemoved(const QList<QContactId>& ids)
 {
     FUNCTION_CALL_TRACE;
     if(ids.count()) {
-        foreach(const QContactId &id, ids) {
-            LOG_DEBUG("Removed contact with id" << id);
-        }
-        emit change();
+        LOG_DEBUG("Removed contacts:" << ids.count());
+        queueChanges(ids);
     }
 }
 
@@ -80,10 +136,221 @@ void ContactsChangeNotifier::onContactsChanged(const QList<QContactId>& ids)
 {
     FUNCTION_CALL_TRACE;
     if(ids.count()) {
-        foreach(const QContactId &id, ids) {
-            LOG_DEBUG("Changed contact with id" << id);
+        LOG_DEBUG("Changed contacts:" << ids.count());
+        queueChanges(ids);
+    }
+}
+
+void ContactsChangeNotifier::queueChanges(const QList<QContactId>& ids)
+{
+    // the change time is compared with the time the sync wrote the contact
+    QDateTime now = QDateTime::currentDateTimeUtc();
+    foreach(const QContactId &id, ids) {
+        iPendingIds.insert(id.toString(), now);
+    }
+
+    iQuietTimer.start();
+    if (!iMaxDelayTimer.isActive()) {
+        iMaxDelayTimer.start();
+    }
+}
+
+void ContactsChangeNotifier::watchSyncWrites()
+{
+    // writes files are appended, they are watched besides the directory
+    QDir dir(UContactsSyncWrites::directory());
+    QStringList watched = iSyncWritesWatcher.files();
+    QStringList files;
+    foreach(const QString &fileName, dir.entryList(QStringList() << "*.writes", QDir::Files)) {
+        QString path = dir.absoluteFilePath(fileName);
+        if (!watched.contains(path)) {
+            files << path;
+        }
+    }
+    if (!files.isEmpty()) {
+        iSyncWritesWatcher.addPaths(files);
+    }
+}
+
+void ContactsChangeNotifier::onSyncWritesChanged()
+{
+    watchSyncWrites();
+    // only relevant if changes are waiting for a sync to finish
+    if (iSyncWindowTimer.isActive()) {
+        flushChanges();
+    }
+}
+
+void ContactsChangeNotifier::flushChanges()
+{
+    FUNCTION_CALL_TRACE;
+    iQuietTimer.stop();
+    iMaxDelayTimer.stop();
+    if (iPendingIds.isEmpty()) {
+        return;
+    }
+
+    bool syncRunning = false;
+    removeSyncWrites(&syncRunning);
+    if (iPendingIds.isEmpty()) {
+        LOG_DEBUG("Ignoring changes done by the contacts sync");
+        return;
+    }
+
+    // the ids written by a running sync are not known yet, wait for it
+    if (syncRunning) {
+        iSyncWindowTimer.start();
+        return;
+    }
+
+    QSet<QString> changedIds = filterBySyncTarget(iPendingIds.keys().toSet());
+    iPendingIds.clear();
+    if (changedIds.isEmpty()) {
+        LOG_DEBUG("Ignoring changes of address books not synced");
+        iSyncWindowTimer.stop();
+        return;
+    }
+
+    LOG_DEBUG("Notifying changes of" << changedIds.size() << "contacts");
+    iSyncWindowTimer.stop();
+    emit change();
+}
+
+void ContactsChangeNotifier::onProfileChanged()
+{
+    iActiveSyncTargetsLoaded = false;
+}
+
+QSet<QString> ContactsChangeNotifier::activeSyncTargets()
+{
+    if (!iActiveSyncTargetsLoaded) {
+        iActiveSyncTargets = loadActiveSyncTargets();
+        iActiveSyncTargetsLoaded = true;
+    }
+    return iActiveSyncTargets;
+}
+
+QSet<QString> ContactsChangeNotifier::loadActiveSyncTargets()
+{
+    QSet<QString> accounts;
+    QList<Buteo::SyncProfile*> profiles = iProfileManager.allSyncProfiles();
+    foreach(Buteo::SyncProfile *profile, profiles) {
+        if (profile->isEnabled() &&
+            (profile->key(PROFILE_CATEGORY_KEY) == PROFILE_CATEGORY_CONTACTS)) {
+            QString accountId = profile->key(Buteo::KEY_ACCOUNT_ID);
+            if (!accountId.isEmpty()) {
+                accounts.insert(accountId);
+            }
+        }
+    }
+    qDeleteAll(profiles);
+
+    QSet<QString> targets;
+    if (accounts.isEmpty()) {
+        return targets;
+    }
+
+    // address books are group contacts linked with the account by the sync backend
+    QContactDetailFilter filter;
+    filter.setDetailType(QContactDetail::TypeType, QContactType::FieldType);
+    filter.setValue(QContactType::TypeGroup);
+    foreach(const QContact &source, iManager->contacts(filter)) {
+        foreach(const QContactExtendedDetail &detail, source.details<QContactExtendedDetail>()) {
+            if ((detail.name() == "ACCOUNT-ID") &&
+                accounts.contains(detail.data().toString())) {
+                targets.insert(source.detail<QContactGuid>().guid());
+            }
+        }
+    }
+    return targets;
+}
+
+QSet<QString> ContactsChangeNotifier::filterBySyncTarget(const QSet<QString> &ids)
+{
+    QSet<QString> relevant;
+    QSet<QString> targets = activeSyncTargets();
+    if (targets.isEmpty()) {
+        return relevant;
+    }
+
+    QContactFetchHint hint;
+    hint.setDetailTypesHint(QList<QContactDetail::DetailType>() << QContactDetail::TypeSyncTarget
+                                                                << QContactDetail::TypeType);
+    hint.setOptimizationHints(QContactFetchHint::NoRelationships |
+                              QContactFetchHint::NoActionPreferences |
+                              QContactFetchHint::NoBinaryBlobs);
+
+    QList<QString> idList = ids.toList();
+    for (int i = 0; i < idList.size(); i += SYNC_TARGET_QUERY_SIZE) {
+        QList<QContactId> chunk;
+        foreach(const QString &id, idList.mid(i, SYNC_TARGET_QUERY_SIZE)) {
+            chunk << QContactId::fromString(id);
+        }
+
+        QContactIdFilter filter;
+        filter.setIds(chunk);
+        foreach(const QContact &contact, iManager->contacts(filter, QList<QContactSortOrder>(), hint)) {
+            // a new or changed address book can be linked with an account
+            if (contact.type() == QContactType::TypeGroup) {
+                iActiveSyncTargetsLoaded = false;
+            }
+            // the source id is stored on the field after the source name, as used by the sync backend
+            iSyncTargets.insert(contact.id().toString(),
+                                contact.detail<QContactSyncTarget>().value(QContactSyncTarget::FieldSyncTarget + 1).toString());
+        }
+    }
+    if (!iActiveSyncTargetsLoaded) {
+        targets = activeSyncTargets();
+    }
+
+    foreach(const QString &id, ids) {
+        QHash<QString, QString>::const_iterator target = iSyncTargets.constFind(id);
+        // removed contacts never seen before can not be resolved, keep them
+        if ((target == iSyncTargets.constEnd()) || targets.contains(target.value())) {
+            relevant.insert(id);
+        }
+    }
+    return relevant;
+}
+
+void ContactsChangeNotifier::setCoalescing(int quietPeriod, int maxDelay)
+{
+    // negative values keep the current setting
+    if (quietPeriod >= 0) {
+        iQuietTimer.setInterval(quietPeriod);
+    }
+    if (maxDelay >= 0) {
+        iMaxDelayTimer.setInterval(maxDelay);
+    }
+    if (iMaxDelayTimer.interval() < iQuietTimer.interval()) {
+        iMaxDelayTimer.setInterval(iQuietTimer.interval());
+    }
+}
+
+void ContactsChangeNotifier::removeSyncWrites(bool *syncRunning)
+{
+    QDateTime now = QDateTime::currentDateTimeUtc();
+    QDir dir(UContactsSyncWrites::directory());
+    foreach(const QString &fileName, dir.entryList(QStringList() << "*.writes", QDir::Files)) {
+        UContactsSyncWrites::Window window;
+        if (!UContactsSyncWrites::read(dir.absoluteFilePath(fileName), &window)) {
+            continue;
+        }
+
+        if (!window.finished.isValid() &&
+            (window.started.secsTo(now) <= SYNC_WINDOW_MAX_SECS)) {
+            *syncRunning = true;
+        }
+
+        // only changes notified when the sync wrote the contact are ignored
+        QHash<QString, QDateTime>::iterator i = iPendingIds.begin();
+        while (i != iPendingIds.end()) {
+            if (UContactsSyncWrites::isSyncWrite(window, i.key(), i.value())) {
+                i = iPendingIds.erase(i);
+            } else {
+                ++i;
+            }
         }
-        emit change();
     }
 }
 
@@ -92,4 +359,13 @@ void ContactsChangeNotifier::disable()
     FUNCTION_CALL_TRACE;
     iDisabled = true;
     QObject::disconnect(iManager, 0, this, 0);
+    QObject::disconnect(&iSyncWritesWatcher, 0, this, 0);
+    QStringList watched = iSyncWritesWatcher.directories() + iSyncWritesWatcher.files();
+    if (!watched.isEmpty()) {
+        iSyncWritesWatcher.removePaths(watched);
+    }
+    iSyncWindowTimer.stop();
+    iQuietTimer.stop();
+    iMaxDelayTimer.stop();
+    iPendingIds.clear();
 }
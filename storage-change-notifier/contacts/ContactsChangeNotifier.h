@@ -25,10 +25,17 @@
 
 #include <QObject>
 #include <QList>
+#include <QSet>
+#include <QHash>
+#include <QDateTime>
+#include <QTimer>
+#include <QFileSystemWatcher>
 
 #include <QContactManager>
 #include <QContactId>
 
+#include <ProfileManager.h>
+
 QTCONTACTS_USE_NAMESPACE
 
 class ContactsChangeNotifier : public QObject
@@ -37,8 +44,9 @@ class ContactsChangeNotifier : public QObject
 
 public:
     /*! \brief constructor
+     * @param managerName contacts manager to listen, the default one if empty
      */
-    ContactsChangeNotifier();
+    ContactsChangeNotifier(const QString &managerName = QString());
 
     /*! \brief destructor
      */
@@ -52,6 +60,13 @@ public:
      */
     void disable();
 
+    /*! \brief set the coalescing window of change notifications
+     * @param quietPeriod time without new changes before notifying them (ms)
+     * @param maxDelay maximum time a change waits while new changes arrive (ms)
+     * Negative values keep the current setting.
+     */
+    void setCoalescing(int quietPeriod, int maxDelay);
+
 Q_SIGNALS:
     /*! emit this signal to notify a change in contacts backend
      */
@@ -61,10 +76,38 @@ private Q_SLOTS:
     void onContactsAdded(const QList<QContactId>& ids);
     void onContactsRemoved(const QList<QContactId>& ids);
     void onContactsChanged(const QList<QContactId>& ids);
+    void flushChanges();
+    void onSyncWritesChanged();
+    void onProfileChanged();
 
 private:
     QContactManager* iManager;
     bool iDisabled;
+    // changes waiting for the coalescing window or the end of a running sync,
+    // with the time of the last change of each contact
+    QHash<QString, QDateTime> iPendingIds;
+    QFileSystemWatcher iSyncWritesWatcher;
+    QTimer iSyncWindowTimer;
+    QTimer iQuietTimer;
+    QTimer iMaxDelayTimer;
+    // last known sync target of each contact, used for removed contacts
+    QHash<QString, QString> iSyncTargets;
+    // address books synced by an enabled profile, loaded on demand
+    Buteo::ProfileManager iProfileManager;
+    QSet<QString> iActiveSyncTargets;
+    bool iActiveSyncTargetsLoaded;
+
+    void queueChanges(const QList<QContactId>& ids);
+    void watchSyncWrites();
+    void removeSyncWrites(bool *syncRunning);
+    QSet<QString> activeSyncTargets();
+    QSet<QString> filterBySyncTarget(const QSet<QString> &ids);
+
+protected:
+    /*! \brief load the ids of the address books synced by an enabled profile
+     * The result is cached until a profile or an address book changes.
+     */
+    virtual QSet<QString> loadActiveSyncTargets();
 };
 
 #endif
@@ -241,6 +241,11 @@ bool QContactMemoryEngine::testDeletedContact(const QContactFilter &filter,
         const QContactChangeLogFilter bf(filter);
         if (bf.eventType() == QContactChangeLogFilter::EventRemoved) {
             return (deletedAt >= bf.since());
+        } else if (bf.eventType() == QContactChangeLogFilter::EventChanged) {
+            // like galera a contact changed before being removed is also
+            // reported as changed
+            QDateTime lastModified = contact.detail<QContactTimestamp>().lastModified();
+            return (lastModified.isValid() && (lastModified >= bf.since()));
         }
         break;
     }
@@ -23,6 +23,7 @@
 #include "GContactImageUploader.h"
 #include "GContactStream.h"
 #include "GContactAtom.h"
+#include "GConfig.h"
 #include "UContactsCustomDetail.h"
 
 #include <LogMacros.h>
@@ -40,10 +41,13 @@ GContactImageUploader::GContactImageUploader(const QString &authToken,
                                              const QString &accountId,
                                              QObject *parent)
     : QObject(parent),
-      mEventLoop(0),
+      mNetworkAccessManager(0),
+      mEtagsReply(0),
       mAuthToken(authToken),
       mAccountId(accountId),
-      mAbort(false)
+      mMaxConcurrentRequests(GConfig::MAX_AVATAR_UPLOADS),
+      mAbort(false),
+      mFinished(false)
 {
 }
 
@@ -57,27 +61,43 @@ QMap<QString, GContactImageUploader::UploaderReply> GContactImageUploader::resul
     return mResults;
 }
 
-/*
- * This is a sync function since the contact sync process happen in a different
- * thread we do not need this function to be async
- */
-void GContactImageUploader::exec()
+bool GContactImageUploader::isFinished() const
 {
-    if (mQueue.isEmpty()) {
-        return;
-    }
+    return mFinished;
+}
+
+void GContactImageUploader::setMaxConcurrentRequests(int count)
+{
+    mMaxConcurrentRequests = count;
+}
+
+void GContactImageUploader::start()
+{
+    // keep the upload asynchronous as the real implementation
+    QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+}
 
-    QDateTime startTime = QDateTime::currentDateTime().toUTC();
-    QScopedPointer<QNetworkAccessManager> networkAccessManager(new QNetworkAccessManager);
-    connect(networkAccessManager.data(),
-            SIGNAL(finished(QNetworkReply*)),
-            SLOT(onRequestFinished(QNetworkReply*)),
-            Qt::QueuedConnection);
+void GContactImageUploader::abort()
+{
+    mAbort = true;
+    mQueue.clear();
+}
 
-    QEventLoop eventLoop;
-    mEventLoop = &eventLoop;
-    mUploadCompleted = false;
+void GContactImageUploader::startUploads()
+{
+}
 
+void GContactImageUploader::queryEtags()
+{
+}
+
+void GContactImageUploader::onRequestFinished(QNetworkReply *reply)
+{
+    Q_UNUSED(reply);
+}
+
+void GContactImageUploader::finish()
+{
     while(!mQueue.isEmpty()) {
         QPair<QString, QUrl> data = mQueue.takeFirst();
 
@@ -90,19 +110,12 @@ void GContactImageUploader::exec()
         emit uploadFinished(data.first, reply);
     }
 
-    mUploadCompleted = true;
-
-    if (mAbort) {
-        return;
-    }
-
-}
-
-void GContactImageUploader::onRequestFinished(QNetworkReply *reply)
-{
+    mFinished = true;
+    emit finished();
 }
 
 QMap<QString, GContactImageUploader::UploaderReply> GContactImageUploader::parseEntryList(const QByteArray &data) const
 {
+    Q_UNUSED(data);
     return QMap<QString, GContactImageUploader::UploaderReply>();
 }
@@ -27,6 +27,7 @@
 #include <QDebug>
 #include <QNetworkProxy>
 #include <QDateTime>
+#include <QTimer>
 #include <QUrlQuery>
 
 #include <LogMacros.h>
@@ -156,11 +157,46 @@ GTransport::request(const HTTP_REQUEST_TYPE type)
     FUNCTION_CALL_TRACE;
     Q_D(GTransport);
     QUrl url(property("URL").toString());
+    int requestId = property("RequestId").toInt() + 1;
+    setProperty("RequestId", requestId);
     QByteArray data;
     emit requested(url, &data);
     setProperty("RequestType", (int) type);
     setProperty("ReplyBody", data);
-    emit finishedRequest();
+
+    // tests can fail the request with an HTTP status or a network error
+    int replyError = property("ReplyError").toInt();
+    if (replyError > 0) {
+        emit error(replyError);
+    }
+    int networkError = property("NetworkError").toInt();
+    if (networkError > 0) {
+        emit transportError(networkError);
+    }
+
+    // the error handlers can abort the request or start a new one
+    if (property("RequestId").toInt() != requestId) {
+        return;
+    }
+
+    // streamed replies are delivered in small chunks
+    if (property("StreamingReply").toBool()) {
+        for (int i = 0; i < data.size(); i += 256) {
+            emit dataReceived(data.mid(i, 256));
+        }
+    }
+
+    // tests can delay the reply to simulate slow connections
+    int delay = property("ReplyDelay").toInt();
+    if (delay > 0) {
+        QTimer *timer = new QTimer(this);
+        timer->setSingleShot(true);
+        connect(timer, SIGNAL(timeout()), SIGNAL(finishedRequest()));
+        connect(timer, SIGNAL(timeout()), timer, SLOT(deleteLater()));
+        timer->start(delay);
+    } else {
+        emit finishedRequest();
+    }
 }
 
 bool
@@ -241,9 +277,48 @@ void
 GTransport::reset()
 {
     Q_D(GTransport);
+    setProperty("StreamingReply", false);
+    setProperty("Fields", QVariant());
+}
+
+void
+GTransport::abort()
+{
+    // the delayed reply of the aborted request is never delivered
+    setProperty("RequestId", property("RequestId").toInt() + 1);
+    qDeleteAll(findChildren<QTimer*>());
+}
+
+void
+GTransport::setTimeout(int msecs)
+{
+    setProperty("Timeout", msecs);
+}
+
+void
+GTransport::setStreamingReply(bool enabled)
+{
+    setProperty("StreamingReply", enabled);
+}
+
+void
+GTransport::requestTimeout()
+{
+}
+
+void
+GTransport::transferProgress(qint64 bytes, qint64 total)
+{
+    Q_UNUSED(bytes);
+    Q_UNUSED(total);
 }
 
 void GTransport::setGroupFilter(const QString &account, const QString &groupId)
 {
     setProperty("GroupFilter", QString("%1@%2").arg(account).arg(groupId));
 }
+
+void GTransport::setFields(const QString &fields)
+{
+    setProperty("Fields", fields);
+}
@@ -24,7 +24,9 @@
 #include "MockAuthenticator.h"
 
 MockAuthenticator::MockAuthenticator(QObject *parent)
-    : UAuth(parent)
+    : UAuth(parent),
+      m_authenticateCount(0),
+      m_invalidateTokenCount(0)
 {
 }
 
@@ -35,10 +37,17 @@ MockAuthenticator::~MockAuthenticator()
 bool MockAuthenticator::authenticate()
 {
     // simulate authentication sucess
+    m_authenticateCount++;
     emit success();
     return true;
 }
 
+void MockAuthenticator::invalidateToken()
+{
+    m_invalidateTokenCount++;
+    mToken.clear();
+}
+
 bool MockAuthenticator::init(const quint32 accountId, const QString serviceName)
 {
     m_accountId = accountId;
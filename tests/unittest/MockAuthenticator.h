@@ -38,11 +38,14 @@ public:
 
     bool authenticate();
     bool init(const quint32 accountId, const QString serviceName);
+    void invalidateToken();
 
     //test helpers
     bool m_initialized;
     quint32 m_accountId;
     QString m_serviceName;
+    int m_authenticateCount;
+    int m_invalidateTokenCount;
 
 };
 
@@ -47,7 +47,11 @@ QTCONTACTS_USE_NAMESPACE
 
 MockRemoteSource::MockRemoteSource(QObject *parent)
     : UAbstractRemoteSource(parent),
-      m_pageSize(-1)
+      m_pageSize(-1),
+      m_failAfterPages(-1),
+      m_failFetches(0),
+      m_failStatus(Sync::SYNC_ERROR),
+      m_manifestEnabled(false)
 {
     QMap<QString, QString> params;
     params.insert("id", "remote-source");
@@ -85,6 +89,23 @@ void MockRemoteSource::setPageSize(int pageSize)
     m_pageSize = pageSize;
 }
 
+void MockRemoteSource::setFailAfterPages(int pages, Sync::SyncStatus status)
+{
+    m_failAfterPages = pages;
+    m_failStatus = status;
+}
+
+void MockRemoteSource::setFailFetches(int fetches, Sync::SyncStatus status)
+{
+    m_failFetches = fetches;
+    m_failStatus = status;
+}
+
+void MockRemoteSource::setManifestEnabled(bool enabled)
+{
+    m_manifestEnabled = enabled;
+}
+
 bool MockRemoteSource::exixts(const QContactId &remoteId) const
 {
     if (remoteId.isNull()) {
@@ -99,6 +120,13 @@ void MockRemoteSource::fetchContacts(const QDateTime &since, bool includeDeleted
 {
     Q_UNUSED(fetchAvatar);
 
+    // simulate a request rejected by the server
+    if (m_failFetches > 0) {
+        m_failFetches--;
+        emit contactsFetched(QList<QContact>(), m_failStatus, -1.0);
+        return;
+    }
+
     QList<QContact> contacts;
     if (since.isValid()) {
         QContactUnionFilter iFilter;
@@ -124,7 +152,14 @@ void MockRemoteSource::fetchContacts(const QDateTime &since, bool includeDeleted
     //simulate page fetch
     QList<QContact> localContacts = toLocalContacts(contacts);
     if (m_pageSize > 0) {
+        int pages = 0;
         while(!localContacts.isEmpty()) {
+            // simulate a network failure in the middle of the fetch
+            if (pages == m_failAfterPages) {
+                emit contactsFetched(QList<QContact>(), m_failStatus, -1.0);
+                return;
+            }
+            pages++;
             int pageSize = qMin(localContacts.size(), m_pageSize);
             emit contactsFetched(localContacts.mid(0, pageSize),
                                  localContacts.size() > pageSize ? Sync::SYNC_PROGRESS : Sync::SYNC_DONE,
@@ -136,6 +171,40 @@ void MockRemoteSource::fetchContacts(const QDateTime &since, bool includeDeleted
     }
 }
 
+bool MockRemoteSource::fetchManifest()
+{
+    if (!m_manifestEnabled) {
+        return UAbstractRemoteSource::fetchManifest();
+    }
+
+    // only remote id and etag
+    QList<QContact> manifest;
+    foreach(const QContact &c, m_manager->contacts()) {
+        QContact entry;
+        UContactsBackend::setRemoteId(entry, c.id().toString());
+        UContactsCustomDetail::setCustomField(entry,
+                                              UContactsCustomDetail::FieldContactETag,
+                                              UContactsCustomDetail::getCustomField(c, UContactsCustomDetail::FieldContactETag).data());
+        manifest << entry;
+    }
+    emit contactsFetched(manifest, Sync::SYNC_DONE, -1.0);
+    return true;
+}
+
+void MockRemoteSource::fetchContactsById(const QStringList &remoteIds)
+{
+    QList<QContactId> ids;
+    foreach(const QString &remoteId, remoteIds) {
+        ids << QContactId::fromString(remoteId);
+    }
+
+    QList<QContact> contacts;
+    if (!ids.isEmpty()) {
+        contacts = m_manager->contacts(ids);
+    }
+    emit contactsFetched(toLocalContacts(contacts), Sync::SYNC_DONE, -1.0);
+}
+
 int MockRemoteSource::count() const
 {
     return m_manager->contactIds().size();
@@ -41,12 +41,17 @@ public:
     bool init(const QVariantMap &properties);
     void abort();
     void fetchContacts(const QDateTime &since, bool includeDeleted, bool fetchAvatar = true);
+    bool fetchManifest();
+    void fetchContactsById(const QStringList &remoteIds);
 
     //test helpers
     bool m_initialized;
     QVariantMap m_properties;
     QtContacts::QContactManager *manager() const;
     void setPageSize(int pageSize);
+    void setFailAfterPages(int pages, Sync::SyncStatus status);
+    void setFailFetches(int fetches, Sync::SyncStatus status);
+    void setManifestEnabled(bool enabled);
 
     int count() const;
 
@@ -66,6 +71,10 @@ private slots:
 private:
     QScopedPointer<QtContacts::QContactManager> m_manager;
     int m_pageSize;
+    int m_failAfterPages;
+    int m_failFetches;
+    Sync::SyncStatus m_failStatus;
+    bool m_manifestEnabled;
 
     QList<QtContacts::QContact> toLocalContacts(const QList<QtContacts::QContact> contacts) const;
     QList<QtContacts::QContact> toRemoteContact(const QList<QtContacts::QContact> contacts) const;
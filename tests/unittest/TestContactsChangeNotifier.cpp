@@ -0,0 +1,333 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "config-tests.h"
+
+#include <ContactsChangeNotifier.h>
+#include <UContactsSyncWrites.h>
+
+#include <QtContacts>
+#include <QtCore>
+#include <QtTest>
+
+QTCONTACTS_USE_NAMESPACE
+
+class TestNotifier : public ContactsChangeNotifier
+{
+public:
+    TestNotifier()
+        : ContactsChangeNotifier("mock"),
+          mLoads(0)
+    {
+    }
+
+    QSet<QString> mTargets;
+    int mLoads;
+
+protected:
+    QSet<QString> loadActiveSyncTargets()
+    {
+        mLoads++;
+        return mTargets;
+    }
+};
+
+class ContactsChangeNotifierTest : public QObject
+{
+    Q_OBJECT
+private:
+    QContactManager *mManager;
+
+    QString writesFileName() const
+    {
+        return QDir(UContactsSyncWrites::directory()).absoluteFilePath("test.writes");
+    }
+
+    QContact saveContact(const QString &name, const QString &syncTarget)
+    {
+        QContact contact;
+        QContactName n;
+        n.setFirstName(name);
+        contact.saveDetail(&n);
+
+        // the sync backend stores the address book id after the source name
+        QContactSyncTarget target;
+        target.setSyncTarget(syncTarget);
+        target.setValue(QContactSyncTarget::FieldSyncTarget + 1, syncTarget);
+        contact.saveDetail(&target);
+
+        mManager->saveContact(&contact);
+        return contact;
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QCoreApplication::addLibraryPath(MOCK_PLUGIN_PATH);
+        QVERIFY(QContactManager::availableManagers().contains("mock"));
+        QStandardPaths::setTestModeEnabled(true);
+
+        // short windows to keep the tests fast
+        qputenv("BUTEO_CONTACTS_CHANGE_QUIET_PERIOD", "100");
+        qputenv("BUTEO_CONTACTS_CHANGE_MAX_DELAY", "400");
+    }
+
+    void init()
+    {
+        QDir(UContactsSyncWrites::directory()).removeRecursively();
+        mManager = new QContactManager("mock");
+    }
+
+    void cleanup()
+    {
+        mManager->removeContacts(mManager->contactIds());
+        delete mManager;
+        QDir(UContactsSyncWrites::directory()).removeRecursively();
+    }
+
+    void testRegistry()
+    {
+        QContact first = saveContact("first", "book-1");
+        QContact second = saveContact("second", "book-1");
+
+        UContactsSyncWrites writes;
+        writes.open(writesFileName());
+        writes.registerIds(QList<QContactId>() << first.id());
+        writes.registerIds(QList<QContactId>() << second.id());
+
+        // a running sync is readable
+        UContactsSyncWrites::Window window;
+        QVERIFY(UContactsSyncWrites::read(writesFileName(), &window));
+        QVERIFY(window.started.isValid());
+        QVERIFY(!window.finished.isValid());
+        QCOMPARE(window.ids.size(), 2);
+        QVERIFY(window.ids.contains(first.id().toString()));
+        QVERIFY(window.ids.contains(second.id().toString()));
+
+        QVERIFY(window.stored.isEmpty());
+
+        // a new write of a stored id runs until it is stored again
+        writes.storedIds(QList<QContactId>() << first.id());
+        QVERIFY(UContactsSyncWrites::read(writesFileName(), &window));
+        QCOMPARE(window.stored.keys(), QStringList() << first.id().toString());
+        writes.registerIds(QList<QContactId>() << first.id());
+        QVERIFY(UContactsSyncWrites::read(writesFileName(), &window));
+        QVERIFY(window.stored.isEmpty());
+
+        writes.close();
+        QVERIFY(UContactsSyncWrites::read(writesFileName(), &window));
+        QVERIFY(window.finished.isValid());
+        QCOMPARE(window.ids.size(), 2);
+
+        // a new window drops the ids of the previous one
+        writes.open(writesFileName());
+        writes.registerIds(QList<QContactId>() << first.id());
+        writes.close();
+        QVERIFY(UContactsSyncWrites::read(writesFileName(), &window));
+        QCOMPARE(window.ids.keys(), QStringList() << first.id().toString());
+    }
+
+    void testRegistryWithTruncatedRecord()
+    {
+        QContact first = saveContact("first", "book-1");
+
+        UContactsSyncWrites writes;
+        writes.open(writesFileName());
+        writes.registerIds(QList<QContactId>() << first.id());
+
+        // simulate a record being appended
+        QFile file(writesFileName());
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write("\x01\x00\x00", 3);
+        file.close();
+
+        UContactsSyncWrites::Window window;
+        QVERIFY(UContactsSyncWrites::read(writesFileName(), &window));
+        QVERIFY(!window.finished.isValid());
+        QCOMPARE(window.ids.keys(), QStringList() << first.id().toString());
+    }
+
+    void testIsSyncWrite()
+    {
+        QDateTime writtenAt = QDateTime::currentDateTimeUtc();
+        UContactsSyncWrites::Window window;
+        window.ids.insert("written", writtenAt);
+        window.stored.insert("written", writtenAt);
+
+        // change signals caused by the sync write
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt));
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(1)));
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addMSecs(-500)));
+
+        // user changes after the sync wrote the contact
+        QVERIFY(!UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(10)));
+        QVERIFY(!UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(-10)));
+        QVERIFY(!UContactsSyncWrites::isSyncWrite(window, "other", writtenAt));
+    }
+
+    void testIsSyncWriteDuringLongSave()
+    {
+        QDateTime writtenAt = QDateTime::currentDateTimeUtc();
+        UContactsSyncWrites::Window window;
+        window.started = writtenAt;
+        window.ids.insert("written", writtenAt);
+
+        // the save is still running
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(30)));
+
+        // changes notified while a long save ran
+        window.stored.insert("written", writtenAt.addSecs(60));
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(30)));
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(62)));
+        QVERIFY(!UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(70)));
+
+        // a sync that finished without storing the write
+        window.stored.clear();
+        window.finished = writtenAt.addSecs(60);
+        QVERIFY(UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(30)));
+        QVERIFY(!UContactsSyncWrites::isSyncWrite(window, "written", writtenAt.addSecs(70)));
+    }
+
+    void testIgnoreSyncWrites()
+    {
+        TestNotifier notifier;
+        notifier.mTargets << "book-1";
+        notifier.enable();
+        QSignalSpy changeSpy(&notifier, SIGNAL(change()));
+
+        // ids of new contacts are registered after the save
+        UContactsSyncWrites writes;
+        writes.open(writesFileName());
+        QContact contact = saveContact("synced", "book-1");
+        writes.storedIds(QList<QContactId>() << contact.id());
+        writes.close();
+
+        QTest::qWait(500);
+        QCOMPARE(changeSpy.count(), 0);
+
+        // a later change of other contact is notified
+        saveContact("user", "book-1");
+        QTRY_COMPARE(changeSpy.count(), 1);
+    }
+
+    void testNotifyUserChangeAfterSyncFinishes()
+    {
+        TestNotifier notifier;
+        notifier.mTargets << "book-1";
+        notifier.enable();
+        QSignalSpy changeSpy(&notifier, SIGNAL(change()));
+
+        UContactsSyncWrites writes;
+        writes.open(writesFileName());
+        QContact synced = saveContact("synced", "book-1");
+        writes.registerIds(QList<QContactId>() << synced.id());
+
+        // user change while the sync runs waits for the sync to finish
+        saveContact("user", "book-1");
+        QTest::qWait(500);
+        QCOMPARE(changeSpy.count(), 0);
+
+        writes.close();
+        QTRY_COMPARE_WITH_TIMEOUT(changeSpy.count(), 1, 10000);
+        QTest::qWait(500);
+        QCOMPARE(changeSpy.count(), 1);
+    }
+
+    void testCoalescingFromEnvironment()
+    {
+        TestNotifier notifier;
+        notifier.mTargets << "book-1";
+        notifier.enable();
+        QSignalSpy changeSpy(&notifier, SIGNAL(change()));
+
+        // notified after the quiet period set on the environment, the default is 1 s
+        saveContact("user", "book-1");
+        QTRY_COMPARE_WITH_TIMEOUT(changeSpy.count(), 1, 600);
+    }
+
+    void testBurstOfChangesIsNotifiedOnce()
+    {
+        TestNotifier notifier;
+        notifier.mTargets << "book-1";
+        notifier.enable();
+        QSignalSpy changeSpy(&notifier, SIGNAL(change()));
+
+        // changes closer than the quiet period
+        for (int i = 0; i < 10; i++) {
+            saveContact(QString("user-%1").arg(i), "book-1");
+            QTest::qWait(10);
+        }
+        QCOMPARE(changeSpy.count(), 0);
+
+        QTRY_COMPARE(changeSpy.count(), 1);
+        QTest::qWait(500);
+        QCOMPARE(changeSpy.count(), 1);
+    }
+
+    void testFilterBySyncTarget()
+    {
+        TestNotifier notifier;
+        notifier.mTargets << "book-1";
+        notifier.enable();
+        QSignalSpy changeSpy(&notifier, SIGNAL(change()));
+
+        // address book without an active profile
+        saveContact("inactive", "book-2");
+        QTest::qWait(500);
+        QCOMPARE(changeSpy.count(), 0);
+
+        // address book with an active profile
+        saveContact("active", "book-1");
+        QTRY_COMPARE(changeSpy.count(), 1);
+
+        // active address books are loaded once
+        QCOMPARE(notifier.mLoads, 1);
+
+        // and reloaded after a profile change
+        notifier.mTargets << "book-2";
+        QVERIFY(QMetaObject::invokeMethod(&notifier, "onProfileChanged"));
+        saveContact("enabled", "book-2");
+        QTRY_COMPARE(changeSpy.count(), 2);
+        QCOMPARE(notifier.mLoads, 2);
+    }
+
+    void testMaxDelay()
+    {
+        TestNotifier notifier;
+        notifier.mTargets << "book-1";
+        notifier.enable();
+        QSignalSpy changeSpy(&notifier, SIGNAL(change()));
+
+        // a stream of changes that never stops for the quiet period
+        QElapsedTimer elapsed;
+        elapsed.start();
+        while (elapsed.elapsed() < 1000) {
+            saveContact("user", "book-1");
+            QTest::qWait(20);
+        }
+        // notified every max delay (400 ms)
+        QVERIFY(changeSpy.count() >= 2);
+    }
+};
+
+QTEST_MAIN(ContactsChangeNotifierTest)
+
+#include "TestContactsChangeNotifier.moc"
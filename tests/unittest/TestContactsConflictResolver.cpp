@@ -0,0 +1,363 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <UContactsConflictResolver.h>
+#include <UContactsCustomDetail.h>
+
+#include <QtContacts>
+#include <QtCore>
+#include <QtTest>
+
+QTCONTACTS_USE_NAMESPACE
+
+class ContactsConflictResolverTest : public QObject
+{
+    Q_OBJECT
+private:
+    QContactManager *mManager;
+    QList<QContactId> mIds;
+
+    QContact createContact(const QString &remoteId,
+                           const QString &firstName,
+                           const QString &phoneNumber,
+                           const QString &email = QString())
+    {
+        QContact contact;
+        UContactsCustomDetail::setCustomField(contact, UContactsCustomDetail::FieldRemoteId, remoteId);
+
+        QContactName name;
+        name.setFirstName(firstName);
+        contact.saveDetail(&name);
+
+        QContactPhoneNumber phone;
+        phone.setNumber(phoneNumber);
+        contact.saveDetail(&phone);
+
+        if (!email.isEmpty()) {
+            QContactEmailAddress address;
+            address.setEmailAddress(email);
+            contact.saveDetail(&address);
+        }
+        return contact;
+    }
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        // local ids used on the change maps
+        mManager = new QContactManager("memory");
+        QList<QContact> contacts;
+        for (int i = 0; i < 10000; i++) {
+            contacts << QContact();
+        }
+        QVERIFY(mManager->saveContacts(&contacts));
+        Q_FOREACH(const QContact &c, contacts) {
+            mIds << c.id();
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        delete mManager;
+    }
+
+    void testSnapshotIgnoresSyncFields()
+    {
+        UContactsConflictResolver resolver;
+        QContact a = createContact("remote-1", "Alice", "1234");
+        QContact b = createContact("remote-1", "Alice", "1234");
+        UContactsCustomDetail::setCustomField(b, UContactsCustomDetail::FieldContactETag, "new-etag");
+
+        QCOMPARE(resolver.snapshot(a).hash, resolver.snapshot(b).hash);
+
+        b = createContact("remote-1", "Alice", "4321");
+        QVERIFY(resolver.snapshot(a).hash != resolver.snapshot(b).hash);
+    }
+
+    void testMatchesBase()
+    {
+        UContactsConflictResolver resolver;
+        QContact contact = createContact("remote-1", "Alice", "1234");
+        QVERIFY(!resolver.matchesBase(contact));
+
+        resolver.setBase(QList<QContact>() << contact);
+        QVERIFY(resolver.matchesBase(contact));
+
+        // a new etag alone is not a content change
+        UContactsCustomDetail::setCustomField(contact, UContactsCustomDetail::FieldContactETag, "new-etag");
+        QVERIFY(resolver.matchesBase(contact));
+
+        QVERIFY(!resolver.matchesBase(createContact("remote-1", "Alice", "4321")));
+        QVERIFY(!resolver.matchesBase(createContact("remote-2", "Alice", "1234")));
+    }
+
+    void testMergeNonOverlappingChanges()
+    {
+        UContactsConflictResolver resolver;
+        resolver.setBase(QList<QContact>() << createContact("remote-1", "Alice", "1234"));
+
+        // remote changed the phone, local changed the name
+        QList<QContact> modifiedRemote;
+        modifiedRemote << createContact("remote-1", "Alice", "5678");
+        QList<QContact> deletedRemote;
+        QHash<QString, QContact> local;
+        local.insert("remote-1", createContact("remote-1", "Alicia", "1234"));
+        RemoteToLocalIdMap modifiedLocal;
+        modifiedLocal.insert("remote-1", mIds[0]);
+        RemoteToLocalIdMap deletedLocal;
+
+        QCOMPARE(resolver.resolve(&modifiedRemote, &deletedRemote, local, &modifiedLocal, &deletedLocal), 1);
+        QCOMPARE(modifiedRemote.size(), 1);
+        QCOMPARE(modifiedRemote[0].detail<QContactName>().firstName(), QStringLiteral("Alicia"));
+        QCOMPARE(modifiedRemote[0].detail<QContactPhoneNumber>().number(), QStringLiteral("5678"));
+        QCOMPARE(modifiedRemote[0].details<QContactPhoneNumber>().size(), 1);
+        // the local name must be uploaded
+        QVERIFY(modifiedLocal.contains("remote-1"));
+    }
+
+    void testMergeOnlyRemoteChanges()
+    {
+        UContactsConflictResolver resolver;
+        resolver.setPreferLocalChanges(true);
+        resolver.setBase(QList<QContact>() << createContact("remote-1", "Alice", "1234"));
+
+        // the local change only touched fields that are not synced
+        QList<QContact> modifiedRemote;
+        modifiedRemote << createContact("remote-1", "Alice", "5678");
+        QList<QContact> deletedRemote;
+        QHash<QString, QContact> local;
+        local.insert("remote-1", createContact("remote-1", "Alice", "1234"));
+        RemoteToLocalIdMap modifiedLocal;
+        modifiedLocal.insert("remote-1", mIds[0]);
+        RemoteToLocalIdMap deletedLocal;
+
+        resolver.resolve(&modifiedRemote, &deletedRemote, local, &modifiedLocal, &deletedLocal);
+        QCOMPARE(modifiedRemote.size(), 1);
+        QCOMPARE(modifiedRemote[0].detail<QContactPhoneNumber>().number(), QStringLiteral("5678"));
+        QVERIFY(modifiedLocal.isEmpty());
+    }
+
+    void testOverlappingChanges_data()
+    {
+        QTest::addColumn<bool>("preferLocal");
+        QTest::addColumn<bool>("withBase");
+        QTest::addColumn<QString>("expectedPhone");
+        QTest::addColumn<bool>("upload");
+
+        QTest::newRow("prefer remote") << false << true << "5678" << false;
+        QTest::newRow("prefer local") << true << true << "0000" << true;
+        QTest::newRow("prefer remote without base") << false << false << "5678" << false;
+        QTest::newRow("prefer local without base") << true << false << "0000" << true;
+    }
+
+    void testOverlappingChanges()
+    {
+        QFETCH(bool, preferLocal);
+        QFETCH(bool, withBase);
+        QFETCH(QString, expectedPhone);
+        QFETCH(bool, upload);
+
+        UContactsConflictResolver resolver;
+        resolver.setPreferLocalChanges(preferLocal);
+        if (withBase) {
+            resolver.setBase(QList<QContact>() << createContact("remote-1", "Alice", "1234"));
+        }
+
+        QList<QContact> modifiedRemote;
+        modifiedRemote << createContact("remote-1", "Alice", "5678");
+        QList<QContact> deletedRemote;
+        QHash<QString, QContact> local;
+        local.insert("remote-1", createContact("remote-1", "Alice", "0000"));
+        RemoteToLocalIdMap modifiedLocal;
+        modifiedLocal.insert("remote-1", mIds[0]);
+        RemoteToLocalIdMap deletedLocal;
+
+        resolver.resolve(&modifiedRemote, &deletedRemote, local, &modifiedLocal, &deletedLocal);
+        QCOMPARE(modifiedRemote.size(), 1);
+        QCOMPARE(modifiedRemote[0].detail<QContactPhoneNumber>().number(), expectedPhone);
+        QCOMPARE(modifiedLocal.contains("remote-1"), upload);
+    }
+
+    void testIdenticalChanges()
+    {
+        UContactsConflictResolver resolver;
+        resolver.setPreferLocalChanges(true);
+
+        QList<QContact> modifiedRemote;
+        modifiedRemote << createContact("remote-1", "Alice", "5678");
+        QList<QContact> deletedRemote;
+        QHash<QString, QContact> local;
+        local.insert("remote-1", createContact("remote-1", "Alice", "5678"));
+        RemoteToLocalIdMap modifiedLocal;
+        modifiedLocal.insert("remote-1", mIds[0]);
+        RemoteToLocalIdMap deletedLocal;
+
+        QCOMPARE(resolver.resolve(&modifiedRemote, &deletedRemote, local, &modifiedLocal, &deletedLocal), 0);
+        QCOMPARE(modifiedRemote.size(), 1);
+        QVERIFY(modifiedLocal.isEmpty());
+    }
+
+    void testDeletions_data()
+    {
+        QTest::addColumn<bool>("preferLocal");
+        QTest::addColumn<int>("modifiedRemoteSize");
+        QTest::addColumn<int>("deletedRemoteSize");
+        QTest::addColumn<int>("modifiedLocalSize");
+        QTest::addColumn<int>("deletedLocalSize");
+
+        // remote-1: modified remotely, deleted locally
+        // remote-2: deleted remotely, modified locally
+        // remote-3: deleted on both sides
+        QTest::newRow("prefer remote") << false << 1 << 1 << 0 << 0;
+        QTest::newRow("prefer local") << true << 0 << 0 << 1 << 1;
+    }
+
+    void testDeletions()
+    {
+        QFETCH(bool, preferLocal);
+        QFETCH(int, modifiedRemoteSize);
+        QFETCH(int, deletedRemoteSize);
+        QFETCH(int, modifiedLocalSize);
+        QFETCH(int, deletedLocalSize);
+
+        UContactsConflictResolver resolver;
+        resolver.setPreferLocalChanges(preferLocal);
+
+        QList<QContact> modifiedRemote;
+        modifiedRemote << createContact("remote-1", "Alice", "5678");
+        QList<QContact> deletedRemote;
+        deletedRemote << createContact("remote-2", "Bob", "1234")
+                      << createContact("remote-3", "Carol", "1234");
+        RemoteToLocalIdMap modifiedLocal;
+        modifiedLocal.insert("remote-2", mIds[1]);
+        RemoteToLocalIdMap deletedLocal;
+        deletedLocal.insert("remote-1", mIds[0]);
+        deletedLocal.insert("remote-3", mIds[2]);
+
+        resolver.resolve(&modifiedRemote, &deletedRemote, QHash<QString, QContact>(),
+                         &modifiedLocal, &deletedLocal);
+        QCOMPARE(modifiedRemote.size(), modifiedRemoteSize);
+        QCOMPARE(deletedRemote.size(), deletedRemoteSize);
+        QCOMPARE(modifiedLocal.size(), modifiedLocalSize);
+        QCOMPARE(deletedLocal.size(), deletedLocalSize);
+        QVERIFY(!deletedLocal.contains("remote-3"));
+    }
+
+    void testSaveAndLoad()
+    {
+        QTemporaryDir dir;
+        QString fileName = dir.path() + "/conflict.base";
+
+        UContactsConflictResolver resolver;
+        resolver.setBase(QList<QContact>() << createContact("remote-1", "Alice", "1234")
+                                           << createContact("remote-2", "Bob", "5678"));
+        QVERIFY(resolver.save(fileName));
+
+        UContactsConflictResolver loaded;
+        QVERIFY(loaded.load(fileName));
+        QCOMPARE(loaded.baseSize(), 2);
+        QVERIFY(loaded.hasBase("remote-1"));
+        QVERIFY(loaded.hasBase("remote-2"));
+
+        // a loaded base must merge as the original one
+        QList<QContact> modifiedRemote;
+        modifiedRemote << createContact("remote-1", "Alice", "5678");
+        QList<QContact> deletedRemote;
+        QHash<QString, QContact> local;
+        local.insert("remote-1", createContact("remote-1", "Alicia", "1234"));
+        RemoteToLocalIdMap modifiedLocal;
+        modifiedLocal.insert("remote-1", mIds[0]);
+        RemoteToLocalIdMap deletedLocal;
+        loaded.resolve(&modifiedRemote, &deletedRemote, local, &modifiedLocal, &deletedLocal);
+        QCOMPARE(modifiedRemote[0].detail<QContactName>().firstName(), QStringLiteral("Alicia"));
+        QCOMPARE(modifiedRemote[0].detail<QContactPhoneNumber>().number(), QStringLiteral("5678"));
+
+        // invalid files must be ignored
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("invalid");
+        file.close();
+        QVERIFY(!loaded.load(fileName));
+        QCOMPARE(loaded.baseSize(), 0);
+    }
+
+    void testJournal()
+    {
+        QTemporaryDir dir;
+        QString fileName = dir.path() + "/conflict.base";
+
+        UContactsConflictResolver resolver;
+        resolver.setBase(QList<QContact>() << createContact("remote-1", "Alice", "1234"));
+        QVERIFY(resolver.save(fileName));
+
+        // snapshots stored after the save
+        resolver.setBase(QList<QContact>() << createContact("remote-2", "Bob", "5678"));
+        QVERIFY(resolver.appendJournal(fileName, QStringList() << "remote-2"));
+
+        UContactsConflictResolver loaded;
+        QVERIFY(loaded.load(fileName));
+        QCOMPARE(loaded.baseSize(), 2);
+        QVERIFY(loaded.matchesBase(createContact("remote-2", "Bob", "5678")));
+
+        // a journal without base file, the first slow sync was interrupted
+        QVERIFY(QFile::remove(fileName));
+        QVERIFY(loaded.load(fileName));
+        QCOMPARE(loaded.baseSize(), 1);
+        QVERIFY(loaded.hasBase("remote-2"));
+
+        // the journal is part of the base after the next save
+        QVERIFY(resolver.save(fileName));
+        QVERIFY(!QFile::exists(UContactsConflictResolver::journalFileName(fileName)));
+        QVERIFY(loaded.load(fileName));
+        QCOMPARE(loaded.baseSize(), 2);
+    }
+
+    void benchmarkResolve()
+    {
+        UContactsConflictResolver resolver;
+        QList<QContact> base;
+        QList<QContact> remote;
+        QHash<QString, QContact> local;
+        RemoteToLocalIdMap modifiedIds;
+        for (int i = 0; i < mIds.size(); i++) {
+            QString remoteId = QString("remote-%1").arg(i);
+            QString number = QString::number(i);
+            base << createContact(remoteId, "Name", number, "a@example.com");
+            remote << createContact(remoteId, "Name", number, "b@example.com");
+            local.insert(remoteId, createContact(remoteId, "Other", number, "a@example.com"));
+            modifiedIds.insert(remoteId, mIds[i]);
+        }
+        resolver.setBase(base);
+
+        QBENCHMARK {
+            QList<QContact> modifiedRemote(remote);
+            QList<QContact> deletedRemote;
+            RemoteToLocalIdMap modifiedLocal(modifiedIds);
+            RemoteToLocalIdMap deletedLocal;
+            QCOMPARE(resolver.resolve(&modifiedRemote, &deletedRemote, local,
+                                      &modifiedLocal, &deletedLocal), mIds.size());
+        }
+    }
+};
+
+QTEST_MAIN(ContactsConflictResolverTest)
+
+#include "TestContactsConflictResolver.moc"
@@ -30,6 +30,7 @@
 
 #include <UContactsBackend.h>
 #include <UContactsCustomDetail.h>
+#include <URemoteIdIndex.h>
 
 #include <ProfileEngineDefs.h>
 
@@ -162,6 +163,26 @@ private:
         return true;
     }
 
+    void recreateClient(const QString &key, const QString &value)
+    {
+        delete m_client;
+        Buteo::SyncProfile *syncP  = loadFromXmlFile(PROFILE_TEST_FN);
+        QVERIFY(syncP);
+        syncP->setKey(key, value);
+        m_client = new TestContactsClient("test-plugin",
+                                          *syncP, 0);
+        delete syncP;
+    }
+
+    QStringList remoteIds(const QList<QContact> &contacts)
+    {
+        QStringList ids;
+        foreach(const QContact &c, contacts) {
+            ids << UContactsBackend::getRemoteId(c);
+        }
+        return ids;
+    }
+
 private Q_SLOTS:
     void initTestCase()
     {
@@ -381,6 +402,104 @@ private Q_SLOTS:
         QVERIFY(m_client->cleanUp());
     }
 
+    void testLocalChangeThenRemoval()
+    {
+        QDateTime createdAt = QDateTime::fromString("2015-06-15T08:00:00", Qt::ISODate);
+        QDateTime lastSyncTime = QDateTime::fromString("2015-06-15T10:30:00", Qt::ISODate);
+        m_client->m_lastSyncTime = lastSyncTime;
+        m_client->init();
+
+        importContactsFromVCardFile(m_client->m_remoteSource->manager(),
+                                    TEST_DATA_DIR + QStringLiteral("fast_sync_without_changes_remote.vcf"),
+                                    createdAt);
+        QTRY_COMPARE(m_client->m_remoteSource->count(), 4);
+        importContactsFromVCardFile(m_client->m_localSource->manager(),
+                                    TEST_DATA_DIR + QStringLiteral("fast_sync_without_changes_local.vcf"),
+                                    createdAt);
+        m_client->m_localSource->reloadCache();
+        QTRY_COMPARE(m_client->m_localSource->getAllContactIds().count(), 4);
+
+        // edit a paired contact after the last sync and then remove it
+        QContactManager *localManager = m_client->m_localSource->manager();
+        QContact contact = localManager->contacts().at(0);
+        QString remoteId = UContactsBackend::getRemoteId(contact);
+        QContactName name = contact.detail<QContactName>();
+        name.setFirstName(QStringLiteral("Edited"));
+        contact.saveDetail(&name);
+        QVERIFY(localManager->saveContact(&contact));
+        QVERIFY(localManager->removeContact(contact.id()));
+
+        // the contact is only reported as removed
+        RemoteToLocalIdMap addedIds;
+        RemoteToLocalIdMap modifiedIds;
+        RemoteToLocalIdMap deletedIds;
+        m_client->m_localSource->getAllChangedContactIds(lastSyncTime, &addedIds, &modifiedIds, &deletedIds);
+        QVERIFY(addedIds.isEmpty());
+        QVERIFY(modifiedIds.isEmpty());
+        QCOMPARE(deletedIds.keys(), QStringList() << remoteId);
+
+        QSignalSpy remoteTransactionSignal(m_client->m_remoteSource.data(),
+                                       SIGNAL(transactionCommited(QList<QtContacts::QContact>,
+                                                                  QList<QtContacts::QContact>,
+                                                                  QStringList,
+                                                                  QMap<QString, int>,
+                                                                  Sync::SyncStatus)));
+        QSignalSpy syncFinishedSpy(m_client, SIGNAL(syncFinished(Sync::SyncStatus)));
+        m_client->startSync();
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QCOMPARE(syncFinishedSpy.takeFirst().at(0).toInt(), int(Sync::SYNC_DONE));
+
+        // removal uploaded without a stale update before it
+        QCOMPARE(remoteTransactionSignal.count(), 1);
+        QList<QVariant> arguments = remoteTransactionSignal.takeFirst();
+        QVERIFY(arguments.at(1).value<QList<QtContacts::QContact> >().isEmpty());
+        QCOMPARE(arguments.at(2).value<QStringList>(), QStringList() << remoteId);
+        QCOMPARE(m_client->m_remoteSource->count(), 3);
+        QVERIFY(!m_client->m_remoteSource->manager()->contactIds().contains(QContactId::fromString(remoteId)));
+        QVERIFY(m_client->cleanUp());
+    }
+
+    void testRetryAuthentication_data()
+    {
+        QTest::addColumn<int>("failedFetches");
+        QTest::addColumn<int>("status");
+        QTest::addColumn<int>("localCount");
+
+        QTest::newRow("token rejected once")    << 1
+                                                << int(Sync::SYNC_DONE)
+                                                << 15;
+        // the token is refreshed only once
+        QTest::newRow("token rejected twice")   << 2
+                                                << int(Sync::SYNC_AUTHENTICATION_FAILURE)
+                                                << 0;
+    }
+
+    void testRetryAuthentication()
+    {
+        QFETCH(int, failedFetches);
+        QFETCH(int, status);
+        QFETCH(int, localCount);
+
+        QVERIFY(m_client->init());
+        importContactsFromVCardFile(m_client->m_remoteSource->manager(),
+                                    TEST_DATA_DIR + QStringLiteral("slow_sync_with_pages_remote.vcf"),
+                                    QDateTime::currentDateTime());
+        QTRY_COMPARE(m_client->m_remoteSource->count(), 15);
+
+        // the server rejects the cached token
+        m_client->m_remoteSource->setFailFetches(failedFetches, Sync::SYNC_AUTHENTICATION_FAILURE);
+
+        QSignalSpy syncFinishedSpy(m_client, SIGNAL(syncFinished(Sync::SyncStatus)));
+        m_client->startSync();
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QCOMPARE(syncFinishedSpy.takeFirst().at(0).toInt(), status);
+
+        // the token was dropped and a new one requested before fetching again
+        QCOMPARE(m_client->m_authenticator->m_invalidateTokenCount, 1);
+        QCOMPARE(m_client->m_authenticator->m_authenticateCount, 2);
+        QCOMPARE(m_client->m_localSource->getAllContactIds().count(), localCount);
+    }
+
     void testFetchWithPagination_data()
     {
         QTest::addColumn<int>("pageSize");
@@ -428,6 +547,218 @@ private Q_SLOTS:
         QCOMPARE(m_client->m_localSource->getAllContactIds().count(), 15);
     }
 
+    void testSlowSyncPipeline_data()
+    {
+        QTest::addColumn<int>("pendingPages");
+        QTest::addColumn<int>("failAfterPages");
+        QTest::addColumn<int>("expectedStatus");
+        QTest::addColumn<int>("expectedStored");
+
+        QTest::newRow("store each page before next fetch")  << 0
+                                                            << -1
+                                                            << int(Sync::SYNC_DONE)
+                                                            << 15;
+
+        QTest::newRow("one page pending")                   << 1
+                                                            << -1
+                                                            << int(Sync::SYNC_DONE)
+                                                            << 15;
+
+        QTest::newRow("two pages pending")                  << 2
+                                                            << -1
+                                                            << int(Sync::SYNC_DONE)
+                                                            << 15;
+
+        // the pipeline is full when the second page arrives, the first one is
+        // stored and the queued second page is dropped by the error
+        QTest::newRow("error with a page queued")           << 1
+                                                            << 2
+                                                            << int(Sync::SYNC_CONNECTION_ERROR)
+                                                            << 5;
+
+        QTest::newRow("error with all pages queued")        << 2
+                                                            << 2
+                                                            << int(Sync::SYNC_CONNECTION_ERROR)
+                                                            << 0;
+    }
+
+    void testSlowSyncPipeline()
+    {
+        QFETCH(int, pendingPages);
+        QFETCH(int, failAfterPages);
+        QFETCH(int, expectedStatus);
+        QFETCH(int, expectedStored);
+
+        recreateClient("slow-sync-pending-pages", QString::number(pendingPages));
+        QVERIFY(m_client->init());
+
+        // prepare remote source: 15 contacts in 3 pages
+        m_client->m_remoteSource->setPageSize(5);
+        m_client->m_remoteSource->setFailAfterPages(failAfterPages, Sync::SYNC_CONNECTION_ERROR);
+        importContactsFromVCardFile(m_client->m_remoteSource->manager(),
+                                    TEST_DATA_DIR + QStringLiteral("slow_sync_with_pages_remote.vcf"),
+                                    QDateTime::currentDateTime());
+        QTRY_COMPARE(m_client->m_remoteSource->count(), 15);
+        QCOMPARE(m_client->m_localSource->getAllContactIds().count(), 0);
+
+        QSignalSpy syncFinishedSpy(m_client, SIGNAL(syncFinished(Sync::SyncStatus)));
+        m_client->startSync();
+
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QList<QVariant> arguments = syncFinishedSpy.takeFirst();
+        QCOMPARE(arguments.at(0).toInt(), expectedStatus);
+
+        // run any store call still queued, nothing must be stored after the error
+        QCoreApplication::processEvents();
+        QCOMPARE(syncFinishedSpy.count(), 0);
+
+        // every fetched contact stored once and in the remote order
+        QStringList local = remoteIds(m_client->m_localSource->manager()->contacts());
+        QStringList remote;
+        foreach(const QContactId &id, m_client->m_remoteSource->manager()->contactIds()) {
+            remote << id.toString();
+        }
+        QCOMPARE(local.size(), expectedStored);
+        QCOMPARE(local.toSet().size(), expectedStored);
+        QCOMPARE(local, remote.mid(0, expectedStored));
+    }
+
+    void testResumeInterruptedSlowSync()
+    {
+        recreateClient("slow-sync-pending-pages", "0");
+        QVERIFY(m_client->init());
+        m_client->m_remoteSource->setManifestEnabled(true);
+
+        // keep the index files, the mock manager has none by default
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+        m_client->m_localSource->setCacheDirectory(cacheDir.path());
+
+        // 15 contacts in 3 pages, the connection drops after 2 pages
+        m_client->m_remoteSource->setPageSize(5);
+        m_client->m_remoteSource->setFailAfterPages(2, Sync::SYNC_CONNECTION_ERROR);
+        importContactsFromVCardFile(m_client->m_remoteSource->manager(),
+                                    TEST_DATA_DIR + QStringLiteral("slow_sync_with_pages_remote.vcf"),
+                                    QDateTime::currentDateTime());
+        QTRY_COMPARE(m_client->m_remoteSource->count(), 15);
+
+        QSignalSpy syncFinishedSpy(m_client, SIGNAL(syncFinished(Sync::SyncStatus)));
+        m_client->startSync();
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QCOMPARE(syncFinishedSpy.takeFirst().at(0).toInt(), int(Sync::SYNC_CONNECTION_ERROR));
+        QCOMPARE(m_client->m_localSource->getAllContactIds().count(), 10);
+
+        // the index was saved empty when the cache was built, the stored
+        // pages are only on its journal
+        QDir cache(cacheDir.path());
+        QStringList indexFiles = cache.entryList(QStringList() << "*.idx", QDir::Files);
+        QCOMPARE(indexFiles.size(), 1);
+        QString indexFile = cache.absoluteFilePath(indexFiles.first());
+        QString journalFile = URemoteIdIndex::journalFileName(indexFile);
+        QVERIFY(QFile::exists(journalFile));
+
+        URemoteIdIndex index;
+        QDateTime indexTime;
+        QVERIFY(index.load(indexFile, QString(), &indexTime));
+        QCOMPARE(index.size(), 10);
+        QFile::rename(journalFile, journalFile + ".saved");
+        QVERIFY(index.load(indexFile, QString(), &indexTime));
+        QCOMPARE(index.size(), 0);
+        QFile::rename(journalFile + ".saved", journalFile);
+
+        // edit a stored contact before the sync is resumed
+        QContactManager *localManager = m_client->m_localSource->manager();
+        QContact edited = localManager->contacts().at(0);
+        QString editedRemoteId = UContactsBackend::getRemoteId(edited);
+        QContactName name = edited.detail<QContactName>();
+        name.setFirstName(QStringLiteral("Edited"));
+        edited.saveDetail(&name);
+        QVERIFY(localManager->saveContact(&edited));
+
+        // resume with the connection back
+        m_client->m_remoteSource->setFailAfterPages(-1, Sync::SYNC_CONNECTION_ERROR);
+        m_client->startSync();
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QCOMPARE(syncFinishedSpy.takeFirst().at(0).toInt(), int(Sync::SYNC_DONE));
+
+        // every remote contact stored once
+        QStringList local = remoteIds(localManager->contacts());
+        QCOMPARE(local.size(), 15);
+        QCOMPARE(local.toSet().size(), 15);
+
+        // the local edit is kept and uploaded
+        QCOMPARE(localManager->contact(edited.id()).detail<QContactName>().firstName(),
+                 QStringLiteral("Edited"));
+        QCOMPARE(m_client->m_remoteSource->count(), 15);
+        QContact remoteEdited = m_client->m_remoteSource->manager()->contact(QContactId::fromString(editedRemoteId));
+        QCOMPARE(remoteEdited.detail<QContactName>().firstName(), QStringLiteral("Edited"));
+
+        // the finished sync saved the whole index
+        QVERIFY(!QFile::exists(journalFile));
+        QVERIFY(index.load(indexFile, QString(), &indexTime));
+        QCOMPARE(index.size(), 15);
+    }
+
+    void testSlowSyncReconcilesLocalChanges()
+    {
+        QVERIFY(m_client->init());
+        m_client->m_remoteSource->setManifestEnabled(true);
+
+        importContactsFromVCardFile(m_client->m_remoteSource->manager(),
+                                    TEST_DATA_DIR + QStringLiteral("slow_sync_with_pages_remote.vcf"),
+                                    QDateTime::currentDateTime());
+        QTRY_COMPARE(m_client->m_remoteSource->count(), 15);
+
+        // first sync stores and pairs every remote contact
+        QSignalSpy syncFinishedSpy(m_client, SIGNAL(syncFinished(Sync::SyncStatus)));
+        m_client->startSync();
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QCOMPARE(syncFinishedSpy.takeFirst().at(0).toInt(), int(Sync::SYNC_DONE));
+        QCOMPARE(m_client->m_localSource->getAllContactIds().count(), 15);
+
+        // edit and remove paired contacts locally
+        QContactManager *localManager = m_client->m_localSource->manager();
+        QList<QContact> localContacts = localManager->contacts();
+        QContact edited = localContacts.at(0);
+        QString editedRemoteId = UContactsBackend::getRemoteId(edited);
+        QContactName name = edited.detail<QContactName>();
+        name.setFirstName(QStringLiteral("Edited"));
+        edited.saveDetail(&name);
+        QVERIFY(localManager->saveContact(&edited));
+
+        QString removedRemoteId = UContactsBackend::getRemoteId(localContacts.at(1));
+        QVERIFY(localManager->removeContact(localContacts.at(1).id()));
+
+        // and remove other paired contact on the remote side
+        QString remoteRemovedId = UContactsBackend::getRemoteId(localContacts.at(2));
+        QVERIFY(m_client->m_remoteSource->manager()->removeContact(QContactId::fromString(remoteRemovedId)));
+
+        // without last sync time the sync is slow, the stored contacts are
+        // reconciled with the manifest: one manifest and one fetch by id
+        QSignalSpy contactFetched(m_client->m_remoteSource.data(),
+                                  SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+        m_client->startSync();
+        QTRY_COMPARE(syncFinishedSpy.count(), 1);
+        QCOMPARE(syncFinishedSpy.takeFirst().at(0).toInt(), int(Sync::SYNC_DONE));
+        QCOMPARE(contactFetched.count(), 2);
+        QVERIFY(contactFetched.at(1).at(0).value<QList<QtContacts::QContact> >().isEmpty());
+
+        // local edit and removal uploaded
+        QCOMPARE(m_client->m_remoteSource->count(), 13);
+        QContact remoteEdited = m_client->m_remoteSource->manager()->contact(QContactId::fromString(editedRemoteId));
+        QCOMPARE(remoteEdited.detail<QContactName>().firstName(), QStringLiteral("Edited"));
+        QVERIFY(!m_client->m_remoteSource->manager()->contactIds().contains(QContactId::fromString(removedRemoteId)));
+
+        // remote removal applied locally, the removed contact is not restored
+        QStringList localRemoteIds = remoteIds(localManager->contacts());
+        QCOMPARE(localRemoteIds.size(), 13);
+        QVERIFY(localRemoteIds.contains(editedRemoteId));
+        QVERIFY(!localRemoteIds.contains(removedRemoteId));
+        QVERIFY(!localRemoteIds.contains(remoteRemovedId));
+        QCOMPARE(localManager->contact(edited.id()).detail<QContactName>().firstName(),
+                 QStringLiteral("Edited"));
+    }
+
     void testSlowSyncWithAnEmptyLocalDatabase()
     {
         m_client->init();
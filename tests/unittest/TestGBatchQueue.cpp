@@ -0,0 +1,162 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "GBatchQueue.h"
+#include "GBatchSizer.h"
+
+#include <QtContacts>
+#include <QtCore>
+#include <QtTest>
+
+QTCONTACTS_USE_NAMESPACE
+
+class GBatchQueueTest : public QObject
+{
+    Q_OBJECT
+private:
+    QContact contact(const QString &name)
+    {
+        QContact c;
+        QContactName nm;
+        nm.setFirstName(name);
+        c.saveDetail(&nm);
+        return c;
+    }
+
+private Q_SLOTS:
+    void testPageOrder()
+    {
+        GBatchQueue queue;
+        queue.enqueue(GoogleContactStream::Remove, contact("r1"));
+        queue.enqueue(GoogleContactStream::Modify, contact("m1"));
+        queue.enqueue(GoogleContactStream::Add, contact("a1"));
+        queue.enqueue(GoogleContactStream::Add, contact("a2"));
+        queue.enqueue(GoogleContactStream::Modify, contact("m2"));
+        QCOMPARE(queue.size(), 5);
+
+        // adds first, then modifications and removals
+        GBatchQueue::Page page = queue.takePage(3);
+        QCOMPARE(page.size(), 3);
+        QCOMPARE(page.values(GoogleContactStream::Add).size(), 2);
+        QCOMPARE(page.values(GoogleContactStream::Modify).size(), 1);
+        QCOMPARE(page.value(GoogleContactStream::Modify).first.detail<QContactName>().firstName(),
+                 QStringLiteral("m1"));
+        QCOMPARE(queue.size(), 2);
+
+        page = queue.takePage(3);
+        QCOMPARE(page.size(), 2);
+        QCOMPARE(page.value(GoogleContactStream::Modify).first.detail<QContactName>().firstName(),
+                 QStringLiteral("m2"));
+        QCOMPARE(page.value(GoogleContactStream::Remove).first.detail<QContactName>().firstName(),
+                 QStringLiteral("r1"));
+        QVERIFY(queue.isEmpty());
+        QVERIFY(queue.takePage(3).isEmpty());
+    }
+
+    void testPutBack()
+    {
+        GBatchQueue queue;
+        for (int i = 0; i < 4; i++) {
+            queue.enqueue(GoogleContactStream::Add, contact(QString("a%1").arg(i)));
+        }
+        queue.enqueue(GoogleContactStream::Remove, contact("r0"));
+
+        GBatchQueue::Page page = queue.takePage(5);
+        queue.putBack(page);
+        QCOMPARE(queue.size(), 5);
+
+        // original order is preserved
+        page = queue.takePage(1);
+        QCOMPARE(page.value(GoogleContactStream::Add).first.detail<QContactName>().firstName(),
+                 QStringLiteral("a0"));
+        page = queue.takePage(4);
+        QCOMPARE(page.values(GoogleContactStream::Add).last().first.detail<QContactName>().firstName(),
+                 QStringLiteral("a1"));
+        QCOMPARE(page.value(GoogleContactStream::Remove).first.detail<QContactName>().firstName(),
+                 QStringLiteral("r0"));
+    }
+
+    void testSizer()
+    {
+        GBatchSizer sizer(30, 5, 100, 1000, 1000);
+
+        // slow replies and partial pages do not change the size
+        sizer.success(30, 5000);
+        QCOMPARE(sizer.pageSize(), 30);
+        sizer.success(10, 100);
+        QCOMPARE(sizer.pageSize(), 30);
+
+        // fast full pages grow up to the max size
+        sizer.success(30, 100);
+        QCOMPARE(sizer.pageSize(), 45);
+        for (int i = 0; i < 10; i++) {
+            sizer.success(sizer.pageSize(), 100);
+        }
+        QCOMPARE(sizer.pageSize(), 100);
+
+        // server errors and timeouts shrink the page
+        QVERIFY(sizer.failure(503));
+        QCOMPARE(sizer.pageSize(), 50);
+        QVERIFY(sizer.failure(408));
+        QCOMPARE(sizer.pageSize(), 25);
+        QCOMPARE(sizer.maxPageBytes(), 1000);
+
+        // entity too large also shrinks the byte budget
+        QVERIFY(sizer.failure(413));
+        QCOMPARE(sizer.pageSize(), 12);
+        QCOMPARE(sizer.maxPageBytes(), 500);
+
+        for (int i = 0; i < 10; i++) {
+            sizer.failure(413);
+        }
+        QCOMPARE(sizer.pageSize(), 5);
+        QCOMPARE(sizer.maxPageBytes(), 125);
+
+        // other errors are not related with the page size
+        QVERIFY(!sizer.failure(401));
+        QVERIFY(!sizer.failure(400));
+    }
+
+    void benchmarkQueueAndDrain()
+    {
+        QList<QContact> contacts;
+        for (int i = 0; i < 50000; i++) {
+            contacts << contact(QString::number(i));
+        }
+
+        QBENCHMARK {
+            GBatchQueue queue;
+            for (int i = 0; i < contacts.size(); i++) {
+                queue.enqueue((GoogleContactStream::UpdateType) (i % 3), contacts[i]);
+            }
+
+            int drained = 0;
+            while (!queue.isEmpty()) {
+                drained += queue.takePage(30).size();
+            }
+            QCOMPARE(drained, contacts.size());
+        }
+    }
+};
+
+QTEST_MAIN(GBatchQueueTest)
+
+#include "TestGBatchQueue.moc"
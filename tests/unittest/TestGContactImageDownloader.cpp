@@ -0,0 +1,298 @@
+/*
+ * This file is part of buteo-gcontact-plugin package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "GContactImageDownloader.h"
+#include "GContactAvatarCache.h"
+
+#include <QtCore>
+#include <QtNetwork>
+#include <QtTest>
+
+// Minimal HTTP server used as a stand-in for the avatar server.
+// Every request for "/avatar/<n>" is answered with "image-<n>" after a delay,
+// requests for "/never" are never answered.
+class HttpStandInServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    int mDelay;
+    int mPending;
+    int mMaxPending;
+    int mRequestCount;
+
+    HttpStandInServer()
+        : mDelay(50), mPending(0), mMaxPending(0), mRequestCount(0)
+    {
+        connect(this, SIGNAL(newConnection()), SLOT(onNewConnection()));
+    }
+
+    QUrl url(const QString &path) const
+    {
+        return QUrl(QString("http://127.0.0.1:%1%2").arg(serverPort()).arg(path));
+    }
+
+private Q_SLOTS:
+    void onNewConnection()
+    {
+        while (hasPendingConnections()) {
+            QTcpSocket *socket = nextPendingConnection();
+            connect(socket, SIGNAL(readyRead()), SLOT(onReadyRead()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        }
+    }
+
+    void onReadyRead()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+        QByteArray buffer = socket->property("buffer").toByteArray() + socket->readAll();
+
+        int end = buffer.indexOf("\r\n\r\n");
+        while (end >= 0) {
+            QByteArray path = buffer.left(buffer.indexOf("\r\n")).split(' ').value(1);
+            buffer.remove(0, end + 4);
+            mRequestCount++;
+
+            if (path != "/never") {
+                mPending++;
+                mMaxPending = qMax(mMaxPending, mPending);
+                mReplies.enqueue(qMakePair(QPointer<QTcpSocket>(socket), path));
+                QTimer::singleShot(mDelay, this, SLOT(sendNextReply()));
+            }
+            end = buffer.indexOf("\r\n\r\n");
+        }
+        socket->setProperty("buffer", buffer);
+    }
+
+    void sendNextReply()
+    {
+        QPair<QPointer<QTcpSocket>, QByteArray> reply = mReplies.dequeue();
+        mPending--;
+        if (!reply.first) {
+            return;
+        }
+
+        QByteArray body = "image-" + reply.second.mid(reply.second.lastIndexOf('/') + 1);
+        reply.first->write("HTTP/1.1 200 OK\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                           "\r\n" + body);
+    }
+
+private:
+    QQueue<QPair<QPointer<QTcpSocket>, QByteArray> > mReplies;
+};
+
+class GContactImageDownloaderTest : public QObject
+{
+    Q_OBJECT
+private:
+    HttpStandInServer *mServer;
+    GContactImageDownloader *mDownloader;
+
+    QByteArray fileContent(const QUrl &url)
+    {
+        QFile file(url.toLocalFile());
+        if (!file.open(QIODevice::ReadOnly)) {
+            return QByteArray();
+        }
+        return file.readAll();
+    }
+
+private Q_SLOTS:
+    void init()
+    {
+        mServer = new HttpStandInServer;
+        QVERIFY(mServer->listen(QHostAddress::LocalHost));
+        mDownloader = new GContactImageDownloader("fake-token");
+    }
+
+    void cleanup()
+    {
+        delete mDownloader;
+        delete mServer;
+    }
+
+    void testDownloadAll()
+    {
+        for (int i = 0; i < 20; i++) {
+            mDownloader->push(mServer->url(QString("/avatar/%1").arg(i)));
+        }
+        mDownloader->exec();
+
+        QMap<QUrl, QUrl> downloaded = mDownloader->donwloaded();
+        QCOMPARE(downloaded.size(), 20);
+        for (int i = 0; i < 20; i++) {
+            QUrl localFile = downloaded.value(mServer->url(QString("/avatar/%1").arg(i)));
+            QVERIFY(localFile.isLocalFile());
+            QCOMPARE(fileContent(localFile), QByteArray("image-") + QByteArray::number(i));
+        }
+    }
+
+    void testConcurrentWindow()
+    {
+        mDownloader->setMaxConcurrentRequests(3);
+        for (int i = 0; i < 12; i++) {
+            mDownloader->push(mServer->url(QString("/avatar/%1").arg(i)));
+        }
+        mDownloader->exec();
+
+        QCOMPARE(mDownloader->donwloaded().size(), 12);
+        QCOMPARE(mServer->mMaxPending, 3);
+    }
+
+    void testStartWithoutWaiting()
+    {
+        QSignalSpy finished(mDownloader, SIGNAL(finished()));
+        for (int i = 0; i < 4; i++) {
+            mDownloader->push(mServer->url(QString("/avatar/%1").arg(i)));
+        }
+
+        // the downloads run on the caller's event loop
+        mDownloader->start();
+        QVERIFY(!mDownloader->isFinished());
+        QCOMPARE(finished.count(), 0);
+
+        QTRY_COMPARE(finished.count(), 1);
+        QVERIFY(mDownloader->isFinished());
+        QCOMPARE(mDownloader->donwloaded().size(), 4);
+
+        // nothing to download finishes right away
+        GContactImageDownloader downloader("fake-token");
+        QSignalSpy emptyFinished(&downloader, SIGNAL(finished()));
+        downloader.start();
+        QCOMPARE(emptyFinished.count(), 1);
+    }
+
+    void testRequestTimeout()
+    {
+        QSignalSpy errors(mDownloader, SIGNAL(donwloadError(QUrl,QString)));
+
+        mDownloader->setRequestTimeout(200);
+        mDownloader->push(mServer->url("/never"));
+        mDownloader->push(mServer->url("/avatar/1"));
+        mDownloader->exec();
+
+        QMap<QUrl, QUrl> downloaded = mDownloader->donwloaded();
+        QCOMPARE(downloaded.size(), 1);
+        QVERIFY(downloaded.contains(mServer->url("/avatar/1")));
+        QCOMPARE(errors.count(), 1);
+        QCOMPARE(errors.first().at(0).toUrl(), mServer->url("/never"));
+    }
+
+    void testAbort()
+    {
+        mDownloader->setMaxConcurrentRequests(2);
+        connect(mDownloader, SIGNAL(downloadFinished(QUrl,QUrl)), mDownloader, SLOT(abort()));
+        for (int i = 0; i < 10; i++) {
+            mDownloader->push(mServer->url(QString("/avatar/%1").arg(i)));
+        }
+        mDownloader->exec();
+
+        // only the first download finishes, the running one is cancelled
+        // and the queued ones are never requested
+        QCOMPARE(mDownloader->donwloaded().size(), 1);
+        QVERIFY(mServer->mRequestCount <= 2);
+    }
+
+    void testCachedAvatarIsNotDownloaded()
+    {
+        QTemporaryDir cacheDir;
+        GContactAvatarCache cache(cacheDir.path(), 1024 * 1024);
+
+        mDownloader->setCache(&cache);
+        mDownloader->push(mServer->url("/avatar/1"), "etag-1");
+        mDownloader->push(mServer->url("/avatar/2"), "etag-2");
+        mDownloader->exec();
+        QCOMPARE(mServer->mRequestCount, 2);
+
+        // same etags on a new sync must come from the cache
+        GContactImageDownloader downloader("fake-token");
+        downloader.setCache(&cache);
+        downloader.push(mServer->url("/avatar/1"), "etag-1");
+        downloader.push(mServer->url("/avatar/2"), "etag-2-changed");
+        downloader.exec();
+        QCOMPARE(mServer->mRequestCount, 3);
+
+        QMap<QUrl, QUrl> downloaded = downloader.donwloaded();
+        QCOMPARE(downloaded.size(), 2);
+        QCOMPARE(downloaded.value(mServer->url("/avatar/1")),
+                 mDownloader->donwloaded().value(mServer->url("/avatar/1")));
+        QCOMPARE(fileContent(downloaded.value(mServer->url("/avatar/1"))), QByteArray("image-1"));
+    }
+
+    void testCacheDeduplicatesContent()
+    {
+        QTemporaryDir cacheDir;
+        GContactAvatarCache cache(cacheDir.path(), 1024 * 1024);
+
+        QUrl first = cache.insert("etag-1", "same-image");
+        QUrl second = cache.insert("etag-2", "same-image");
+        QCOMPARE(first, second);
+        QCOMPARE(cache.lookup("etag-1"), first);
+        QCOMPARE(cache.lookup("etag-2"), first);
+        QCOMPARE(QDir(cacheDir.path() + "/blobs").entryList(QDir::Files).size(), 1);
+    }
+
+    void testCacheEviction()
+    {
+        QTemporaryDir cacheDir;
+        // images stored by a sync with a bigger limit
+        GContactAvatarCache bigCache(cacheDir.path(), 1024 * 1024);
+        bigCache.insert("etag-1", "0123456789");
+        bigCache.insert("etag-2", "abcdefghij");
+        bigCache.insert("etag-3", "ABCDEFGHIJ");
+
+        // make etag-2 the least recently used image
+        QTest::qWait(1100);
+        QVERIFY(!bigCache.lookup("etag-1").isEmpty());
+        QVERIFY(!bigCache.lookup("etag-3").isEmpty());
+
+        GContactAvatarCache cache(cacheDir.path(), 20);
+        cache.evict();
+        QVERIFY(!cache.lookup("etag-1").isEmpty());
+        QVERIFY(cache.lookup("etag-2").isEmpty());
+        QVERIFY(!cache.lookup("etag-3").isEmpty());
+    }
+
+    void testCacheEvictionOnInsert()
+    {
+        QTemporaryDir cacheDir;
+        GContactAvatarCache cache(cacheDir.path(), 20);
+
+        cache.insert("etag-1", "0123456789");
+        cache.insert("etag-2", "abcdefghij");
+
+        // make etag-2 the least recently used image
+        QTest::qWait(1100);
+        QVERIFY(!cache.lookup("etag-1").isEmpty());
+
+        // the cache does not fit the new image, no explicit eviction is needed
+        QVERIFY(!cache.insert("etag-3", "ABCDEFGHIJ").isEmpty());
+        QVERIFY(!cache.lookup("etag-1").isEmpty());
+        QVERIFY(cache.lookup("etag-2").isEmpty());
+        QVERIFY(!cache.lookup("etag-3").isEmpty());
+        QCOMPARE(QDir(cacheDir.path() + "/blobs").entryList(QDir::Files).size(), 2);
+    }
+};
+
+QTEST_MAIN(GContactImageDownloaderTest)
+
+#include "TestGContactImageDownloader.moc"
@@ -45,6 +45,10 @@ class GRemoteSourceTest : public QObject
     Q_OBJECT
 private:
     int mGooglePage;
+    QSet<QObject*> mFetchTransports;
+    int mFailBatchError;
+    int mFailFetchIndex;
+    QList<QByteArray> mBatchRequests;
 
     QList<QContact> fullContacts()
     {
@@ -105,6 +109,16 @@ private Q_SLOTS:
         }
     }
 
+    void onFailFirstBatchRequested(const QUrl &url, QByteArray *data)
+    {
+        Q_UNUSED(url);
+        Q_UNUSED(data);
+        // only the first page fails
+        GTransport *transport = qobject_cast<GTransport*>(sender());
+        transport->setProperty("ReplyError", mBatchRequests.isEmpty() ? mFailBatchError : 0);
+        mBatchRequests << transport->property("DATA").toByteArray();
+    }
+
     void onUpdatedContactRequested(const QUrl &url, QByteArray *data)
     {
         Q_UNUSED(url);
@@ -116,9 +130,101 @@ private Q_SLOTS:
         }
     }
 
+    void onParallelFetchRequested(const QUrl &url, QByteArray *data)
+    {
+        Q_UNUSED(url);
+        const int totalResults = 45;
+        const int pageSize = 10;
+
+        GTransport *transport = qobject_cast<GTransport*>(sender());
+        mFetchTransports << transport;
+        int startIndex = qMax(transport->property("StartIndex").toInt(), 1);
+
+        // the first page after the planning is the slowest one
+        transport->setProperty("ReplyDelay", startIndex == 11 ? 200 : 10);
+        transport->setProperty("ReplyError", startIndex == mFailFetchIndex ? 401 : 0);
+
+        QString feed;
+        feed += QStringLiteral("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                               "<feed xmlns=\"http://www.w3.org/2005/Atom\" "
+                               "xmlns:gContact=\"http://schemas.google.com/contact/2008\" "
+                               "xmlns:gd=\"http://schemas.google.com/g/2005\" "
+                               "xmlns:openSearch=\"http://a9.com/-/spec/opensearch/1.1/\">\n");
+        if ((startIndex + pageSize) <= totalResults) {
+            feed += QString("<link rel=\"next\" type=\"application/atom+xml\" "
+                            "href=\"https://www.google.com/m8/feeds/contacts/test%40gmail.com/full?"
+                            "max-results=%1&amp;start-index=%2\"/>\n").arg(pageSize).arg(startIndex + pageSize);
+        }
+        feed += QString("<openSearch:totalResults>%1</openSearch:totalResults>\n"
+                        "<openSearch:startIndex>%2</openSearch:startIndex>\n"
+                        "<openSearch:itemsPerPage>%3</openSearch:itemsPerPage>\n")
+                .arg(totalResults).arg(startIndex).arg(pageSize);
+        for (int i = startIndex; (i < startIndex + pageSize) && (i <= totalResults); i++) {
+            feed += QString("<entry gd:etag=\"&quot;etag%1&quot;\">\n"
+                            "<id>http://www.google.com/m8/feeds/contacts/test%40gmail.com/base/%1</id>\n"
+                            "<category scheme=\"http://schemas.google.com/g/2005#kind\" "
+                            "term=\"http://schemas.google.com/contact/2008#contact\"/>\n"
+                            "<title>Contact %1</title>\n"
+                            "<gd:name><gd:fullName>Contact %1</gd:fullName></gd:name>\n"
+                            "<gContact:groupMembershipInfo deleted=\"false\" "
+                            "href=\"http://www.google.com/m8/feeds/groups/test%40gmail.com/base/6\"/>\n"
+                            "</entry>\n").arg(i);
+        }
+        feed += QStringLiteral("</feed>\n");
+        data->append(feed.toUtf8());
+    }
+
+    void onManifestRequested(const QUrl &url, QByteArray *data)
+    {
+        // the manifest has all entries, the batch query replies with the full
+        // data of the two last ones
+        bool batchQuery = url.path().endsWith(QStringLiteral("batch"));
+        QString feed;
+        feed += QStringLiteral("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                               "<feed xmlns=\"http://www.w3.org/2005/Atom\" "
+                               "xmlns:gContact=\"http://schemas.google.com/contact/2008\" "
+                               "xmlns:gd=\"http://schemas.google.com/g/2005\" "
+                               "xmlns:batch=\"http://schemas.google.com/gdata/batch\" "
+                               "xmlns:openSearch=\"http://a9.com/-/spec/opensearch/1.1/\">\n");
+        if (!batchQuery) {
+            feed += QStringLiteral("<openSearch:totalResults>3</openSearch:totalResults>\n");
+        }
+        for (int i = batchQuery ? 2 : 1; i <= 3; i++) {
+            feed += QString("<entry gd:etag=\"etag%1\">\n").arg(i);
+            if (batchQuery) {
+                feed += QString("<batch:id>%1</batch:id>\n"
+                                "<batch:operation type=\"query\"/>\n"
+                                "<batch:status code=\"200\" reason=\"Success\"/>\n").arg(i);
+            }
+            feed += QString("<id>http://www.google.com/m8/feeds/contacts/test%40gmail.com/base/%1</id>\n").arg(i);
+            if (batchQuery) {
+                feed += QString("<category scheme=\"http://schemas.google.com/g/2005#kind\" "
+                                "term=\"http://schemas.google.com/contact/2008#contact\"/>\n"
+                                "<title>Contact %1</title>\n"
+                                "<gd:name><gd:givenName>Contact %1</gd:givenName></gd:name>\n").arg(i);
+            }
+            feed += QStringLiteral("<gContact:groupMembershipInfo deleted=\"false\" "
+                                   "href=\"http://www.google.com/m8/feeds/groups/test%40gmail.com/base/6\"/>\n"
+                                   "</entry>\n");
+        }
+        feed += QStringLiteral("</feed>\n");
+        data->append(feed.toUtf8());
+    }
+
+    void onProbeRequested(const QUrl &url, QByteArray *data)
+    {
+        Q_UNUSED(url);
+        data->append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                     "<feed xmlns=\"http://www.w3.org/2005/Atom\" "
+                     "xmlns:openSearch=\"http://a9.com/-/spec/opensearch/1.1/\">\n"
+                     "<openSearch:totalResults>2</openSearch:totalResults>\n"
+                     "</feed>\n");
+    }
+
     void initTestCase()
     {
         qRegisterMetaType<QMap<QString,QString> >("QMap<QString,QString>");
+        mFailFetchIndex = 0;
     }
 
     void testInitialization()
@@ -212,6 +318,223 @@ private Q_SLOTS:
         }
     }
 
+    void testFetchContactsInParallel()
+    {
+        mFetchTransports.clear();
+
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts");
+        props.insert("AUTH-TOKEN", "1234567890");
+        props.insert("MAX-PARALLEL-FETCHES", 3);
+        src->init(props);
+        QCOMPARE(src->fetchTransports().size(), 2);
+
+        QSignalSpy contactsFetched(src.data(), SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+        connect(src->transport(), SIGNAL(requested(QUrl,QByteArray*)), SLOT(onParallelFetchRequested(QUrl,QByteArray*)));
+        foreach (GTransport *transport, src->fetchTransports()) {
+            connect(transport, SIGNAL(requested(QUrl,QByteArray*)), SLOT(onParallelFetchRequested(QUrl,QByteArray*)));
+        }
+        src->fetchContacts(QDateTime(), false, false);
+
+        QTRY_COMPARE(contactsFetched.count(), 5);
+        QCOMPARE(mFetchTransports.size(), 3);
+        QCOMPARE(src->state(), 0);
+
+        // pages are notified in the feed order even if they arrive out of order
+        int expectedId = 1;
+        qreal lastProgress = 0.0;
+        for (int page = 0; page < 5; page++) {
+            QList<QVariant> arguments = contactsFetched.takeFirst();
+            QList<QContact> contacts = arguments.at(0).value<QList<QtContacts::QContact> >();
+            QCOMPARE(arguments.at(1).toInt(), int(page == 4 ? Sync::SYNC_DONE : Sync::SYNC_PROGRESS));
+            QVERIFY(arguments.at(2).toReal() > lastProgress);
+            lastProgress = arguments.at(2).toReal();
+
+            QCOMPARE(contacts.size(), page == 4 ? 5 : 10);
+            foreach(const QContact &c, contacts) {
+                QString rId = UContactsCustomDetail::getCustomField(c, UContactsCustomDetail::FieldRemoteId).data().toString();
+                QCOMPARE(rId, QString::number(expectedId++));
+            }
+        }
+        QCOMPARE(lastProgress, 1.0);
+    }
+
+    void testFetchAgainAfterFailedPage()
+    {
+        mFetchTransports.clear();
+
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts");
+        props.insert("AUTH-TOKEN", "1234567890");
+        props.insert("MAX-PARALLEL-FETCHES", 3);
+        src->init(props);
+
+        QSignalSpy contactsFetched(src.data(), SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+        connect(src->transport(), SIGNAL(requested(QUrl,QByteArray*)), SLOT(onParallelFetchRequested(QUrl,QByteArray*)));
+        foreach (GTransport *transport, src->fetchTransports()) {
+            connect(transport, SIGNAL(requested(QUrl,QByteArray*)), SLOT(onParallelFetchRequested(QUrl,QByteArray*)));
+        }
+
+        // a page fails while the slow one is still running
+        mFailFetchIndex = 21;
+        src->fetchContacts(QDateTime(), false, false);
+        QTRY_COMPARE(contactsFetched.count(), 1);
+        QCOMPARE(contactsFetched.takeFirst().at(1).toInt(), int(Sync::SYNC_AUTHENTICATION_FAILURE));
+        QCOMPARE(src->state(), 0);
+
+        // the same transports fetch the feed again, the replies of the
+        // failed fetch are never delivered
+        mFailFetchIndex = 0;
+        src->fetchContacts(QDateTime(), false, false);
+        QTRY_COMPARE(contactsFetched.count(), 5);
+        QTest::qWait(300);
+        QCOMPARE(contactsFetched.count(), 5);
+
+        int expectedId = 1;
+        for (int page = 0; page < 5; page++) {
+            QList<QVariant> arguments = contactsFetched.takeFirst();
+            QCOMPARE(arguments.at(1).toInt(), int(page == 4 ? Sync::SYNC_DONE : Sync::SYNC_PROGRESS));
+            foreach(const QContact &c, arguments.at(0).value<QList<QtContacts::QContact> >()) {
+                QString rId = UContactsCustomDetail::getCustomField(c, UContactsCustomDetail::FieldRemoteId).data().toString();
+                QCOMPARE(rId, QString::number(expectedId++));
+            }
+        }
+        QCOMPARE(expectedId, 46);
+    }
+
+    void testFetchManifestAndContactsById()
+    {
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts/");
+        props.insert("AUTH-TOKEN", "1234567890");
+        props.insert("MAX-PARALLEL-FETCHES", 1);
+        src->init(props);
+
+        QSignalSpy contactsFetched(src.data(), SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+        connect(src->transport(), SIGNAL(requested(QUrl,QByteArray*)), SLOT(onManifestRequested(QUrl,QByteArray*)));
+
+        // manifest contains only the id and the etag of each contact
+        QVERIFY(src->fetchManifest());
+        QTRY_COMPARE(contactsFetched.count(), 1);
+        QCOMPARE(src->state(), 0);
+        QCOMPARE(src->transport()->property("Fields").toString(), GConfig::MANIFEST_FIELDS);
+        QCOMPARE(src->transport()->property("MaxResults").toInt(), GConfig::MANIFEST_MAX_RESULTS);
+
+        QList<QVariant> arguments = contactsFetched.takeFirst();
+        QList<QContact> contacts = arguments.at(0).value<QList<QtContacts::QContact> >();
+        QCOMPARE(arguments.at(1).toInt(), int(Sync::SYNC_DONE));
+        QCOMPARE(contacts.size(), 3);
+        for (int i = 0; i < contacts.size(); i++) {
+            const QContact &c = contacts.at(i);
+            QCOMPARE(UContactsCustomDetail::getCustomField(c, UContactsCustomDetail::FieldRemoteId).data().toString(),
+                     QString::number(i + 1));
+            QCOMPARE(UContactsCustomDetail::getCustomField(c, UContactsCustomDetail::FieldContactETag).data().toString(),
+                     QString("etag%1").arg(i + 1));
+        }
+
+        // changed contacts are fetched by a batch query
+        src->fetchContactsById(QStringList() << "2" << "3");
+        QTRY_COMPARE(contactsFetched.count(), 1);
+        QCOMPARE(src->state(), 0);
+        QCOMPARE(src->transport()->property("URL").toString(), QStringLiteral("http://google.com/contacts/batch"));
+        QCOMPARE(src->transport()->requestType(), GTransport::POST);
+        QByteArray body = src->transport()->property("DATA").toByteArray();
+        QVERIFY(body.contains("<batch:id>2</batch:id><batch:operation type=\"query\"/>"
+                              "<id>http://google.com/contacts/2</id>"));
+        QVERIFY(body.contains("<batch:id>3</batch:id><batch:operation type=\"query\"/>"
+                              "<id>http://google.com/contacts/3</id>"));
+        QVERIFY(!body.contains("<batch:id>1</batch:id>"));
+
+        arguments = contactsFetched.takeFirst();
+        contacts = arguments.at(0).value<QList<QtContacts::QContact> >();
+        QCOMPARE(arguments.at(1).toInt(), int(Sync::SYNC_DONE));
+        QCOMPARE(contacts.size(), 2);
+        QCOMPARE(UContactsCustomDetail::getCustomField(contacts.at(0), UContactsCustomDetail::FieldRemoteId).data().toString(),
+                 QStringLiteral("2"));
+        QCOMPARE(contacts.at(1).detail<QContactName>().firstName(), QStringLiteral("Contact 3"));
+    }
+
+    void testProbeChanges()
+    {
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts/");
+        props.insert("AUTH-TOKEN", "1234567890");
+        src->init(props);
+
+        // a probe needs the date of the last sync
+        QVERIFY(!src->probeChanges(QDateTime()));
+
+        QSignalSpy changesProbed(src.data(), SIGNAL(changesProbed(int,Sync::SyncStatus)));
+        QSignalSpy contactsFetched(src.data(), SIGNAL(contactsFetched(QList<QtContacts::QContact>,Sync::SyncStatus, qreal)));
+        connect(src->transport(), SIGNAL(requested(QUrl,QByteArray*)), SLOT(onProbeRequested(QUrl,QByteArray*)));
+
+        QDateTime since = QDateTime::currentDateTimeUtc().addSecs(-3600);
+        QVERIFY(src->probeChanges(since));
+        QTRY_COMPARE(changesProbed.count(), 1);
+        QCOMPARE(contactsFetched.count(), 0);
+        QCOMPARE(src->state(), 0);
+
+        // only the number of changed and deleted entries is requested
+        QCOMPARE(src->transport()->property("Fields").toString(), GConfig::PROBE_FIELDS);
+        QCOMPARE(src->transport()->property("MaxResults").toInt(), GConfig::PROBE_MAX_RESULTS);
+        QCOMPARE(src->transport()->property("UpdatedMin").toDateTime(), since);
+        QVERIFY(src->transport()->property("ShowDeleted").toBool());
+
+        QList<QVariant> arguments = changesProbed.takeFirst();
+        QCOMPARE(arguments.at(0).toInt(), 2);
+        QCOMPARE(arguments.at(1).toInt(), int(Sync::SYNC_DONE));
+    }
+
+    void testProbeFailures_data()
+    {
+        QTest::addColumn<int>("replyError");
+        QTest::addColumn<int>("networkError");
+        QTest::addColumn<int>("status");
+
+        QTest::newRow("unauthorized")       << 401 << 0
+                                            << int(Sync::SYNC_AUTHENTICATION_FAILURE);
+        QTest::newRow("server failure")     << 500 << 0
+                                            << int(Sync::SYNC_SERVER_FAILURE);
+        QTest::newRow("connection refused") << 0 << int(QNetworkReply::ConnectionRefusedError)
+                                            << int(Sync::SYNC_CONNECTION_ERROR);
+        // network errors share values with HTTP status codes, 401 must not be an auth failure
+        QTest::newRow("internal server error")
+                                            << 0 << int(QNetworkReply::InternalServerError)
+                                            << int(Sync::SYNC_CONNECTION_ERROR);
+        // the first error is reported
+        QTest::newRow("server failure then network error")
+                                            << 500 << int(QNetworkReply::UnknownServerError)
+                                            << int(Sync::SYNC_SERVER_FAILURE);
+    }
+
+    void testProbeFailures()
+    {
+        QFETCH(int, replyError);
+        QFETCH(int, networkError);
+        QFETCH(int, status);
+
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts/");
+        props.insert("AUTH-TOKEN", "1234567890");
+        src->init(props);
+        src->transport()->setProperty("ReplyError", replyError);
+        src->transport()->setProperty("NetworkError", networkError);
+
+        QSignalSpy changesProbed(src.data(), SIGNAL(changesProbed(int,Sync::SyncStatus)));
+        QVERIFY(src->probeChanges(QDateTime::currentDateTimeUtc().addSecs(-3600)));
+        QTRY_COMPARE(changesProbed.count(), 1);
+
+        QList<QVariant> arguments = changesProbed.takeFirst();
+        QCOMPARE(arguments.at(0).toInt(), -1);
+        QCOMPARE(arguments.at(1).toInt(), status);
+        QCOMPARE(src->state(), 0);
+    }
+
     void testCreateContact()
     {
         mGooglePage = 0;
@@ -401,6 +724,149 @@ private Q_SLOTS:
 
     }
 
+    void testModifyContactsWithMultiplePages()
+    {
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts");
+        props.insert("AUTH-TOKEN", "1234567890");
+        props.insert("ACCOUNT-NAME", "renato_teste_2@gmail.com");
+        src->init(props);
+        connect(src->transport(),
+                SIGNAL(requested(QUrl,QByteArray*)),
+                SLOT(onUpdatedContactRequested(QUrl,QByteArray*)));
+
+        QContact c;
+        c.setId(QContactId::fromString("qtcontacts::memory:99999"));
+
+        QContactGuid guid;
+        guid.setGuid("2c79456ba52fb29ecab9afedc4068f3421b77779");
+        c.saveDetail(&guid);
+
+        QContactAvatar avatar;
+        avatar.setImageUrl(QUrl::fromLocalFile("/tmp/avatar.png"));
+        c.saveDetail(&avatar);
+
+        UContactsCustomDetail::setCustomField(c,
+                                              UContactsCustomDetail::FieldRemoteId,
+                                              QVariant("012345"));
+
+        // one more contact than the batch page size
+        QList<QContact> lc;
+        for (int i = 0; i <= GConfig::MAX_RESULTS; i++) {
+            lc << c;
+        }
+
+        QSignalSpy onRequested(src->transport(), SIGNAL(requested(QUrl,QByteArray*)));
+        QSignalSpy onTransactionCommited(src.data(),
+                                         SIGNAL(transactionCommited(QList<QtContacts::QContact>,
+                                                                    QList<QtContacts::QContact>,
+                                                                    QStringList,
+                                                                    QMap<QString,int>,
+                                                                    Sync::SyncStatus)));
+        src->transaction();
+        src->saveContacts(lc);
+        src->commit();
+
+        // the second page is sent before the avatars of the first page get uploaded
+        QCOMPARE(onRequested.count(), 2);
+        QCOMPARE(onTransactionCommited.count(), 0);
+
+        // pages are notified in order
+        QTRY_COMPARE(onTransactionCommited.count(), 2);
+        QCOMPARE(onTransactionCommited.at(0).at(4).value<Sync::SyncStatus>(), Sync::SYNC_PROGRESS);
+        QCOMPARE(onTransactionCommited.at(1).at(4).value<Sync::SyncStatus>(), Sync::SYNC_DONE);
+
+        QList<QContact> updatedContacts = onTransactionCommited.at(0).at(1).value<QList<QtContacts::QContact> >();
+        QCOMPARE(updatedContacts.size(), 1);
+        QCOMPARE(UContactsCustomDetail::getCustomField(updatedContacts.at(0), UContactsCustomDetail::FieldContactETag).data().toString(),
+                 QStringLiteral("5b56e6f60f3d43d3-new"));
+        QCOMPARE(src->state(), 0);
+    }
+
+    void testFailedBatchPage_data()
+    {
+        QTest::addColumn<int>("replyError");
+        QTest::addColumn<bool>("insert");
+        QTest::addColumn<int>("requests");
+        QTest::addColumn<int>("status");
+
+        // inserts are only sent again when the server refused the page
+        QTest::newRow("insert too large") << 413 << true << 2 << int(Sync::SYNC_DONE);
+        QTest::newRow("insert timeout") << 408 << true << 1 << int(Sync::SYNC_ERROR);
+        QTest::newRow("insert server failure") << 503 << true << 1 << int(Sync::SYNC_SERVER_FAILURE);
+        QTest::newRow("update timeout") << 408 << false << 2 << int(Sync::SYNC_DONE);
+        QTest::newRow("update server failure") << 503 << false << 2 << int(Sync::SYNC_DONE);
+    }
+
+    void testFailedBatchPage()
+    {
+        QFETCH(int, replyError);
+        QFETCH(bool, insert);
+        QFETCH(int, requests);
+        QFETCH(int, status);
+
+        QScopedPointer<GRemoteSource> src(new GRemoteSource());
+        QVariantMap props;
+        props.insert(Buteo::KEY_REMOTE_DATABASE, "http://google.com/contacts");
+        props.insert("AUTH-TOKEN", "1234567890");
+        props.insert("ACCOUNT-NAME", "renato_teste_2@gmail.com");
+        src->init(props);
+
+        mFailBatchError = replyError;
+        mBatchRequests.clear();
+        connect(src->transport(),
+                SIGNAL(requested(QUrl,QByteArray*)),
+                SLOT(onFailFirstBatchRequested(QUrl,QByteArray*)));
+        if (insert) {
+            connect(src->transport(),
+                    SIGNAL(requested(QUrl,QByteArray*)),
+                    SLOT(onCreateContactRequested(QUrl,QByteArray*)));
+        } else {
+            connect(src->transport(),
+                    SIGNAL(requested(QUrl,QByteArray*)),
+                    SLOT(onUpdatedContactRequested(QUrl,QByteArray*)));
+        }
+
+        QContact c;
+        QContactName nm;
+        nm.setFirstName("Renato");
+        c.saveDetail(&nm);
+        if (!insert) {
+            UContactsCustomDetail::setCustomField(c,
+                                                  UContactsCustomDetail::FieldRemoteId,
+                                                  QVariant("012345"));
+        }
+
+        QSignalSpy onTransactionCommited(src.data(),
+                                         SIGNAL(transactionCommited(QList<QtContacts::QContact>,
+                                                                    QList<QtContacts::QContact>,
+                                                                    QStringList,
+                                                                    QMap<QString,int>,
+                                                                    Sync::SyncStatus)));
+        src->transaction();
+        src->saveContacts(QList<QContact>() << c);
+        src->commit();
+
+        int commits = (requests > 1) ? 1 : 2;
+        QTRY_COMPARE(onTransactionCommited.count(), commits);
+        QCOMPARE(onTransactionCommited.last().at(4).value<Sync::SyncStatus>(), Sync::SyncStatus(status));
+        QCOMPARE(mBatchRequests.size(), requests);
+        if (requests > 1) {
+            // a page sent again is the same page
+            QCOMPARE(mBatchRequests.at(1), mBatchRequests.at(0));
+            QMap<QString, int> errorMap = onTransactionCommited.at(0).at(3).value<QMap<QString, int> >();
+            QCOMPARE(errorMap.size(), 0);
+        } else {
+            // the failed page is reported before the batch fails
+            QMap<QString, int> errorMap = onTransactionCommited.at(0).at(3).value<QMap<QString, int> >();
+            QCOMPARE(errorMap.size(), 1);
+            QCOMPARE(onTransactionCommited.at(0).at(0).value<QList<QtContacts::QContact> >().size(), 0);
+            QCOMPARE(onTransactionCommited.at(0).at(4).value<Sync::SyncStatus>(), Sync::SYNC_PROGRESS);
+        }
+        QCOMPARE(src->state(), 0);
+    }
+
     void testModifyAContactWithoutChangeAvatar()
     {
         QScopedPointer<GRemoteSource> src(new GRemoteSource());
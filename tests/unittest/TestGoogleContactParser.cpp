@@ -24,6 +24,8 @@
 #include "config-tests.h"
 #include "GContactStream.h"
 #include "GContactAtom.h"
+#include "UContactsBackend.h"
+#include "UContactsConflictResolver.h"
 #include "UContactsCustomDetail.h"
 
 #include <QtContacts>
@@ -574,6 +576,257 @@ private slots:
         //TypeUrl,
     }
 
+    void testIncrementalParse_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+
+        QTest::newRow("1 byte") << 1;
+        QTest::newRow("7 bytes") << 7;
+        QTest::newRow("512 bytes") << 512;
+        QTest::newRow("64k bytes") << (64 * 1024);
+    }
+
+    void testIncrementalParse()
+    {
+        QFETCH(int, chunkSize);
+
+        QFile xml(TEST_DATA_DIR + QStringLiteral("google_contact_full_fetch_page_0.txt"));
+        QVERIFY(xml.open(QIODevice::ReadOnly));
+        QByteArray data = xml.readAll();
+
+        GoogleContactStream parser(false);
+        QScopedPointer<GoogleContactAtom> expected(parser.parse(data));
+        QVERIFY(expected);
+
+        GoogleContactStream streamParser(false);
+        for (int i = 0; i < data.size(); i += chunkSize) {
+            streamParser.addData(data.mid(i, chunkSize));
+        }
+        QScopedPointer<GoogleContactAtom> atom(streamParser.finishParse());
+        QVERIFY(atom);
+
+        QCOMPARE(atom->totalResults(), expected->totalResults());
+        QCOMPARE(atom->startIndex(), expected->startIndex());
+        QCOMPARE(atom->nextEntriesUrl(), expected->nextEntriesUrl());
+        QCOMPARE(atom->authorEmail(), expected->authorEmail());
+
+        QList<QPair<QContact, QStringList> > contacts = atom->entryContacts();
+        QList<QPair<QContact, QStringList> > expectedContacts = expected->entryContacts();
+        QCOMPARE(contacts.size(), 10);
+        QCOMPARE(contacts.size(), expectedContacts.size());
+        for (int i = 0; i < contacts.size(); i++) {
+            QCOMPARE(contacts[i].first.details().size(), expectedContacts[i].first.details().size());
+            QCOMPARE(contacts[i].second, expectedContacts[i].second);
+        }
+
+        // nothing received
+        GoogleContactStream emptyParser(false);
+        QVERIFY(!emptyParser.finishParse());
+    }
+
+    void testIncrementalParseMarkup_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+
+        QTest::newRow("1 byte") << 1;
+        QTest::newRow("5 bytes") << 5;
+        QTest::newRow("whole reply") << (64 * 1024);
+    }
+
+    void testIncrementalParseMarkup()
+    {
+        QFETCH(int, chunkSize);
+
+        // entry tags inside comments and CDATA, elements whose name starts
+        // with "entry" and entries with a namespace prefix
+        QByteArray data(
+            "<?xml version='1.0' encoding='UTF-8'?>"
+            "<feed xmlns='http://www.w3.org/2005/Atom'"
+            " xmlns:atom='http://www.w3.org/2005/Atom'"
+            " xmlns:openSearch='http://a9.com/-/spec/opensearch/1.1/'"
+            " xmlns:gContact='http://schemas.google.com/contact/2008'>"
+            "<!-- <entry><id>comment</id></entry> -->"
+            "<openSearch:totalResults>2</openSearch:totalResults>"
+            "<entryCount>2</entryCount>"
+            "<entry>"
+            "<id>http://www.google.com/m8/feeds/contacts/test%40gmail.com/base/first</id>"
+            "<content><![CDATA[</entry><entry>]]></content>"
+            "<gContact:groupMembershipInfo deleted='false'"
+            " href='http://www.google.com/m8/feeds/groups/test%40gmail.com/base/6'/>"
+            "</entry>"
+            "<atom:entry>"
+            "<id>http://www.google.com/m8/feeds/contacts/test%40gmail.com/base/second</id>"
+            "<gContact:groupMembershipInfo deleted='false'"
+            " href='http://www.google.com/m8/feeds/groups/test%40gmail.com/base/6'/>"
+            "</atom:entry>"
+            "</feed>");
+
+        GoogleContactStream streamParser(false);
+        for (int i = 0; i < data.size(); i += chunkSize) {
+            streamParser.addData(data.mid(i, chunkSize));
+        }
+        QScopedPointer<GoogleContactAtom> atom(streamParser.finishParse());
+        QVERIFY(atom);
+
+        QCOMPARE(atom->totalResults(), 2);
+        QList<QPair<QContact, QStringList> > contacts = atom->entryContacts();
+        QCOMPARE(contacts.size(), 2);
+        QCOMPARE(contacts.at(0).first.detail<QContactGuid>().guid(), QStringLiteral("first"));
+        QCOMPARE(contacts.at(1).first.detail<QContactGuid>().guid(), QStringLiteral("second"));
+    }
+
+    void testSkipUnchangedEntries()
+    {
+        QFile xml(TEST_DATA_DIR + QStringLiteral("google_contact_full_fetch_page_0.txt"));
+        QVERIFY(xml.open(QIODevice::ReadOnly));
+
+        QHash<QString, QString> etags;
+        etags.insert(QStringLiteral("6c224c08aaf939e"), QStringLiteral("\"QXY5ejVSLit7I2A9XRVXFkkORwY.\""));
+        etags.insert(QStringLiteral("948ac108f03db45"), QStringLiteral("\"outdated\""));
+
+        GoogleContactStream parser(false);
+        parser.setKnownETags(etags);
+        QScopedPointer<GoogleContactAtom> atom(parser.parse(xml.readAll()));
+        QVERIFY(atom);
+
+        QCOMPARE(atom->unchangedEntries(), QStringList() << QStringLiteral("6c224c08aaf939e"));
+        QCOMPARE(atom->entryContacts().size(), 9);
+        QCOMPARE(atom->entryContacts().at(0).first.detail<QContactGuid>().guid(), QStringLiteral("948ac108f03db45"));
+        QCOMPARE(atom->totalResults(), 15);
+    }
+
+    void benchmarkParseFullFetchPage()
+    {
+        QFile xml(TEST_DATA_DIR + QStringLiteral("google_contact_full_fetch_page_0.txt"));
+        QVERIFY(xml.open(QIODevice::ReadOnly));
+        QByteArray data = xml.readAll();
+
+        // a new stream is created for every reply, include it in the measure
+        int entries = 0;
+        QBENCHMARK {
+            GoogleContactStream parser(false);
+            GoogleContactAtom *atom = parser.parse(data);
+            entries = atom->entryContacts().size();
+            delete atom;
+        }
+        QCOMPARE(entries, 10);
+    }
+
+    void testUpdateFetchHintCoversEncodedDetails()
+    {
+        QFile xml(TEST_DATA_DIR + QStringLiteral("google_contact_full_fetch_page_0.txt"));
+        QVERIFY(xml.open(QIODevice::ReadOnly));
+
+        GoogleContactStream parser(false);
+        QScopedPointer<GoogleContactAtom> atom(parser.parse(xml.readAll()));
+        QVERIFY(atom);
+
+        QList<QContactDetail::DetailType> hintTypes =
+                GoogleContactStream::contactUpdateFetchHint().detailTypesHint();
+        QVERIFY(!hintTypes.isEmpty());
+
+        QMultiMap<GoogleContactStream::UpdateType, QPair<QContact, QStringList> > fullPage;
+        QMultiMap<GoogleContactStream::UpdateType, QPair<QContact, QStringList> > hintedPage;
+        QPair<QContact, QStringList> entry;
+        foreach (entry, atom->entryContacts()) {
+            QContact full(entry.first);
+            // details stored locally but never sent to the server
+            QContactDisplayLabel label;
+            label.setLabel(QStringLiteral("Local label"));
+            full.saveDetail(&label);
+            QContactGeoLocation location;
+            location.setLatitude(1.0);
+            location.setLongitude(2.0);
+            full.saveDetail(&location);
+
+            // what a fetch with the hint returns
+            QContact hinted(full);
+            foreach (QContactDetail detail, hinted.details()) {
+                if (!hintTypes.contains(detail.type())) {
+                    hinted.removeDetail(&detail);
+                }
+            }
+            QVERIFY(hinted.details().size() < full.details().size());
+
+            fullPage.insertMulti(GoogleContactStream::Add, qMakePair(full, entry.second));
+            hintedPage.insertMulti(GoogleContactStream::Add, qMakePair(hinted, entry.second));
+        }
+
+        GoogleContactStream fullEncoder(false, QStringLiteral("test@gmail.com"));
+        GoogleContactStream hintedEncoder(false, QStringLiteral("test@gmail.com"));
+        QCOMPARE(hintedEncoder.encode(hintedPage), fullEncoder.encode(fullPage));
+    }
+
+    void testStoredContactMatchesBase()
+    {
+        QCoreApplication::addLibraryPath(MOCK_PLUGIN_PATH);
+        QVERIFY(QContactManager::availableManagers().contains("mock"));
+
+        QFile xml(TEST_DATA_DIR + QStringLiteral("google_contact_full_fetch_page_0.txt"));
+        QVERIFY(xml.open(QIODevice::ReadOnly));
+
+        GoogleContactStream parser(false);
+        QScopedPointer<GoogleContactAtom> atom(parser.parse(xml.readAll()));
+        QVERIFY(atom);
+
+        QList<QContact> remoteContacts;
+        QPair<QContact, QStringList> entry;
+        foreach (entry, atom->entryContacts()) {
+            remoteContacts << entry.first;
+        }
+        QVERIFY(!remoteContacts.isEmpty());
+
+        // the base is the parsed contact, as stored by a sync
+        QContactFetchHint hint = GoogleContactStream::contactUpdateFetchHint();
+        UContactsConflictResolver resolver;
+        resolver.setMergeDetailTypes(hint.detailTypesHint());
+        resolver.setDetailEncoder(&GoogleContactStream::encodeDetail);
+        resolver.setBase(remoteContacts);
+        QCOMPARE(resolver.baseSize(), remoteContacts.size());
+
+        UContactsBackend backend(QStringLiteral("mock"));
+        QVERIFY(backend.init(0, QStringLiteral("parser-test")));
+        QMap<int, UContactsStatus> statusMap;
+        QVERIFY(backend.addContacts(remoteContacts, &statusMap));
+
+        QList<QContactId> ids;
+        foreach (const QContact &contact, remoteContacts) {
+            ids << contact.id();
+        }
+        QList<QContact> localContacts = backend.getContacts(ids, hint);
+        QCOMPARE(localContacts.size(), remoteContacts.size());
+        foreach (const QContact &contact, localContacts) {
+            QVERIFY(resolver.matchesBase(contact));
+        }
+
+        // values not sent to the server are not local changes
+        QContact local(localContacts.first());
+        QContactName name = local.detail<QContactName>();
+        name.setCustomLabel(QStringLiteral("Local label"));
+        local.saveDetail(&name);
+        QVERIFY(resolver.matchesBase(local));
+
+        // only the first context and sub type of a new number are sent
+        QContactPhoneNumber phone;
+        phone.setNumber(QStringLiteral("555-0101"));
+        phone.setContexts(QList<int>() << QContactDetail::ContextHome << QContactDetail::ContextOther);
+        phone.setSubTypes(QList<int>() << QContactPhoneNumber::SubTypeMobile << QContactPhoneNumber::SubTypeVideo);
+        local.saveDetail(&phone);
+        QVERIFY(!resolver.matchesBase(local));
+
+        QContact base(local);
+        phone.setContexts(QList<int>() << QContactDetail::ContextHome);
+        phone.setSubTypes(QList<int>() << QContactPhoneNumber::SubTypeMobile);
+        base.saveDetail(&phone);
+        resolver.setBase(QList<QContact>() << base);
+        QVERIFY(resolver.matchesBase(local));
+
+        // an uploaded value is
+        phone.setNumber(QStringLiteral("555-0102"));
+        local.saveDetail(&phone);
+        QVERIFY(!resolver.matchesBase(local));
+    }
+
     void testParseToGoogleXml()
     {
         QStringList expectedXML;
@@ -0,0 +1,232 @@
+/*
+ * This file is part of buteo-sync-plugins-contacts package
+ *
+ * Copyright (C) 2026 The buteo-sync-plugins-contacts contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <URemoteIdIndex.h>
+
+#include <QtContacts>
+#include <QtCore>
+#include <QtTest>
+
+QTCONTACTS_USE_NAMESPACE
+
+class RemoteIdIndexTest : public QObject
+{
+    Q_OBJECT
+private:
+    QContactManager *mManager;
+    QList<QContactId> mIds;
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        // create real contact ids, large enough for the benchmark
+        mManager = new QContactManager("memory");
+        QList<QContact> contacts;
+        for (int i = 0; i < 50000; i++) {
+            contacts << QContact();
+        }
+        QVERIFY(mManager->saveContacts(&contacts));
+        Q_FOREACH(const QContact &c, contacts) {
+            mIds << c.id();
+        }
+    }
+
+    void cleanupTestCase()
+    {
+        delete mManager;
+    }
+
+    void testInsertAndLookup()
+    {
+        URemoteIdIndex index;
+        index.insert("remote-1", mIds[0]);
+        index.insert("remote-2", mIds[1]);
+
+        QCOMPARE(index.size(), 2);
+        QCOMPARE(index.localId("remote-1"), mIds[0]);
+        QCOMPARE(index.remoteId(mIds[1]), QStringLiteral("remote-2"));
+        QVERIFY(index.localId("remote-3").isNull());
+        QVERIFY(index.remoteId(mIds[2]).isEmpty());
+    }
+
+    void testChangeRemoteId()
+    {
+        URemoteIdIndex index;
+        index.insert("remote-1", mIds[0]);
+
+        // the old remote id must not point to the contact anymore
+        index.insert("remote-new", mIds[0]);
+        QCOMPARE(index.size(), 1);
+        QVERIFY(!index.containsRemoteId("remote-1"));
+        QCOMPARE(index.remoteId(mIds[0]), QStringLiteral("remote-new"));
+
+        // a remote id moved to other contact
+        index.insert("remote-new", mIds[1]);
+        QCOMPARE(index.size(), 1);
+        QVERIFY(!index.containsLocalId(mIds[0]));
+        QCOMPARE(index.localId("remote-new"), mIds[1]);
+
+        // empty remote id removes the contact
+        index.insert(QString(), mIds[1]);
+        QVERIFY(index.isEmpty());
+    }
+
+    void testRemove()
+    {
+        URemoteIdIndex index;
+        index.insert("remote-1", mIds[0]);
+        index.insert("remote-2", mIds[1]);
+
+        index.removeLocalId(mIds[0]);
+        QVERIFY(!index.containsRemoteId("remote-1"));
+        index.removeRemoteId("remote-2");
+        QVERIFY(!index.containsLocalId(mIds[1]));
+        QVERIFY(index.isEmpty());
+    }
+
+    void testSaveAndLoad()
+    {
+        QTemporaryDir dir;
+        QString fileName = dir.path() + "/index.idx";
+        QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(QDateTime::currentMSecsSinceEpoch()).toUTC();
+
+        URemoteIdIndex index;
+        index.insert("remote-1", mIds[0], "etag-1");
+        index.insert("remote-2", mIds[1]);
+        QVERIFY(index.save(fileName, "target", timestamp));
+
+        URemoteIdIndex loaded;
+        QDateTime loadedTimestamp;
+        QVERIFY(loaded.load(fileName, "target", &loadedTimestamp));
+        QCOMPARE(loadedTimestamp, timestamp);
+        QCOMPARE(loaded.size(), 2);
+        QCOMPARE(loaded.localId("remote-1"), mIds[0]);
+        QCOMPARE(loaded.remoteId(mIds[1]), QStringLiteral("remote-2"));
+        QCOMPARE(loaded.etag("remote-1"), QStringLiteral("etag-1"));
+        QVERIFY(loaded.etag("remote-2").isEmpty());
+    }
+
+    void testJournal()
+    {
+        QTemporaryDir dir;
+        QString fileName = dir.path() + "/index.idx";
+
+        URemoteIdIndex index;
+        index.insert("remote-1", mIds[0], "etag-1");
+        QVERIFY(index.save(fileName, "target", QDateTime::currentDateTimeUtc()));
+
+        // entries stored after the save, one page at a time
+        index.insert("remote-2", mIds[1], "etag-2");
+        QVERIFY(index.appendJournal(fileName, "target", QStringList() << "remote-2"));
+        index.insert("remote-3", mIds[2]);
+        QVERIFY(index.appendJournal(fileName, "target", QStringList() << "remote-3"));
+
+        // the process is killed while appending an entry
+        QFile journal(URemoteIdIndex::journalFileName(fileName));
+        QVERIFY(journal.open(QIODevice::WriteOnly | QIODevice::Append));
+        journal.write("\x00\x00", 2);
+        journal.close();
+
+        URemoteIdIndex loaded;
+        QVERIFY(loaded.load(fileName, "target", 0));
+        QCOMPARE(loaded.size(), 3);
+        QCOMPARE(loaded.localId("remote-2"), mIds[1]);
+        QCOMPARE(loaded.etag("remote-2"), QStringLiteral("etag-2"));
+        QCOMPARE(loaded.remoteId(mIds[2]), QStringLiteral("remote-3"));
+
+        // the journal is part of the index after the next save
+        QVERIFY(loaded.save(fileName, "target", QDateTime::currentDateTimeUtc()));
+        QVERIFY(!QFile::exists(URemoteIdIndex::journalFileName(fileName)));
+        QVERIFY(loaded.load(fileName, "target", 0));
+        QCOMPARE(loaded.size(), 3);
+
+        // journal of other sync target is ignored
+        index.insert("remote-4", mIds[3]);
+        QVERIFY(index.appendJournal(fileName, "other-target", QStringList() << "remote-4"));
+        QVERIFY(loaded.load(fileName, "target", 0));
+        QCOMPARE(loaded.size(), 3);
+    }
+
+    void testLoadInvalidFile()
+    {
+        QTemporaryDir dir;
+        QString fileName = dir.path() + "/index.idx";
+
+        URemoteIdIndex index;
+        index.insert("remote-1", mIds[0], "etag-1");
+        QVERIFY(index.save(fileName, "target", QDateTime::currentDateTimeUtc()));
+
+        // missing file
+        QVERIFY(!index.load(dir.path() + "/missing.idx", "target", 0));
+        QVERIFY(index.isEmpty());
+
+        // file from other sync target
+        QVERIFY(!index.load(fileName, "other-target", 0));
+        QVERIFY(index.isEmpty());
+
+        // truncated file
+        QFile file(fileName);
+        QVERIFY(file.resize(file.size() - 1));
+        QVERIFY(!index.load(fileName, "target", 0));
+        QVERIFY(index.isEmpty());
+    }
+
+    void benchmarkReconciliation_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("10k contacts") << 10000;
+        QTest::newRow("25k contacts") << 25000;
+        QTest::newRow("50k contacts") << 50000;
+    }
+
+    void benchmarkReconciliation()
+    {
+        QFETCH(int, count);
+
+        QStringList remoteIds;
+        QStringList newRemoteIds;
+        for (int i = 0; i < count; i++) {
+            remoteIds << QString("remote-%1").arg(i);
+            newRemoteIds << QString("remote-new-%1").arg(i);
+        }
+
+        // same steps done by the backend during a sync: load the cache,
+        // update ids after upload and remove the contacts
+        QBENCHMARK {
+            URemoteIdIndex index;
+            index.reserve(count);
+            for (int i = 0; i < count; i++) {
+                index.insert(remoteIds[i], mIds[i]);
+            }
+            for (int i = 0; i < count; i++) {
+                index.insert(newRemoteIds[i], mIds[i]);
+            }
+            for (int i = 0; i < count; i++) {
+                index.removeLocalId(mIds[i]);
+            }
+            QVERIFY(index.isEmpty());
+        }
+    }
+};
+
+QTEST_MAIN(RemoteIdIndexTest)
+
+#include "TestRemoteIdIndex.moc"